@@ -0,0 +1,417 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_bench.h>
+
+
+/*
+ * ngx_bench [suite ...] [scale=n] [runs=n] [name=value ...]
+ *
+ * Every benchmark is run once to warm up and then "runs" times, each
+ * run timing the same number of operations.  One JSON object per line is
+ * printed with the median, minimum and maximum time per operation, so
+ * the output of two commits can be compared line by line; benchmarks of
+ * parsers print bytes per second and cycles per byte instead.  The process
+ * is bound to the CPU it starts on and all data is generated from a fixed
+ * seed, so consecutive runs see the same work.
+ */
+
+
+#define NGX_BENCH_RUNS  7
+
+
+static void ngx_bench_init(void);
+static uintptr_t ngx_bench_run(ngx_bench_pt handler, void *data,
+    ngx_uint_t n, uint64_t *times, uint64_t *cycles);
+static int ngx_libc_cdecl ngx_bench_cmp(const void *one, const void *two);
+static uint64_t ngx_bench_nsec(void);
+static uint64_t ngx_bench_cycles(void);
+
+
+static ngx_bench_suite_t  ngx_bench_suites[] = {
+    { "hash", ngx_bench_hash },
+    { "rbtree", ngx_bench_rbtree },
+    { "timer", ngx_bench_timer },
+    { "radix", ngx_bench_radix },
+    { "slab", ngx_bench_slab },
+    { "palloc", ngx_bench_palloc },
+#if (NGX_BENCH_HTTP)
+    { "http_parse", ngx_bench_http_parse },
+#endif
+    { NULL, NULL }
+};
+
+
+/* what the objects of the build expect from the rest of nginx */
+
+volatile ngx_cycle_t  *ngx_cycle;
+ngx_pid_t              ngx_pid;
+ngx_int_t              ngx_ncpu;
+
+static ngx_cycle_t     ngx_bench_cycle;
+static ngx_log_t       ngx_bench_log;
+
+static int             ngx_bench_argc;
+static char          **ngx_bench_argv;
+static ngx_uint_t      ngx_bench_runs = NGX_BENCH_RUNS;
+static ngx_uint_t      ngx_bench_factor = 1;
+static uint32_t        ngx_bench_seed = 2463534242;
+
+
+int ngx_cdecl
+main(int argc, char *const *argv)
+{
+    int                 i;
+    char               *value;
+    ngx_uint_t          run;
+    ngx_bench_suite_t  *suite;
+
+    ngx_bench_argc = argc;
+    ngx_bench_argv = (char **) argv;
+
+    ngx_bench_init();
+
+    value = ngx_bench_arg("runs");
+    if (value) {
+        ngx_bench_runs = ngx_atoi((u_char *) value, ngx_strlen(value));
+    }
+
+    value = ngx_bench_arg("scale");
+    if (value) {
+        ngx_bench_factor = ngx_atoi((u_char *) value, ngx_strlen(value));
+    }
+
+    if (ngx_bench_runs == 0 || ngx_bench_runs == (ngx_uint_t) NGX_ERROR
+        || ngx_bench_factor == 0
+        || ngx_bench_factor == (ngx_uint_t) NGX_ERROR)
+    {
+        ngx_log_stderr(0, "invalid runs or scale");
+        return 1;
+    }
+
+    for (suite = ngx_bench_suites; suite->name; suite++) {
+
+        run = 1;
+
+        for (i = 1; i < argc; i++) {
+            if (ngx_strchr(argv[i], '=')) {
+                continue;
+            }
+
+            run = 0;
+
+            if (ngx_strcmp(argv[i], suite->name) == 0) {
+                run = 1;
+                break;
+            }
+        }
+
+        if (run && suite->run(&ngx_bench_log) != NGX_OK) {
+            ngx_log_stderr(0, "%s failed", suite->name);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+static void
+ngx_bench_init(void)
+{
+#if (NGX_HAVE_SCHED_SETAFFINITY)
+    cpu_set_t  mask;
+#endif
+
+    ngx_pid = getpid();
+    ngx_ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+    ngx_pagesize = getpagesize();
+    ngx_cacheline_size = NGX_CPU_CACHE_LINE;
+    for (ngx_pagesize_shift = 0; ngx_pagesize >> ngx_pagesize_shift > 1;
+         ngx_pagesize_shift++)
+    {
+        /* void */
+    }
+
+#ifdef M_TRIM_THRESHOLD
+
+    /*
+     * a long running worker does not give its heap back after every
+     * free(), and the suites run before another must not change its result
+     */
+
+    (void) mallopt(M_TRIM_THRESHOLD, 256 * 1024 * 1024);
+
+#endif
+
+    ngx_bench_log.log_level = NGX_LOG_WARN;
+    ngx_bench_cycle.log = &ngx_bench_log;
+    ngx_cycle = &ngx_bench_cycle;
+
+#if (NGX_HAVE_SCHED_SETAFFINITY)
+
+    /* migrations between cpus add noise, the result is not required */
+
+    CPU_ZERO(&mask);
+    CPU_SET(sched_getcpu(), &mask);
+    (void) sched_setaffinity(0, sizeof(cpu_set_t), &mask);
+
+#endif
+}
+
+
+char *
+ngx_bench_arg(char *name)
+{
+    int     i;
+    size_t  len;
+
+    len = ngx_strlen(name);
+
+    for (i = 1; i < ngx_bench_argc; i++) {
+        if (ngx_strncmp(ngx_bench_argv[i], name, len) == 0
+            && ngx_bench_argv[i][len] == '=')
+        {
+            return &ngx_bench_argv[i][len + 1];
+        }
+    }
+
+    return NULL;
+}
+
+
+ngx_uint_t
+ngx_bench_scale(ngx_uint_t n)
+{
+    return n * ngx_bench_factor;
+}
+
+
+/* xorshift32, the same sequence on every run */
+
+uint32_t
+ngx_bench_random(void)
+{
+    ngx_bench_seed ^= ngx_bench_seed << 13;
+    ngx_bench_seed ^= ngx_bench_seed >> 17;
+    ngx_bench_seed ^= ngx_bench_seed << 5;
+
+    return ngx_bench_seed;
+}
+
+
+void
+ngx_bench_measure(char *name, ngx_bench_pt handler, void *data, ngx_uint_t n)
+{
+    uint64_t   *times;
+    uintptr_t   sum;
+
+    times = ngx_alloc(ngx_bench_runs * sizeof(uint64_t), &ngx_bench_log);
+    if (times == NULL) {
+        return;
+    }
+
+    sum = ngx_bench_run(handler, data, n, times, NULL);
+
+    printf("{\"bench\":\"%s\",\"ops\":%lu,\"runs\":%lu,"
+           "\"ns_per_op\":%.2f,\"min\":%.2f,\"max\":%.2f,\"check\":%lu}\n",
+           name, (unsigned long) n, (unsigned long) ngx_bench_runs,
+           (double) times[ngx_bench_runs / 2] / n, (double) times[0] / n,
+           (double) times[ngx_bench_runs - 1] / n, (unsigned long) sum);
+
+    fflush(stdout);
+
+    ngx_free(times);
+}
+
+
+/*
+ * n operations of size bytes each; the cycles are those of the time stamp
+ * counter, that is, at the nominal frequency of the cpu
+ */
+
+void
+ngx_bench_throughput(char *name, ngx_bench_pt handler, void *data,
+    ngx_uint_t n, size_t size)
+{
+    double      bytes;
+    uint64_t   *times, *cycles;
+    uintptr_t   sum;
+
+    times = ngx_alloc(2 * ngx_bench_runs * sizeof(uint64_t), &ngx_bench_log);
+    if (times == NULL) {
+        return;
+    }
+
+    cycles = times + ngx_bench_runs;
+
+    sum = ngx_bench_run(handler, data, n, times, cycles);
+
+    bytes = (double) n * size;
+
+    printf("{\"bench\":\"%s\",\"bytes\":%.0f,\"runs\":%lu,"
+           "\"bytes_per_s\":%.0f,\"cycles_per_byte\":%.3f,"
+           "\"min\":%.0f,\"max\":%.0f,\"check\":%lu}\n",
+           name, bytes, (unsigned long) ngx_bench_runs,
+           bytes * 1e9 / times[ngx_bench_runs / 2],
+           cycles[ngx_bench_runs / 2] / bytes,
+           bytes * 1e9 / times[ngx_bench_runs - 1], bytes * 1e9 / times[0],
+           (unsigned long) sum);
+
+    fflush(stdout);
+
+    ngx_free(times);
+}
+
+
+/* a warm up run and the timed ones, the times are sorted */
+
+static uintptr_t
+ngx_bench_run(ngx_bench_pt handler, void *data, ngx_uint_t n,
+    uint64_t *times, uint64_t *cycles)
+{
+    uint64_t     start, clock;
+    uintptr_t    sum;
+    ngx_uint_t   i;
+
+    sum = handler(data, n);
+
+    for (i = 0; i < ngx_bench_runs; i++) {
+        clock = ngx_bench_cycles();
+        start = ngx_bench_nsec();
+
+        sum += handler(data, n);
+
+        times[i] = ngx_bench_nsec() - start;
+
+        if (cycles) {
+            cycles[i] = ngx_bench_cycles() - clock;
+        }
+    }
+
+    ngx_qsort(times, ngx_bench_runs, sizeof(uint64_t), ngx_bench_cmp);
+
+    if (cycles) {
+        ngx_qsort(cycles, ngx_bench_runs, sizeof(uint64_t), ngx_bench_cmp);
+    }
+
+    return sum;
+}
+
+
+static int ngx_libc_cdecl
+ngx_bench_cmp(const void *one, const void *two)
+{
+    uint64_t  first, second;
+
+    first = *(uint64_t *) one;
+    second = *(uint64_t *) two;
+
+    return (first > second) - (first < second);
+}
+
+
+static uint64_t
+ngx_bench_nsec(void)
+{
+    struct timespec  ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+#if (( __i386__ || __amd64__ ) && ( __GNUC__ || __INTEL_COMPILER ))
+
+static uint64_t
+ngx_bench_cycles(void)
+{
+    uint32_t  lo, hi;
+
+    __asm__ volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+
+    return (uint64_t) hi << 32 | lo;
+}
+
+#else
+
+/* no cycle counter, cycles_per_byte is 0 */
+
+static uint64_t
+ngx_bench_cycles(void)
+{
+    return 0;
+}
+
+#endif
+
+
+#if (NGX_HAVE_VARIADIC_MACROS)
+
+void
+ngx_log_error_core(ngx_uint_t level, ngx_log_t *log, ngx_err_t err,
+    const char *fmt, ...)
+
+#else
+
+void ngx_cdecl
+ngx_log_error(ngx_uint_t level, ngx_log_t *log, ngx_err_t err,
+    const char *fmt, ...)
+
+#endif
+{
+    va_list  args;
+    u_char  *p, errstr[NGX_MAX_ERROR_STR];
+
+    va_start(args, fmt);
+    p = ngx_vslprintf(errstr, errstr + NGX_MAX_ERROR_STR - 1, fmt, args);
+    va_end(args);
+
+    if (err) {
+        p = ngx_slprintf(p, errstr + NGX_MAX_ERROR_STR - 1, " (%d)", err);
+    }
+
+    *p++ = '\n';
+
+    (void) ngx_write_fd(ngx_stderr, errstr, p - errstr);
+}
+
+
+#if !(NGX_HAVE_VARIADIC_MACROS)
+
+void
+ngx_log_error_core(ngx_uint_t level, ngx_log_t *log, ngx_err_t err,
+    const char *fmt, va_list args)
+{
+    u_char  *p, errstr[NGX_MAX_ERROR_STR];
+
+    p = ngx_vslprintf(errstr, errstr + NGX_MAX_ERROR_STR - 1, fmt, args);
+    *p++ = '\n';
+
+    (void) ngx_write_fd(ngx_stderr, errstr, p - errstr);
+}
+
+#endif
+
+
+void ngx_cdecl
+ngx_log_stderr(ngx_err_t err, const char *fmt, ...)
+{
+    va_list  args;
+    u_char  *p, errstr[NGX_MAX_ERROR_STR];
+
+    va_start(args, fmt);
+    p = ngx_vslprintf(errstr, errstr + NGX_MAX_ERROR_STR - 1, fmt, args);
+    va_end(args);
+
+    *p++ = '\n';
+
+    (void) ngx_write_fd(ngx_stderr, errstr, p - errstr);
+}
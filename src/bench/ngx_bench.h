@@ -0,0 +1,48 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#ifndef _NGX_BENCH_H_INCLUDED_
+#define _NGX_BENCH_H_INCLUDED_
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+/*
+ * runs n operations and returns something that depends on all of them,
+ * so that the compiler cannot drop the work
+ */
+typedef uintptr_t (*ngx_bench_pt)(void *data, ngx_uint_t n);
+
+
+typedef struct {
+    char         *name;
+    ngx_int_t   (*run)(ngx_log_t *log);
+} ngx_bench_suite_t;
+
+
+void ngx_bench_measure(char *name, ngx_bench_pt handler, void *data,
+    ngx_uint_t n);
+void ngx_bench_throughput(char *name, ngx_bench_pt handler, void *data,
+    ngx_uint_t n, size_t size);
+uint32_t ngx_bench_random(void);
+ngx_uint_t ngx_bench_scale(ngx_uint_t n);
+char *ngx_bench_arg(char *name);
+
+
+ngx_int_t ngx_bench_hash(ngx_log_t *log);
+ngx_int_t ngx_bench_rbtree(ngx_log_t *log);
+ngx_int_t ngx_bench_timer(ngx_log_t *log);
+ngx_int_t ngx_bench_radix(ngx_log_t *log);
+ngx_int_t ngx_bench_slab(ngx_log_t *log);
+ngx_int_t ngx_bench_palloc(ngx_log_t *log);
+#if (NGX_BENCH_HTTP)
+ngx_int_t ngx_bench_http_parse(ngx_log_t *log);
+#endif
+
+
+#endif /* _NGX_BENCH_H_INCLUDED_ */
@@ -0,0 +1,328 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_bench.h>
+
+
+/*
+ * The server names of a hosting setup: exact names with and without
+ * "www.", "*.example.org" and "mail.example.*" wildcards, built the way
+ * ngx_http_server_names() does, and looked up the way
+ * ngx_http_find_virtual_server() does, the key included.
+ */
+
+
+#define NGX_BENCH_HASH_LOOKUPS  4096
+#define NGX_BENCH_HASH_NAME_LEN  64
+
+
+typedef struct {
+    ngx_hash_combined_t   names;
+    ngx_str_t            *hosts;
+} ngx_bench_hash_t;
+
+
+static ngx_int_t ngx_bench_hash_build(ngx_bench_hash_t *bh, ngx_uint_t n,
+    ngx_pool_t *pool);
+static ngx_str_t *ngx_bench_hash_hosts(ngx_uint_t n, ngx_uint_t type,
+    ngx_pool_t *pool);
+static uintptr_t ngx_bench_hash_find(void *data, ngx_uint_t n);
+static uintptr_t ngx_bench_hash_find_combined(void *data, ngx_uint_t n);
+static int ngx_libc_cdecl ngx_bench_hash_cmp_wildcards(const void *one,
+    const void *two);
+
+
+ngx_int_t
+ngx_bench_hash(ngx_log_t *log)
+{
+    ngx_uint_t         n;
+    ngx_pool_t        *pool;
+    ngx_bench_hash_t   bh;
+
+    pool = ngx_create_pool(NGX_DEFAULT_POOL_SIZE, log);
+    if (pool == NULL) {
+        return NGX_ERROR;
+    }
+
+    n = ngx_bench_scale(5000);
+
+    if (ngx_bench_hash_build(&bh, n, pool) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    bh.hosts = ngx_bench_hash_hosts(n, 0, pool);
+    if (bh.hosts == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_bench_measure("hash_find", ngx_bench_hash_find, &bh, 1000000);
+    ngx_bench_measure("hash_find_combined_exact",
+                      ngx_bench_hash_find_combined, &bh, 1000000);
+
+    bh.hosts = ngx_bench_hash_hosts(n, 1, pool);
+    if (bh.hosts == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_bench_measure("hash_find_combined_wc_head",
+                      ngx_bench_hash_find_combined, &bh, 1000000);
+
+    bh.hosts = ngx_bench_hash_hosts(n, 2, pool);
+    if (bh.hosts == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_bench_measure("hash_find_combined_wc_tail",
+                      ngx_bench_hash_find_combined, &bh, 1000000);
+
+    bh.hosts = ngx_bench_hash_hosts(n, 3, pool);
+    if (bh.hosts == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_bench_measure("hash_find_combined_miss",
+                      ngx_bench_hash_find_combined, &bh, 1000000);
+
+    ngx_destroy_pool(pool);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_hash_build(ngx_bench_hash_t *bh, ngx_uint_t n, ngx_pool_t *pool)
+{
+    u_char                  *p;
+    ngx_str_t                name;
+    ngx_uint_t               i;
+    ngx_hash_init_t          hash;
+    ngx_hash_keys_arrays_t   ha;
+
+    ngx_memzero(&ha, sizeof(ngx_hash_keys_arrays_t));
+    ngx_memzero(&bh->names, sizeof(ngx_hash_combined_t));
+
+    ha.temp_pool = ngx_create_pool(NGX_DEFAULT_POOL_SIZE, pool->log);
+    if (ha.temp_pool == NULL) {
+        return NGX_ERROR;
+    }
+
+    ha.pool = pool;
+
+    if (ngx_hash_keys_array_init(&ha, NGX_HASH_LARGE) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    for (i = 0; i < n; i++) {
+        p = ngx_pnalloc(pool, NGX_BENCH_HASH_NAME_LEN);
+        if (p == NULL) {
+            return NGX_ERROR;
+        }
+
+        name.data = p;
+
+        /* three in eight names are wildcards */
+
+        switch (i % 8) {
+
+        case 0:
+        case 1:
+            name.len = ngx_sprintf(p, "*.site-%ui.example.org", i) - p;
+            break;
+
+        case 2:
+            name.len = ngx_sprintf(p, "mail.site-%ui.*", i) - p;
+            break;
+
+        default:
+            name.len = ngx_sprintf(p, "%ssite-%ui.example.com",
+                                   (i & 1) ? "www." : "", i)
+                       - p;
+        }
+
+        if (ngx_hash_add_key(&ha, &name, p, NGX_HASH_WILDCARD_KEY)
+            == NGX_ERROR)
+        {
+            return NGX_ERROR;
+        }
+    }
+
+    /*
+     * the default server_names_hash_max_size, and the bucket_size that
+     * names of this length need
+     */
+
+    hash.key = ngx_hash_key_lc;
+    hash.max_size = 512;
+    hash.bucket_size = ngx_align(128, ngx_cacheline_size);
+    hash.name = "server_names_hash";
+    hash.pool = pool;
+
+    /* as nginx asks for, when the names do not fit */
+
+    while (hash.max_size < 4 * n) {
+        hash.max_size *= 2;
+    }
+
+    hash.hash = &bh->names.hash;
+    hash.temp_pool = NULL;
+
+    if (ngx_hash_init(&hash, ha.keys.elts, ha.keys.nelts) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ngx_qsort(ha.dns_wc_head.elts, (size_t) ha.dns_wc_head.nelts,
+              sizeof(ngx_hash_key_t), ngx_bench_hash_cmp_wildcards);
+
+    hash.hash = NULL;
+    hash.temp_pool = ha.temp_pool;
+
+    if (ngx_hash_wildcard_init(&hash, ha.dns_wc_head.elts,
+                               ha.dns_wc_head.nelts)
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    bh->names.wc_head = (ngx_hash_wildcard_t *) hash.hash;
+
+    ngx_qsort(ha.dns_wc_tail.elts, (size_t) ha.dns_wc_tail.nelts,
+              sizeof(ngx_hash_key_t), ngx_bench_hash_cmp_wildcards);
+
+    hash.hash = NULL;
+    hash.temp_pool = ha.temp_pool;
+
+    if (ngx_hash_wildcard_init(&hash, ha.dns_wc_tail.elts,
+                               ha.dns_wc_tail.nelts)
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    bh->names.wc_tail = (ngx_hash_wildcard_t *) hash.hash;
+
+    ngx_destroy_pool(ha.temp_pool);
+
+    return NGX_OK;
+}
+
+
+/*
+ * the Host headers to look up: 0 exact names, 1 names under a leading
+ * wildcard, 2 names matching a trailing wildcard, 3 unknown names
+ */
+
+static ngx_str_t *
+ngx_bench_hash_hosts(ngx_uint_t n, ngx_uint_t type, ngx_pool_t *pool)
+{
+    u_char      *p;
+    ngx_str_t   *hosts;
+    ngx_uint_t   i, s;
+
+    hosts = ngx_palloc(pool, NGX_BENCH_HASH_LOOKUPS * sizeof(ngx_str_t));
+    if (hosts == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < NGX_BENCH_HASH_LOOKUPS; i++) {
+        p = ngx_pnalloc(pool, NGX_BENCH_HASH_NAME_LEN);
+        if (p == NULL) {
+            return NULL;
+        }
+
+        s = ngx_bench_random() % (n / 8);
+
+        switch (type) {
+
+        case 0:
+            s = s * 8 + 3 + ngx_bench_random() % 5;
+            hosts[i].len = ngx_sprintf(p, "%ssite-%ui.example.com",
+                                       (s & 1) ? "www." : "", s)
+                           - p;
+            break;
+
+        case 1:
+            s = s * 8 + ngx_bench_random() % 2;
+            hosts[i].len = ngx_sprintf(p, "static.cdn.site-%ui.example.org", s)
+                           - p;
+            break;
+
+        case 2:
+            s = s * 8 + 2;
+            hosts[i].len = ngx_sprintf(p, "mail.site-%ui.example.net", s) - p;
+            break;
+
+        default:
+            hosts[i].len = ngx_sprintf(p, "www.unknown-%ui.example.com", s)
+                           - p;
+        }
+
+        hosts[i].data = p;
+    }
+
+    return hosts;
+}
+
+
+static uintptr_t
+ngx_bench_hash_find(void *data, ngx_uint_t n)
+{
+    ngx_bench_hash_t *bh = data;
+
+    uintptr_t    sum;
+    ngx_str_t   *host;
+    ngx_uint_t   i;
+
+    sum = 0;
+
+    for (i = 0; i < n; i++) {
+        host = &bh->hosts[i % NGX_BENCH_HASH_LOOKUPS];
+
+        sum += ngx_hash_find(&bh->names.hash,
+                             ngx_hash_key(host->data, host->len),
+                             host->data, host->len)
+               != NULL;
+    }
+
+    return sum;
+}
+
+
+static uintptr_t
+ngx_bench_hash_find_combined(void *data, ngx_uint_t n)
+{
+    ngx_bench_hash_t *bh = data;
+
+    uintptr_t    sum;
+    ngx_str_t   *host;
+    ngx_uint_t   i;
+
+    sum = 0;
+
+    for (i = 0; i < n; i++) {
+        host = &bh->hosts[i % NGX_BENCH_HASH_LOOKUPS];
+
+        sum += ngx_hash_find_combined(&bh->names,
+                                      ngx_hash_key(host->data, host->len),
+                                      host->data, host->len)
+               != NULL;
+    }
+
+    return sum;
+}
+
+
+static int ngx_libc_cdecl
+ngx_bench_hash_cmp_wildcards(const void *one, const void *two)
+{
+    ngx_hash_key_t  *first, *second;
+
+    first = (ngx_hash_key_t *) one;
+    second = (ngx_hash_key_t *) two;
+
+    return ngx_dns_strcmp(first->key.data, second->key.data);
+}
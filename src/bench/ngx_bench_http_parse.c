@@ -0,0 +1,911 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+#include <ngx_bench.h>
+
+
+/*
+ * The request parsers fed with a corpus of raw requests the way
+ * a connection feeds them: a message is parsed in one buffer as its
+ * bytes arrive, every read extends the buffer, and the parser is called
+ * again from where it stopped.
+ *
+ * ngx_bench http_parse [corpus=path] [split=n]
+ *
+ * The corpus is a file of pipelined requests, or a directory of such
+ * files, each one a connection, as a fuzzer corpus is.  Without it,
+ * a corpus of browser, api and upload requests is generated.  With
+ * "split" every read returns 1 to n bytes, cut at random, and the
+ * results are checked against those of whole messages.
+ *
+ * The messages are found once: invalid and truncated ones are counted
+ * and left out, with the rest of their file.  The request line, header,
+ * complex uri and chunked body parsers are then timed, each over its
+ * part of every message.
+ */
+
+
+#define NGX_BENCH_HTTP_BYTES    (64 * 1024 * 1024)
+#define NGX_BENCH_HTTP_MESSAGE  2048
+
+
+typedef struct {
+    u_char                   *start;
+    u_char                   *end;
+} ngx_bench_http_file_t;
+
+
+typedef struct {
+    u_char                   *start;
+    u_char                   *headers;
+    u_char                   *body;
+    u_char                   *end;
+
+    u_char                   *uri_start;
+    u_char                   *uri_end;
+
+    unsigned                  complex_uri:1;
+    unsigned                  chunked:1;
+} ngx_bench_http_message_t;
+
+
+typedef struct {
+    ngx_http_request_t       *request;
+    ngx_connection_t          connection;
+
+    u_char                   *corpus;
+    size_t                    size;
+    ngx_array_t               files;
+    ngx_array_t               messages;
+
+    u_char                   *uri;
+
+    /* the ends of the reads, the last one is the end of the corpus */
+    u_char                  **cuts;
+    u_char                  **cut;
+
+    ngx_uint_t                invalid;
+    ngx_uint_t                truncated;
+} ngx_bench_http_t;
+
+
+typedef struct {
+    char                     *name;
+    ngx_bench_pt              handler;
+    size_t                    size;
+} ngx_bench_http_parser_t;
+
+
+static ngx_int_t ngx_bench_http_load(ngx_bench_http_t *bh, char *path,
+    ngx_pool_t *pool);
+static ngx_int_t ngx_bench_http_read(ngx_bench_http_t *bh, ngx_str_t *name,
+    u_char *p, size_t size);
+static ngx_int_t ngx_bench_http_generate(ngx_bench_http_t *bh,
+    ngx_pool_t *pool);
+static ngx_int_t ngx_bench_http_index(ngx_bench_http_t *bh,
+    ngx_bench_http_file_t *file);
+static u_char **ngx_bench_http_split(ngx_bench_http_t *bh, ngx_uint_t split,
+    ngx_pool_t *pool);
+static u_char *ngx_bench_http_last(ngx_bench_http_t *bh, u_char *pos,
+    u_char *end);
+static uintptr_t ngx_bench_http_request_line(void *data, ngx_uint_t n);
+static uintptr_t ngx_bench_http_header_line(void *data, ngx_uint_t n);
+static uintptr_t ngx_bench_http_complex_uri(void *data, ngx_uint_t n);
+static uintptr_t ngx_bench_http_chunked(void *data, ngx_uint_t n);
+static int ngx_libc_cdecl ngx_bench_http_cmp_names(const void *one,
+    const void *two);
+
+
+static ngx_bench_http_parser_t  ngx_bench_http_parsers[] = {
+    { "http_parse_request_line", ngx_bench_http_request_line, 0 },
+    { "http_parse_header_line", ngx_bench_http_header_line, 0 },
+    { "http_parse_complex_uri", ngx_bench_http_complex_uri, 0 },
+    { "http_parse_chunked", ngx_bench_http_chunked, 0 },
+    { NULL, NULL, 0 }
+};
+
+
+ngx_int_t
+ngx_bench_http_parse(ngx_log_t *log)
+{
+    char                      *path, *value;
+    size_t                     len;
+    u_char                    *whole[1], **split;
+    uintptr_t                  check;
+    ngx_uint_t                 i, n;
+    ngx_pool_t                *pool;
+    ngx_bench_http_t           bh;
+    ngx_bench_http_file_t     *file;
+    ngx_bench_http_parser_t   *parser;
+    ngx_bench_http_message_t  *m;
+
+    pool = ngx_create_pool(NGX_DEFAULT_POOL_SIZE, log);
+    if (pool == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_memzero(&bh, sizeof(ngx_bench_http_t));
+
+    bh.connection.log = log;
+
+    bh.request = ngx_pcalloc(pool, sizeof(ngx_http_request_t));
+    if (bh.request == NULL) {
+        return NGX_ERROR;
+    }
+
+    if (ngx_array_init(&bh.files, pool, 64, sizeof(ngx_bench_http_file_t))
+        != NGX_OK
+        || ngx_array_init(&bh.messages, pool, 1024,
+                          sizeof(ngx_bench_http_message_t))
+           != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    path = ngx_bench_arg("corpus");
+
+    if (path) {
+        if (ngx_bench_http_load(&bh, path, pool) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+    } else {
+        path = "generated";
+
+        if (ngx_bench_http_generate(&bh, pool) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    file = bh.files.elts;
+
+    for (i = 0; i < bh.files.nelts; i++) {
+        if (ngx_bench_http_index(&bh, &file[i]) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    /* the parts of the messages each parser goes through */
+
+    len = 0;
+    m = bh.messages.elts;
+
+    for (i = 0; i < bh.messages.nelts; i++) {
+        ngx_bench_http_parsers[0].size += m[i].headers - m[i].start;
+        ngx_bench_http_parsers[1].size += m[i].body - m[i].headers;
+
+        if (m[i].complex_uri) {
+            ngx_bench_http_parsers[2].size += m[i].uri_end - m[i].uri_start;
+            len = ngx_max(len, (size_t) (m[i].uri_end - m[i].uri_start));
+        }
+
+        if (m[i].chunked) {
+            ngx_bench_http_parsers[3].size += m[i].end - m[i].body;
+        }
+    }
+
+    bh.uri = ngx_pnalloc(pool, len + 1);
+    if (bh.uri == NULL) {
+        return NGX_ERROR;
+    }
+
+    whole[0] = bh.corpus + bh.size;
+    bh.cuts = whole;
+
+    value = ngx_bench_arg("split");
+    n = value ? ngx_atoi((u_char *) value, ngx_strlen(value)) : 0;
+
+    if (n == (ngx_uint_t) NGX_ERROR) {
+        ngx_log_stderr(0, "invalid split \"%s\"", value);
+        return NGX_ERROR;
+    }
+
+    printf("{\"corpus\":\"%s\",\"files\":%lu,\"messages\":%lu,"
+           "\"invalid\":%lu,\"truncated\":%lu,\"bytes\":%lu,\"split\":%lu}\n",
+           path, (unsigned long) bh.files.nelts,
+           (unsigned long) bh.messages.nelts, (unsigned long) bh.invalid,
+           (unsigned long) bh.truncated, (unsigned long) bh.size,
+           (unsigned long) n);
+
+    if (n) {
+        split = ngx_bench_http_split(&bh, n, pool);
+        if (split == NULL) {
+            return NGX_ERROR;
+        }
+
+        /* a parser must not depend on where the reads end */
+
+        for (parser = ngx_bench_http_parsers; parser->name; parser++) {
+            bh.cuts = whole;
+            check = parser->handler(&bh, 1);
+
+            bh.cuts = split;
+
+            if (parser->handler(&bh, 1) != check) {
+                ngx_log_stderr(0, "%s: split messages are parsed "
+                               "differently", parser->name);
+                return NGX_ERROR;
+            }
+        }
+    }
+
+    for (parser = ngx_bench_http_parsers; parser->name; parser++) {
+        if (parser->size == 0) {
+            continue;
+        }
+
+        ngx_bench_throughput(parser->name, parser->handler, &bh,
+                             NGX_BENCH_HTTP_BYTES / parser->size + 1,
+                             parser->size);
+    }
+
+    ngx_destroy_pool(pool);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_http_load(ngx_bench_http_t *bh, char *path, ngx_pool_t *pool)
+{
+    u_char                 *p;
+    size_t                  len;
+    DIR                    *dir;
+    ngx_str_t              *name;
+    ngx_uint_t              i;
+    ngx_array_t             names;
+    struct dirent          *de;
+    ngx_file_info_t         fi;
+
+    if (ngx_array_init(&names, pool, 64, sizeof(ngx_str_t)) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    if (ngx_file_info(path, &fi) == NGX_FILE_ERROR) {
+        ngx_log_stderr(ngx_errno, ngx_file_info_n " \"%s\" failed", path);
+        return NGX_ERROR;
+    }
+
+    if (ngx_is_dir(&fi)) {
+        dir = opendir(path);
+        if (dir == NULL) {
+            ngx_log_stderr(ngx_errno, "opendir(\"%s\") failed", path);
+            return NGX_ERROR;
+        }
+
+        while ((de = readdir(dir))) {
+            if (de->d_name[0] == '.') {
+                continue;
+            }
+
+            name = ngx_array_push(&names);
+            if (name == NULL) {
+                closedir(dir);
+                return NGX_ERROR;
+            }
+
+            len = ngx_strlen(path) + 1 + ngx_strlen(de->d_name);
+
+            name->data = ngx_pnalloc(pool, len + 1);
+            if (name->data == NULL) {
+                closedir(dir);
+                return NGX_ERROR;
+            }
+
+            ngx_sprintf(name->data, "%s/%s%Z", path, de->d_name);
+            name->len = len;
+        }
+
+        closedir(dir);
+
+        /* the same order on every run */
+
+        ngx_qsort(names.elts, names.nelts, sizeof(ngx_str_t),
+                  ngx_bench_http_cmp_names);
+
+    } else {
+        name = ngx_array_push(&names);
+        if (name == NULL) {
+            return NGX_ERROR;
+        }
+
+        name->len = ngx_strlen(path);
+        name->data = (u_char *) path;
+    }
+
+    name = names.elts;
+
+    for (i = 0; i < names.nelts; i++) {
+        if (ngx_file_info(name[i].data, &fi) == NGX_FILE_ERROR) {
+            ngx_log_stderr(ngx_errno, ngx_file_info_n " \"%V\" failed",
+                           &name[i]);
+            return NGX_ERROR;
+        }
+
+        if (ngx_is_file(&fi)) {
+            bh->size += ngx_file_size(&fi);
+        }
+    }
+
+    /* one buffer, the reads are cut in the order of the files */
+
+    bh->corpus = ngx_pnalloc(pool, bh->size + 1);
+    if (bh->corpus == NULL) {
+        return NGX_ERROR;
+    }
+
+    p = bh->corpus;
+
+    for (i = 0; i < names.nelts; i++) {
+        if (ngx_file_info(name[i].data, &fi) == NGX_FILE_ERROR
+            || !ngx_is_file(&fi))
+        {
+            continue;
+        }
+
+        len = ngx_min((size_t) ngx_file_size(&fi),
+                      (size_t) (bh->corpus + bh->size - p));
+
+        if (ngx_bench_http_read(bh, &name[i], p, len) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        p += len;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_http_read(ngx_bench_http_t *bh, ngx_str_t *name, u_char *p,
+    size_t size)
+{
+    ssize_t                 n;
+    ngx_fd_t                fd;
+    ngx_bench_http_file_t  *file;
+
+    fd = ngx_open_file(name->data, NGX_FILE_RDONLY, NGX_FILE_OPEN, 0);
+    if (fd == NGX_INVALID_FILE) {
+        ngx_log_stderr(ngx_errno, ngx_open_file_n " \"%V\" failed", name);
+        return NGX_ERROR;
+    }
+
+    file = ngx_array_push(&bh->files);
+    if (file == NULL) {
+        (void) ngx_close_file(fd);
+        return NGX_ERROR;
+    }
+
+    file->start = p;
+    file->end = p + size;
+
+    while (p < file->end) {
+        n = ngx_read_fd(fd, p, file->end - p);
+
+        if (n == -1) {
+            ngx_log_stderr(ngx_errno, ngx_read_fd_n " \"%V\" failed", name);
+            (void) ngx_close_file(fd);
+            return NGX_ERROR;
+        }
+
+        if (n == 0) {
+            /* the file was truncated meanwhile */
+            file->end = p;
+            break;
+        }
+
+        p += n;
+    }
+
+    (void) ngx_close_file(fd);
+
+    return NGX_OK;
+}
+
+
+/*
+ * page loads of a browser, some with uris that need normalization,
+ * api calls with json bodies and chunked uploads
+ */
+
+static ngx_int_t
+ngx_bench_http_generate(ngx_bench_http_t *bh, ngx_pool_t *pool)
+{
+    u_char                 *p, *last, body[NGX_BENCH_HTTP_MESSAGE / 4];
+    size_t                  len;
+    uint32_t                r;
+    ngx_uint_t              i, k, chunks, n;
+    ngx_bench_http_file_t  *file;
+
+    n = ngx_bench_scale(2000);
+
+    bh->corpus = ngx_pnalloc(pool, n * NGX_BENCH_HTTP_MESSAGE);
+    if (bh->corpus == NULL) {
+        return NGX_ERROR;
+    }
+
+    p = bh->corpus;
+
+    for (i = 0; i < n; i++) {
+
+        r = ngx_bench_random() % 20;
+
+        if (r < 12) {
+            p = ngx_sprintf(p,
+                    "GET /static/%s/%ui.%s?v=%uD HTTP/1.1" CRLF
+                    "Host: www.example.com" CRLF
+                    "Connection: keep-alive" CRLF
+                    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) "
+                    "AppleWebKit/537.36 (KHTML, like Gecko) "
+                    "Chrome/44.0.2403.155 Safari/537.36" CRLF
+                    "Accept: image/webp,*/*;q=0.8" CRLF
+                    "Referer: http://www.example.com/catalog/%ui" CRLF
+                    "Accept-Encoding: gzip, deflate, sdch" CRLF
+                    "Accept-Language: en-US,en;q=0.8" CRLF
+                    "Cookie: session=%08xD%08xD; _ga=GA1.2.%uD.%uD" CRLF
+                    CRLF,
+                    (r & 1) ? "img" : "js", i, (r & 1) ? "png" : "js",
+                    ngx_bench_random() % 100, i / 10,
+                    ngx_bench_random(), ngx_bench_random(),
+                    ngx_bench_random(), ngx_bench_random());
+
+        } else if (r < 15) {
+            p = ngx_sprintf(p,
+                    "GET /catalog/%ui/../items//%%7Euser/./list%%20%ui.html"
+                    "?q=a+b&page=%ui HTTP/1.1" CRLF
+                    "Host: www.example.com" CRLF
+                    "User-Agent: curl/7.43.0" CRLF
+                    "Accept: */*" CRLF
+                    CRLF,
+                    i, i, r);
+
+        } else if (r < 18) {
+            last = ngx_sprintf(body,
+                    "{\"id\":%ui,\"name\":\"item-%ui\","
+                    "\"tags\":[\"new\",\"sale\"],\"price\":%uD.99}",
+                    i, i, ngx_bench_random() % 1000);
+            len = last - body;
+
+            p = ngx_sprintf(p,
+                    "POST /api/v1/items/%ui HTTP/1.1" CRLF
+                    "Host: api.example.com" CRLF
+                    "Content-Type: application/json" CRLF
+                    "Content-Length: %uz" CRLF
+                    "Authorization: Bearer %08xD%08xD%08xD" CRLF
+                    CRLF,
+                    i, len, ngx_bench_random(), ngx_bench_random(),
+                    ngx_bench_random());
+
+            p = ngx_cpymem(p, body, len);
+
+        } else {
+            p = ngx_sprintf(p,
+                    "POST /upload/%ui HTTP/1.1" CRLF
+                    "Host: upload.example.com" CRLF
+                    "Content-Type: application/octet-stream" CRLF
+                    "Transfer-Encoding: chunked" CRLF
+                    CRLF,
+                    i);
+
+            chunks = 1 + ngx_bench_random() % 4;
+
+            for (k = 0; k < chunks; k++) {
+                len = 1 + ngx_bench_random() % 256;
+
+                p = ngx_sprintf(p, (k == 0 && (r & 1)) ? "%xz;part=%ui" CRLF
+                                                       : "%xz" CRLF,
+                                len, k);
+                ngx_memset(p, 'a' + k, len);
+                p += len;
+                *p++ = CR; *p++ = LF;
+            }
+
+            p = ngx_sprintf(p, (r & 1) ? "0" CRLF CRLF
+                                       : "0" CRLF "X-Checksum: %08xD" CRLF CRLF,
+                            ngx_bench_random());
+        }
+    }
+
+    bh->size = p - bh->corpus;
+
+    file = ngx_array_push(&bh->files);
+    if (file == NULL) {
+        return NGX_ERROR;
+    }
+
+    file->start = bh->corpus;
+    file->end = p;
+
+    return NGX_OK;
+}
+
+
+/* finds the parts of the messages of a file with whole buffers */
+
+static ngx_int_t
+ngx_bench_http_index(ngx_bench_http_t *bh, ngx_bench_http_file_t *file)
+{
+    off_t                      length, size;
+    ngx_int_t                  rc;
+    ngx_buf_t                  b;
+    ngx_http_chunked_t         ctx;
+    ngx_http_request_t        *r;
+    ngx_bench_http_message_t  *m;
+
+    r = bh->request;
+
+    ngx_memzero(&b, sizeof(ngx_buf_t));
+    b.pos = file->start;
+    b.last = file->end;
+
+    while (b.pos < b.last) {
+
+        m = ngx_array_push(&bh->messages);
+        if (m == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_memzero(m, sizeof(ngx_bench_http_message_t));
+        ngx_memzero(r, sizeof(ngx_http_request_t));
+        r->connection = &bh->connection;
+
+        m->start = b.pos;
+
+        rc = ngx_http_parse_request_line(r, &b);
+        if (rc != NGX_OK) {
+            goto failed;
+        }
+
+        m->headers = b.pos;
+        m->uri_start = r->uri_start;
+        m->uri_end = r->uri_end;
+        m->complex_uri = (r->complex_uri || r->quoted_uri);
+
+        length = 0;
+
+        if (r->http_version >= NGX_HTTP_VERSION_10) {
+            r->state = 0;
+
+            for ( ;; ) {
+                rc = ngx_http_parse_header_line(r, &b, 1);
+
+                if (rc != NGX_OK) {
+                    break;
+                }
+
+                if (r->lowcase_index == sizeof("content-length") - 1
+                    && ngx_strncmp(r->lowcase_header, "content-length",
+                                   sizeof("content-length") - 1)
+                       == 0)
+                {
+                    length = ngx_atoof(r->header_start,
+                                       r->header_end - r->header_start);
+                    if (length == NGX_ERROR) {
+                        rc = NGX_HTTP_PARSE_INVALID_HEADER;
+                        goto failed;
+                    }
+                }
+
+                if (r->lowcase_index == sizeof("transfer-encoding") - 1
+                    && ngx_strncmp(r->lowcase_header, "transfer-encoding",
+                                   sizeof("transfer-encoding") - 1)
+                       == 0
+                    && r->header_end - r->header_start == 7
+                    && ngx_strncasecmp(r->header_start, (u_char *) "chunked",
+                                       7)
+                       == 0)
+                {
+                    m->chunked = 1;
+                }
+            }
+
+            if (rc != NGX_HTTP_PARSE_HEADER_DONE) {
+                goto failed;
+            }
+        }
+
+        m->body = b.pos;
+
+        if (m->chunked) {
+            ngx_memzero(&ctx, sizeof(ngx_http_chunked_t));
+
+            for ( ;; ) {
+                rc = ngx_http_parse_chunked(r, &b, &ctx);
+
+                if (rc != NGX_OK) {
+                    break;
+                }
+
+                size = ngx_min(ctx.size, b.last - b.pos);
+                b.pos += size;
+                ctx.size -= size;
+            }
+
+            if (rc != NGX_DONE) {
+                goto failed;
+            }
+
+        } else {
+            if (length > b.last - b.pos) {
+                rc = NGX_AGAIN;
+                goto failed;
+            }
+
+            b.pos += length;
+        }
+
+        m->end = b.pos;
+    }
+
+    return NGX_OK;
+
+failed:
+
+    /* the rest of the file is not parsed, as nginx closes the connection */
+
+    bh->messages.nelts--;
+
+    if (rc == NGX_AGAIN) {
+        bh->truncated++;
+
+    } else {
+        bh->invalid++;
+    }
+
+    return NGX_OK;
+}
+
+
+static u_char **
+ngx_bench_http_split(ngx_bench_http_t *bh, ngx_uint_t split, ngx_pool_t *pool)
+{
+    u_char   *p, *end, **cuts, **cut;
+
+    cuts = ngx_palloc(pool, (bh->size + 1) * sizeof(u_char *));
+    if (cuts == NULL) {
+        return NULL;
+    }
+
+    cut = cuts;
+    p = bh->corpus;
+    end = bh->corpus + bh->size;
+
+    for ( ;; ) {
+        p += 1 + ngx_bench_random() % split;
+
+        if (p >= end) {
+            break;
+        }
+
+        *cut++ = p;
+    }
+
+    *cut = end;
+
+    return cuts;
+}
+
+
+/* the end of the bytes a read returns, after those up to pos */
+
+static ngx_inline u_char *
+ngx_bench_http_last(ngx_bench_http_t *bh, u_char *pos, u_char *end)
+{
+    while (*bh->cut <= pos) {
+        bh->cut++;
+    }
+
+    return ngx_min(*bh->cut, end);
+}
+
+
+static uintptr_t
+ngx_bench_http_request_line(void *data, ngx_uint_t n)
+{
+    ngx_bench_http_t *bh = data;
+
+    uintptr_t                  sum;
+    ngx_int_t                  rc;
+    ngx_buf_t                  b;
+    ngx_uint_t                 i, k;
+    ngx_http_request_t        *r;
+    ngx_bench_http_message_t  *m;
+
+    r = bh->request;
+    m = bh->messages.elts;
+    sum = 0;
+
+    ngx_memzero(&b, sizeof(ngx_buf_t));
+
+    for (k = 0; k < n; k++) {
+
+        bh->cut = bh->cuts;
+
+        for (i = 0; i < bh->messages.nelts; i++) {
+            r->state = 0;
+
+            b.pos = m[i].start;
+            b.last = ngx_bench_http_last(bh, b.pos, m[i].headers);
+
+            for ( ;; ) {
+                rc = ngx_http_parse_request_line(r, &b);
+
+                if (rc != NGX_AGAIN || b.last == m[i].headers) {
+                    break;
+                }
+
+                b.last = ngx_bench_http_last(bh, b.last, m[i].headers);
+            }
+
+            sum += rc + r->method + (r->uri_end - r->uri_start);
+        }
+    }
+
+    return sum;
+}
+
+
+static uintptr_t
+ngx_bench_http_header_line(void *data, ngx_uint_t n)
+{
+    ngx_bench_http_t *bh = data;
+
+    uintptr_t                  sum;
+    ngx_int_t                  rc;
+    ngx_buf_t                  b;
+    ngx_uint_t                 i, k;
+    ngx_http_request_t        *r;
+    ngx_bench_http_message_t  *m;
+
+    r = bh->request;
+    m = bh->messages.elts;
+    sum = 0;
+
+    ngx_memzero(&b, sizeof(ngx_buf_t));
+
+    for (k = 0; k < n; k++) {
+
+        bh->cut = bh->cuts;
+
+        for (i = 0; i < bh->messages.nelts; i++) {
+            if (m[i].headers == m[i].body) {
+                continue;
+            }
+
+            r->state = 0;
+
+            b.pos = m[i].headers;
+            b.last = ngx_bench_http_last(bh, b.pos, m[i].body);
+
+            for ( ;; ) {
+                rc = ngx_http_parse_header_line(r, &b, 1);
+
+                if (rc == NGX_OK) {
+                    sum += r->header_hash;
+                    continue;
+                }
+
+                if (rc != NGX_AGAIN || b.last == m[i].body) {
+                    break;
+                }
+
+                b.last = ngx_bench_http_last(bh, b.last, m[i].body);
+            }
+
+            sum += rc;
+        }
+    }
+
+    return sum;
+}
+
+
+/* the uri is in one buffer by the time it is normalized */
+
+static uintptr_t
+ngx_bench_http_complex_uri(void *data, ngx_uint_t n)
+{
+    ngx_bench_http_t *bh = data;
+
+    uintptr_t                  sum;
+    ngx_uint_t                 i, k;
+    ngx_http_request_t        *r;
+    ngx_bench_http_message_t  *m;
+
+    r = bh->request;
+    m = bh->messages.elts;
+    sum = 0;
+
+    for (k = 0; k < n; k++) {
+        for (i = 0; i < bh->messages.nelts; i++) {
+            if (!m[i].complex_uri) {
+                continue;
+            }
+
+            r->uri_start = m[i].uri_start;
+            r->uri_end = m[i].uri_end;
+            r->uri.data = bh->uri;
+
+            sum += ngx_http_parse_complex_uri(r, 1) + r->uri.len;
+        }
+    }
+
+    return sum;
+}
+
+
+static uintptr_t
+ngx_bench_http_chunked(void *data, ngx_uint_t n)
+{
+    ngx_bench_http_t *bh = data;
+
+    off_t                      size;
+    uintptr_t                  sum;
+    ngx_int_t                  rc;
+    ngx_buf_t                  b;
+    ngx_uint_t                 i, k;
+    ngx_http_chunked_t         ctx;
+    ngx_bench_http_message_t  *m;
+
+    m = bh->messages.elts;
+    sum = 0;
+
+    ngx_memzero(&b, sizeof(ngx_buf_t));
+
+    for (k = 0; k < n; k++) {
+
+        bh->cut = bh->cuts;
+
+        for (i = 0; i < bh->messages.nelts; i++) {
+            if (!m[i].chunked) {
+                continue;
+            }
+
+            ngx_memzero(&ctx, sizeof(ngx_http_chunked_t));
+
+            b.pos = m[i].body;
+            b.last = ngx_bench_http_last(bh, b.pos, m[i].end);
+
+            for ( ;; ) {
+                rc = ngx_http_parse_chunked(bh->request, &b, &ctx);
+
+                if (rc == NGX_OK) {
+                    size = ngx_min(ctx.size, b.last - b.pos);
+                    b.pos += size;
+                    ctx.size -= size;
+                    sum += size;
+                    continue;
+                }
+
+                if (rc != NGX_AGAIN || b.last == m[i].end) {
+                    break;
+                }
+
+                b.last = ngx_bench_http_last(bh, b.last, m[i].end);
+            }
+
+            sum += rc;
+        }
+    }
+
+    return sum;
+}
+
+
+static int ngx_libc_cdecl
+ngx_bench_http_cmp_names(const void *one, const void *two)
+{
+    ngx_str_t  *first, *second;
+
+    first = (ngx_str_t *) one;
+    second = (ngx_str_t *) two;
+
+    return ngx_strcmp(first->data, second->data);
+}
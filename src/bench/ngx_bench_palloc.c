@@ -0,0 +1,168 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_bench.h>
+
+
+/*
+ * The allocations of a request: a pool is created, a few dozen small
+ * objects are taken from it, and it is destroyed.  The same pattern
+ * with malloc() and free() of every object is the baseline.  Large
+ * allocations go through ngx_palloc_large() and are measured apart.
+ * The pools are measured again with the block cache of workers.
+ */
+
+
+#define NGX_BENCH_PALLOC_PER_POOL  64
+#define NGX_BENCH_PALLOC_LARGE     (8 * 1024)
+
+
+typedef struct {
+    ngx_log_t    *log;
+    size_t        size;
+    ngx_uint_t    random;
+    void         *objects[NGX_BENCH_PALLOC_PER_POOL];
+} ngx_bench_palloc_t;
+
+
+static uintptr_t ngx_bench_palloc_pool(void *data, ngx_uint_t n);
+static uintptr_t ngx_bench_palloc_malloc(void *data, ngx_uint_t n);
+static size_t ngx_bench_palloc_size(ngx_bench_palloc_t *bp, ngx_uint_t i);
+
+
+ngx_int_t
+ngx_bench_palloc(ngx_log_t *log)
+{
+    ngx_bench_palloc_t  bp;
+
+    bp.log = log;
+
+    /* 16 to 256 bytes, as headers, variables and strings of a request */
+
+    bp.size = 0;
+    bp.random = ngx_bench_random();
+
+    ngx_bench_measure("palloc_small", ngx_bench_palloc_pool, &bp, 1000000);
+    ngx_bench_measure("malloc_small", ngx_bench_palloc_malloc, &bp, 1000000);
+
+    bp.size = NGX_BENCH_PALLOC_LARGE;
+
+    ngx_bench_measure("palloc_large", ngx_bench_palloc_pool, &bp, 200000);
+    ngx_bench_measure("malloc_large", ngx_bench_palloc_malloc, &bp, 200000);
+
+    if (ngx_pool_cache_init((ngx_cycle_t *) ngx_cycle, 128, 64) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    bp.size = 0;
+
+    ngx_bench_measure("palloc_small_cached", ngx_bench_palloc_pool, &bp,
+                      1000000);
+
+    ngx_free(ngx_cycle->pool_cache);
+    ngx_cycle->pool_cache = NULL;
+
+    return NGX_OK;
+}
+
+
+static uintptr_t
+ngx_bench_palloc_pool(void *data, ngx_uint_t n)
+{
+    ngx_bench_palloc_t *bp = data;
+
+    u_char      *p;
+    uintptr_t    sum;
+    ngx_uint_t   i;
+    ngx_pool_t  *pool;
+
+    sum = 0;
+    pool = NULL;
+
+    for (i = 0; i < n; i++) {
+
+        if (i % NGX_BENCH_PALLOC_PER_POOL == 0) {
+            if (pool) {
+                ngx_destroy_pool(pool);
+            }
+
+            pool = ngx_create_pool(NGX_DEFAULT_POOL_SIZE, bp->log);
+            if (pool == NULL) {
+                return 0;
+            }
+        }
+
+        p = ngx_palloc(pool, ngx_bench_palloc_size(bp, i));
+        if (p == NULL) {
+            break;
+        }
+
+        *p = (u_char) i;
+        sum += *p;
+    }
+
+    if (pool) {
+        ngx_destroy_pool(pool);
+    }
+
+    return sum;
+}
+
+
+static uintptr_t
+ngx_bench_palloc_malloc(void *data, ngx_uint_t n)
+{
+    ngx_bench_palloc_t *bp = data;
+
+    u_char      *p;
+    uintptr_t    sum;
+    ngx_uint_t   i, k;
+
+    sum = 0;
+
+    for (i = 0; i < n; i++) {
+        k = i % NGX_BENCH_PALLOC_PER_POOL;
+
+        if (k == 0 && i) {
+            for (k = 0; k < NGX_BENCH_PALLOC_PER_POOL; k++) {
+                free(bp->objects[k]);
+            }
+
+            k = 0;
+        }
+
+        p = malloc(ngx_bench_palloc_size(bp, i));
+        if (p == NULL) {
+            return 0;
+        }
+
+        *p = (u_char) i;
+        sum += *p;
+
+        bp->objects[k] = p;
+    }
+
+    k = (n - 1) % NGX_BENCH_PALLOC_PER_POOL;
+
+    do {
+        free(bp->objects[k]);
+    } while (k--);
+
+    return sum;
+}
+
+
+static size_t
+ngx_bench_palloc_size(ngx_bench_palloc_t *bp, ngx_uint_t i)
+{
+    if (bp->size) {
+        return bp->size;
+    }
+
+    return 16 + ((i * 2654435761u + bp->random) >> 7) % 241;
+}
@@ -0,0 +1,325 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_bench.h>
+
+
+/*
+ * Longest prefix matches in a routing table, as the geo module does.
+ * With "prefixes=file" the IPv4 table is read from a dump of "a.b.c.d/len"
+ * lines, such as a full BGP table; otherwise a table of the same shape
+ * is generated: prefixes clustered in allocations, with the prefix
+ * length mix of the global routing table, where a /24 is more than half
+ * of all prefixes.
+ */
+
+
+#define NGX_BENCH_RADIX_LOOKUPS  65536
+
+
+typedef struct {
+    ngx_radix_tree_t  *tree;
+    uint32_t          *addrs;
+#if (NGX_HAVE_INET6)
+    u_char            *addrs6;
+#endif
+} ngx_bench_radix_t;
+
+
+static ngx_int_t ngx_bench_radix_read(ngx_bench_radix_t *br, char *file,
+    ngx_uint_t *n);
+static ngx_int_t ngx_bench_radix_generate(ngx_bench_radix_t *br,
+    ngx_uint_t n);
+static uint32_t ngx_bench_radix_len(void);
+static uintptr_t ngx_bench_radix_find(void *data, ngx_uint_t n);
+#if (NGX_HAVE_INET6)
+static ngx_int_t ngx_bench_radix_generate6(ngx_bench_radix_t *br,
+    ngx_uint_t n);
+static uintptr_t ngx_bench_radix_find6(void *data, ngx_uint_t n);
+#endif
+
+
+/* percents of the prefixes by length, /8 to /24 */
+
+static ngx_uint_t  ngx_bench_radix_lens[] = {
+    1, 0, 0, 0, 0, 0, 0, 1, 2, 1, 2, 3, 5, 5, 12, 10, 58
+};
+
+
+ngx_int_t
+ngx_bench_radix(ngx_log_t *log)
+{
+    char               *file;
+    ngx_uint_t          n;
+    ngx_pool_t         *pool;
+    ngx_bench_radix_t   br;
+
+    pool = ngx_create_pool(NGX_DEFAULT_POOL_SIZE, log);
+    if (pool == NULL) {
+        return NGX_ERROR;
+    }
+
+    br.tree = ngx_radix_tree_create(pool, -1);
+    br.addrs = ngx_palloc(pool, NGX_BENCH_RADIX_LOOKUPS * sizeof(uint32_t));
+    if (br.tree == NULL || br.addrs == NULL) {
+        return NGX_ERROR;
+    }
+
+    file = ngx_bench_arg("prefixes");
+
+    if (file) {
+        if (ngx_bench_radix_read(&br, file, &n) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+    } else {
+        n = ngx_bench_scale(200000);
+
+        if (ngx_bench_radix_generate(&br, n) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    ngx_bench_measure("radix32tree_find", ngx_bench_radix_find, &br,
+                      1000000);
+
+#if (NGX_HAVE_INET6)
+
+    br.tree = ngx_radix_tree_create(pool, -1);
+    br.addrs6 = ngx_palloc(pool, NGX_BENCH_RADIX_LOOKUPS * 16);
+    if (br.tree == NULL || br.addrs6 == NULL) {
+        return NGX_ERROR;
+    }
+
+    if (ngx_bench_radix_generate6(&br, n / 4) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ngx_bench_measure("radix128tree_find", ngx_bench_radix_find6, &br,
+                      1000000);
+
+#endif
+
+    ngx_destroy_pool(pool);
+
+    return NGX_OK;
+}
+
+
+/* the lookups are addresses within the prefixes read */
+
+static ngx_int_t
+ngx_bench_radix_read(ngx_bench_radix_t *br, char *file, ngx_uint_t *n)
+{
+    FILE        *f;
+    char         line[128];
+    uint32_t     key, mask;
+    ngx_uint_t   i, a, b, c, d, len;
+
+    f = fopen(file, "r");
+    if (f == NULL) {
+        ngx_log_stderr(ngx_errno, "fopen(\"%s\") failed", file);
+        return NGX_ERROR;
+    }
+
+    i = 0;
+
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%lu.%lu.%lu.%lu/%lu", &a, &b, &c, &d, &len) != 5
+            || a > 255 || b > 255 || c > 255 || d > 255 || len > 32)
+        {
+            continue;
+        }
+
+        mask = len ? (uint32_t) 0xffffffff << (32 - len) : 0;
+        key = (a << 24 | b << 16 | c << 8 | d) & mask;
+
+        if (ngx_radix32tree_insert(br->tree, key, mask, i + 1) == NGX_ERROR) {
+            fclose(f);
+            return NGX_ERROR;
+        }
+
+        br->addrs[i % NGX_BENCH_RADIX_LOOKUPS] =
+                                        key | (ngx_bench_random() & ~mask);
+        i++;
+    }
+
+    fclose(f);
+
+    if (i < NGX_BENCH_RADIX_LOOKUPS) {
+        ngx_log_stderr(0, "too few prefixes in \"%s\"", file);
+        return NGX_ERROR;
+    }
+
+    *n = i;
+
+    return NGX_OK;
+}
+
+
+/*
+ * a quarter of the lookups miss the table, the rest are within one
+ * of its prefixes
+ */
+
+static ngx_int_t
+ngx_bench_radix_generate(ngx_bench_radix_t *br, ngx_uint_t n)
+{
+    uint32_t     block, key, mask, len;
+    ngx_uint_t   i;
+
+    block = 0;
+
+    for (i = 0; i < n; i++) {
+
+        /* about ten prefixes in each /16 allocation */
+
+        if (i % 10 == 0) {
+            block = (ngx_bench_random() % 223 + 1) << 24
+                    | (ngx_bench_random() & 0xff) << 16;
+        }
+
+        len = ngx_bench_radix_len();
+        mask = (uint32_t) 0xffffffff << (32 - len);
+
+        if (len > 16) {
+            key = (block | (ngx_bench_random() & 0xffff)) & mask;
+
+        } else {
+            key = block & mask;
+        }
+
+        if (ngx_radix32tree_insert(br->tree, key, mask, i + 1) == NGX_ERROR) {
+            return NGX_ERROR;
+        }
+
+        if (i < NGX_BENCH_RADIX_LOOKUPS) {
+            br->addrs[i] = (i % 4 == 3) ? ngx_bench_random()
+                                        : key | (ngx_bench_random() & ~mask);
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static uint32_t
+ngx_bench_radix_len(void)
+{
+    ngx_uint_t  i, r;
+
+    r = ngx_bench_random() % 100;
+
+    for (i = 0; i < sizeof(ngx_bench_radix_lens) / sizeof(ngx_uint_t); i++) {
+        if (r < ngx_bench_radix_lens[i]) {
+            return 8 + i;
+        }
+
+        r -= ngx_bench_radix_lens[i];
+    }
+
+    return 24;
+}
+
+
+static uintptr_t
+ngx_bench_radix_find(void *data, ngx_uint_t n)
+{
+    ngx_bench_radix_t *br = data;
+
+    uintptr_t   sum;
+    ngx_uint_t  i;
+
+    sum = 0;
+
+    for (i = 0; i < n; i++) {
+        sum += ngx_radix32tree_find(br->tree,
+                                    br->addrs[i % NGX_BENCH_RADIX_LOOKUPS])
+               != NGX_RADIX_NO_VALUE;
+    }
+
+    return sum;
+}
+
+
+#if (NGX_HAVE_INET6)
+
+/* 2000::/3, mostly /48 sites and /32 providers */
+
+static ngx_int_t
+ngx_bench_radix_generate6(ngx_bench_radix_t *br, ngx_uint_t n)
+{
+    u_char      key[16], mask[16], *addr;
+    uint32_t    r;
+    ngx_uint_t  i, j, len;
+
+    for (i = 0; i < n; i++) {
+
+        r = ngx_bench_random() % 100;
+        len = (r < 50) ? 48 : (r < 70) ? 32 : (r < 85) ? 44 : 40;
+
+        for (j = 0; j < 16; j++) {
+            key[j] = (u_char) ngx_bench_random();
+            mask[j] = (j * 8 + 8 <= len) ? 0xff
+                      : (j * 8 < len) ? (u_char) (0xff << (j * 8 + 8 - len))
+                      : 0;
+        }
+
+        /* clustered under a few thousand /24 registry blocks */
+
+        key[0] = 0x20 | (key[0] & 0x0f);
+        key[1] = (u_char) (i % 61);
+        key[2] = (u_char) (i / 61 % 64);
+
+        if (i < NGX_BENCH_RADIX_LOOKUPS) {
+            addr = &br->addrs6[i * 16];
+
+            for (j = 0; j < 16; j++) {
+                addr[j] = (key[j] & mask[j])
+                          | ((u_char) ngx_bench_random() & ~mask[j]);
+            }
+
+            if (i % 4 == 3) {
+                addr[0] = 0x3f;
+            }
+        }
+
+        for (j = 0; j < 16; j++) {
+            key[j] &= mask[j];
+        }
+
+        if (ngx_radix128tree_insert(br->tree, key, mask, i + 1) == NGX_ERROR)
+        {
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static uintptr_t
+ngx_bench_radix_find6(void *data, ngx_uint_t n)
+{
+    ngx_bench_radix_t *br = data;
+
+    uintptr_t   sum;
+    ngx_uint_t  i;
+
+    sum = 0;
+
+    for (i = 0; i < n; i++) {
+        sum += ngx_radix128tree_find(br->tree,
+                             &br->addrs6[i % NGX_BENCH_RADIX_LOOKUPS * 16])
+               != NGX_RADIX_NO_VALUE;
+    }
+
+    return sum;
+}
+
+#endif
@@ -0,0 +1,127 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_bench.h>
+
+
+/*
+ * The event timer tree of a busy worker: every connection has a timer
+ * of one of a few timeouts, and time moves on by a millisecond per
+ * operation.  A re-armed timer is deleted and inserted again, an expired
+ * one is the minimum of the tree and comes back with a new timeout.
+ */
+
+
+typedef struct {
+    ngx_rbtree_t        tree;
+    ngx_rbtree_node_t   sentinel;
+    ngx_rbtree_node_t  *nodes;
+    ngx_uint_t          n;
+    ngx_msec_t          now;
+    uint32_t           *random;
+} ngx_bench_rbtree_t;
+
+
+#define NGX_BENCH_RBTREE_RANDOM  65536
+
+
+static uintptr_t ngx_bench_rbtree_rearm(void *data, ngx_uint_t n);
+static uintptr_t ngx_bench_rbtree_expire(void *data, ngx_uint_t n);
+
+
+/* client_header, keepalive, send and proxy_read timeouts */
+
+static ngx_msec_t  ngx_bench_rbtree_timeouts[] = {
+    60000, 75000, 60000, 60000
+};
+
+
+ngx_int_t
+ngx_bench_rbtree(ngx_log_t *log)
+{
+    ngx_uint_t           i;
+    ngx_bench_rbtree_t   br;
+
+    br.n = ngx_bench_scale(10000);
+
+    br.nodes = ngx_alloc(br.n * sizeof(ngx_rbtree_node_t), log);
+    br.random = ngx_alloc(NGX_BENCH_RBTREE_RANDOM * sizeof(uint32_t), log);
+    if (br.nodes == NULL || br.random == NULL) {
+        return NGX_ERROR;
+    }
+
+    for (i = 0; i < NGX_BENCH_RBTREE_RANDOM; i++) {
+        br.random[i] = ngx_bench_random();
+    }
+
+    ngx_rbtree_init(&br.tree, &br.sentinel, ngx_rbtree_insert_timer_value);
+
+    br.now = 1000000;
+
+    for (i = 0; i < br.n; i++) {
+        br.nodes[i].key = br.now + br.random[i % NGX_BENCH_RBTREE_RANDOM]
+                                   % 75000;
+        ngx_rbtree_insert(&br.tree, &br.nodes[i]);
+    }
+
+    ngx_bench_measure("rbtree_timer_rearm", ngx_bench_rbtree_rearm, &br,
+                      1000000);
+    ngx_bench_measure("rbtree_timer_expire", ngx_bench_rbtree_expire, &br,
+                      1000000);
+
+    ngx_free(br.random);
+    ngx_free(br.nodes);
+
+    return NGX_OK;
+}
+
+
+static uintptr_t
+ngx_bench_rbtree_rearm(void *data, ngx_uint_t n)
+{
+    ngx_bench_rbtree_t *br = data;
+
+    uint32_t            r;
+    ngx_uint_t          i;
+    ngx_rbtree_node_t  *node;
+
+    for (i = 0; i < n; i++) {
+        r = br->random[i % NGX_BENCH_RBTREE_RANDOM];
+        node = &br->nodes[r % br->n];
+
+        ngx_rbtree_delete(&br->tree, node);
+
+        node->key = br->now++ + ngx_bench_rbtree_timeouts[r >> 30];
+        ngx_rbtree_insert(&br->tree, node);
+    }
+
+    return ngx_rbtree_min(br->tree.root, br->tree.sentinel)->key;
+}
+
+
+static uintptr_t
+ngx_bench_rbtree_expire(void *data, ngx_uint_t n)
+{
+    ngx_bench_rbtree_t *br = data;
+
+    uint32_t            r;
+    ngx_uint_t          i;
+    ngx_rbtree_node_t  *node;
+
+    for (i = 0; i < n; i++) {
+        r = br->random[i % NGX_BENCH_RBTREE_RANDOM];
+        node = ngx_rbtree_min(br->tree.root, br->tree.sentinel);
+
+        ngx_rbtree_delete(&br->tree, node);
+
+        node->key = br->now++ + ngx_bench_rbtree_timeouts[r >> 30];
+        ngx_rbtree_insert(&br->tree, node);
+    }
+
+    return ngx_rbtree_min(br->tree.root, br->tree.sentinel)->key;
+}
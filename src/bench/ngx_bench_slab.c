@@ -0,0 +1,226 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_bench.h>
+
+
+/*
+ * Allocations in a shared memory zone of a slab pool, as the cache
+ * keys, limit_req and ssl session zones do: a working set of objects
+ * is kept, and every operation frees a random one of them and
+ * allocates its replacement.  The zone is ordinary memory here and
+ * locking is left out, the benchmarks time the allocator only.  The same
+ * churn is measured again through the magazines of a worker.
+ */
+
+
+#define NGX_BENCH_SLAB_SIZE    (32 * 1024 * 1024)
+#define NGX_BENCH_SLAB_RANDOM  65536
+
+
+typedef struct {
+    ngx_slab_pool_t   *pool;
+    void             **objects;
+    ngx_uint_t         n;
+    size_t            *sizes;
+    uint32_t          *random;
+} ngx_bench_slab_t;
+
+
+static ngx_int_t ngx_bench_slab_fill(ngx_bench_slab_t *bs, size_t *sizes,
+    ngx_uint_t nsizes);
+static void ngx_bench_slab_empty(ngx_bench_slab_t *bs);
+static uintptr_t ngx_bench_slab_churn(void *data, ngx_uint_t n);
+static uintptr_t ngx_bench_slab_churn_cached(void *data, ngx_uint_t n);
+
+
+/* the sizes of cache nodes, limit_req nodes and ssl sessions */
+
+static size_t  ngx_bench_slab_small[] = { 64 };
+
+static size_t  ngx_bench_slab_mixed[] = {
+    16, 48, 64, 96, 128, 200, 300, 512, 1000, 2048, 3000, 8192
+};
+
+
+ngx_int_t
+ngx_bench_slab(ngx_log_t *log)
+{
+    u_char            *addr;
+    ngx_uint_t         i;
+    ngx_bench_slab_t   bs;
+
+    addr = ngx_alloc(NGX_BENCH_SLAB_SIZE, log);
+    if (addr == NULL) {
+        return NGX_ERROR;
+    }
+
+    /* as ngx_init_zone_pool() does */
+
+    bs.pool = (ngx_slab_pool_t *) addr;
+    bs.pool->end = addr + NGX_BENCH_SLAB_SIZE;
+    bs.pool->min_shift = 3;
+    bs.pool->addr = addr;
+
+    if (ngx_shmtx_create(&bs.pool->mutex, &bs.pool->lock, NULL) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ngx_slab_init(bs.pool);
+
+    bs.n = ngx_bench_scale(20000);
+
+    bs.objects = ngx_alloc(bs.n * sizeof(void *), log);
+    bs.sizes = ngx_alloc(bs.n * sizeof(size_t), log);
+    bs.random = ngx_alloc(NGX_BENCH_SLAB_RANDOM * sizeof(uint32_t), log);
+    if (bs.objects == NULL || bs.sizes == NULL || bs.random == NULL) {
+        return NGX_ERROR;
+    }
+
+    for (i = 0; i < NGX_BENCH_SLAB_RANDOM; i++) {
+        bs.random[i] = ngx_bench_random();
+    }
+
+    if (ngx_bench_slab_fill(&bs, ngx_bench_slab_small,
+                            sizeof(ngx_bench_slab_small) / sizeof(size_t))
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    ngx_bench_measure("slab_churn_small", ngx_bench_slab_churn, &bs,
+                      1000000);
+
+    ngx_bench_slab_empty(&bs);
+
+    if (ngx_bench_slab_fill(&bs, ngx_bench_slab_mixed,
+                            sizeof(ngx_bench_slab_mixed) / sizeof(size_t))
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    ngx_bench_measure("slab_churn_mixed", ngx_bench_slab_churn, &bs,
+                      1000000);
+
+    ngx_slab_magazines_init();
+
+    ngx_bench_measure("slab_churn_mixed_cached", ngx_bench_slab_churn_cached,
+                      &bs, 1000000);
+
+    ngx_bench_slab_empty(&bs);
+
+    if (ngx_bench_slab_fill(&bs, ngx_bench_slab_small,
+                            sizeof(ngx_bench_slab_small) / sizeof(size_t))
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    ngx_bench_measure("slab_churn_small_cached", ngx_bench_slab_churn_cached,
+                      &bs, 1000000);
+
+    ngx_bench_slab_empty(&bs);
+
+    ngx_slab_magazines_flush();
+
+    ngx_free(bs.random);
+    ngx_free(bs.sizes);
+    ngx_free(bs.objects);
+    ngx_free(addr);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_bench_slab_fill(ngx_bench_slab_t *bs, size_t *sizes, ngx_uint_t nsizes)
+{
+    ngx_uint_t  i;
+
+    for (i = 0; i < bs->n; i++) {
+        bs->sizes[i] = sizes[ngx_bench_random() % nsizes];
+
+        bs->objects[i] = ngx_slab_alloc_locked(bs->pool, bs->sizes[i]);
+        if (bs->objects[i] == NULL) {
+            ngx_log_stderr(0, "slab zone is too small for scale");
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_bench_slab_empty(ngx_bench_slab_t *bs)
+{
+    ngx_uint_t  i;
+
+    for (i = 0; i < bs->n; i++) {
+        ngx_slab_free_locked(bs->pool, bs->objects[i]);
+    }
+}
+
+
+static uintptr_t
+ngx_bench_slab_churn(void *data, ngx_uint_t n)
+{
+    ngx_bench_slab_t *bs = data;
+
+    void        *p;
+    uintptr_t    sum;
+    ngx_uint_t   i, k;
+
+    sum = 0;
+
+    for (i = 0; i < n; i++) {
+        k = bs->random[i % NGX_BENCH_SLAB_RANDOM] % bs->n;
+
+        ngx_slab_free_locked(bs->pool, bs->objects[k]);
+
+        p = ngx_slab_alloc_locked(bs->pool, bs->sizes[k]);
+        if (p == NULL) {
+            return 0;
+        }
+
+        bs->objects[k] = p;
+        sum += p != NULL;
+    }
+
+    return sum;
+}
+
+
+static uintptr_t
+ngx_bench_slab_churn_cached(void *data, ngx_uint_t n)
+{
+    ngx_bench_slab_t *bs = data;
+
+    void        *p;
+    uintptr_t    sum;
+    ngx_uint_t   i, k;
+
+    sum = 0;
+
+    for (i = 0; i < n; i++) {
+        k = bs->random[i % NGX_BENCH_SLAB_RANDOM] % bs->n;
+
+        ngx_slab_free_cached_locked(bs->pool, bs->objects[k]);
+
+        p = ngx_slab_alloc_cached_locked(bs->pool, bs->sizes[k]);
+        if (p == NULL) {
+            return 0;
+        }
+
+        bs->objects[k] = p;
+        sum += p != NULL;
+    }
+
+    return sum;
+}
@@ -0,0 +1,414 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_bench.h>
+
+
+/*
+ * The event timers of a worker with a million idle connections, kept in
+ * the rbtree and in the timer wheel.  "rearm" deletes a random timer and
+ * adds it again, as a read on a keepalive connection does; "find" is the
+ * nearest timer before waiting for events; "loop" is an iteration of the
+ * event loop, one millisecond later than the previous one: the expired
+ * timers come back with a new timeout and some connections are active.
+ * Before the timing, both are run over the same timers and must expire
+ * the same timers on every millisecond.
+ */
+
+
+#define NGX_BENCH_TIMER_RANDOM  65536
+#define NGX_BENCH_TIMER_ACTIVE  16
+#define NGX_BENCH_TIMER_CHECK   200000
+
+
+typedef struct {
+    ngx_rbtree_t        tree;
+    ngx_rbtree_node_t   sentinel;
+    ngx_timer_wheel_t  *wheel;
+    ngx_rbtree_node_t  *nodes;
+    ngx_uint_t          n;
+    ngx_msec_t          now;
+    ngx_uint_t          next;
+    uint32_t           *random;
+} ngx_bench_timer_t;
+
+
+static void ngx_bench_timer_fill(ngx_bench_timer_t *bt);
+static ngx_int_t ngx_bench_timer_check(ngx_bench_timer_t *rb,
+    ngx_bench_timer_t *wh, ngx_log_t *log);
+static uintptr_t ngx_bench_timer_rbtree_rearm(void *data, ngx_uint_t n);
+static uintptr_t ngx_bench_timer_wheel_rearm(void *data, ngx_uint_t n);
+static uintptr_t ngx_bench_timer_rbtree_find(void *data, ngx_uint_t n);
+static uintptr_t ngx_bench_timer_wheel_find(void *data, ngx_uint_t n);
+static uintptr_t ngx_bench_timer_rbtree_loop(void *data, ngx_uint_t n);
+static uintptr_t ngx_bench_timer_wheel_loop(void *data, ngx_uint_t n);
+
+
+/* client_header, keepalive, send and proxy_read timeouts */
+
+static ngx_msec_t  ngx_bench_timer_timeouts[] = {
+    60000, 75000, 60000, 60000
+};
+
+
+ngx_int_t
+ngx_bench_timer(ngx_log_t *log)
+{
+    ngx_int_t          rc;
+    ngx_uint_t         i;
+    ngx_bench_timer_t  rb, wh;
+
+    rb.n = ngx_bench_scale(1000000);
+
+    rb.nodes = ngx_alloc(rb.n * sizeof(ngx_rbtree_node_t), log);
+    rb.random = ngx_alloc(NGX_BENCH_TIMER_RANDOM * sizeof(uint32_t), log);
+    wh.nodes = ngx_alloc(rb.n * sizeof(ngx_rbtree_node_t), log);
+    wh.wheel = ngx_alloc(sizeof(ngx_timer_wheel_t), log);
+
+    if (rb.nodes == NULL || rb.random == NULL
+        || wh.nodes == NULL || wh.wheel == NULL)
+    {
+        return NGX_ERROR;
+    }
+
+    for (i = 0; i < NGX_BENCH_TIMER_RANDOM; i++) {
+        rb.random[i] = ngx_bench_random();
+    }
+
+    rb.wheel = NULL;
+    wh.n = rb.n;
+    wh.random = rb.random;
+
+    ngx_bench_timer_fill(&rb);
+    ngx_bench_timer_fill(&wh);
+
+    rc = ngx_bench_timer_check(&rb, &wh, log);
+
+    if (rc == NGX_OK) {
+        ngx_bench_measure("timer_rbtree_rearm", ngx_bench_timer_rbtree_rearm,
+                          &rb, 1000000);
+        ngx_bench_measure("timer_wheel_rearm", ngx_bench_timer_wheel_rearm,
+                          &wh, 1000000);
+        ngx_bench_measure("timer_rbtree_find", ngx_bench_timer_rbtree_find,
+                          &rb, 1000000);
+        ngx_bench_measure("timer_wheel_find", ngx_bench_timer_wheel_find,
+                          &wh, 1000000);
+        ngx_bench_measure("timer_rbtree_loop", ngx_bench_timer_rbtree_loop,
+                          &rb, 100000);
+        ngx_bench_measure("timer_wheel_loop", ngx_bench_timer_wheel_loop,
+                          &wh, 100000);
+    }
+
+    ngx_free(wh.wheel);
+    ngx_free(wh.nodes);
+    ngx_free(rb.random);
+    ngx_free(rb.nodes);
+
+    return rc;
+}
+
+
+static void
+ngx_bench_timer_fill(ngx_bench_timer_t *bt)
+{
+    ngx_uint_t  i;
+
+    bt->now = 1000000;
+    bt->next = 0;
+
+    if (bt->wheel) {
+        ngx_timer_wheel_init(bt->wheel, bt->now);
+
+    } else {
+        ngx_rbtree_init(&bt->tree, &bt->sentinel,
+                        ngx_rbtree_insert_timer_value);
+    }
+
+    for (i = 0; i < bt->n; i++) {
+        bt->nodes[i].key = bt->now + bt->random[i % NGX_BENCH_TIMER_RANDOM]
+                                     % 75000;
+
+        if (bt->wheel) {
+            ngx_timer_wheel_insert(bt->wheel, &bt->nodes[i]);
+
+        } else {
+            ngx_rbtree_insert(&bt->tree, &bt->nodes[i]);
+        }
+    }
+}
+
+
+/*
+ * both make the same changes, so on every millisecond the same number
+ * of the same timers expire, and the wheel never waits past the nearest
+ * timer of the rbtree
+ */
+
+static ngx_int_t
+ngx_bench_timer_check(ngx_bench_timer_t *rb, ngx_bench_timer_t *wh,
+    ngx_log_t *log)
+{
+    uint32_t            r;
+    ngx_uint_t          i, j, n1, n2, x1, x2;
+    ngx_msec_t          timeout;
+    ngx_rbtree_node_t  *node;
+
+    for (i = 0; i < NGX_BENCH_TIMER_CHECK; i++) {
+
+        node = ngx_rbtree_min(rb->tree.root, rb->tree.sentinel);
+
+        if ((ngx_msec_int_t) (ngx_timer_wheel_min(wh->wheel) - node->key)
+            > 0)
+        {
+            ngx_log_error(NGX_LOG_EMERG, log, 0,
+                          "timer wheel min %M is after %M at %M",
+                          ngx_timer_wheel_min(wh->wheel), node->key, rb->now);
+            return NGX_ERROR;
+        }
+
+        rb->now++;
+        wh->now++;
+
+        r = rb->random[rb->next++ % NGX_BENCH_TIMER_RANDOM];
+        wh->next++;
+
+        timeout = ngx_bench_timer_timeouts[r >> 30];
+
+        n1 = 0;
+        x1 = 0;
+
+        for ( ;; ) {
+            node = ngx_rbtree_min(rb->tree.root, rb->tree.sentinel);
+
+            if ((ngx_msec_int_t) (node->key - rb->now) > 0) {
+                break;
+            }
+
+            ngx_rbtree_delete(&rb->tree, node);
+
+            n1++;
+            x1 ^= node - rb->nodes;
+
+            node->key = rb->now + timeout;
+            ngx_rbtree_insert(&rb->tree, node);
+        }
+
+        n2 = 0;
+        x2 = 0;
+
+        for ( ;; ) {
+            node = ngx_timer_wheel_expired(wh->wheel, wh->now);
+
+            if (node == NULL) {
+                break;
+            }
+
+            ngx_timer_wheel_delete(wh->wheel, node);
+
+            n2++;
+            x2 ^= node - wh->nodes;
+
+            node->key = wh->now + timeout;
+            ngx_timer_wheel_insert(wh->wheel, node);
+        }
+
+        if (n1 != n2 || x1 != x2) {
+            ngx_log_error(NGX_LOG_EMERG, log, 0,
+                          "timer wheel expired %ui timers, rbtree %ui, at %M",
+                          n2, n1, rb->now);
+            return NGX_ERROR;
+        }
+
+        for (j = 0; j < NGX_BENCH_TIMER_ACTIVE; j++) {
+            r = rb->random[rb->next++ % NGX_BENCH_TIMER_RANDOM];
+            wh->next++;
+
+            node = &rb->nodes[r % rb->n];
+            ngx_rbtree_delete(&rb->tree, node);
+            node->key = rb->now + ngx_bench_timer_timeouts[r >> 30];
+            ngx_rbtree_insert(&rb->tree, node);
+
+            node = &wh->nodes[r % wh->n];
+            ngx_timer_wheel_delete(wh->wheel, node);
+            node->key = wh->now + ngx_bench_timer_timeouts[r >> 30];
+            ngx_timer_wheel_insert(wh->wheel, node);
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static uintptr_t
+ngx_bench_timer_rbtree_rearm(void *data, ngx_uint_t n)
+{
+    ngx_bench_timer_t *bt = data;
+
+    uint32_t            r;
+    ngx_uint_t          i;
+    ngx_rbtree_node_t  *node;
+
+    for (i = 0; i < n; i++) {
+        r = bt->random[bt->next++ % NGX_BENCH_TIMER_RANDOM];
+        node = &bt->nodes[r % bt->n];
+
+        ngx_rbtree_delete(&bt->tree, node);
+
+        node->key = bt->now + ngx_bench_timer_timeouts[r >> 30];
+        ngx_rbtree_insert(&bt->tree, node);
+    }
+
+    return ngx_rbtree_min(bt->tree.root, bt->tree.sentinel)->key;
+}
+
+
+static uintptr_t
+ngx_bench_timer_wheel_rearm(void *data, ngx_uint_t n)
+{
+    ngx_bench_timer_t *bt = data;
+
+    uint32_t            r;
+    ngx_uint_t          i;
+    ngx_rbtree_node_t  *node;
+
+    for (i = 0; i < n; i++) {
+        r = bt->random[bt->next++ % NGX_BENCH_TIMER_RANDOM];
+        node = &bt->nodes[r % bt->n];
+
+        ngx_timer_wheel_delete(bt->wheel, node);
+
+        node->key = bt->now + ngx_bench_timer_timeouts[r >> 30];
+        ngx_timer_wheel_insert(bt->wheel, node);
+    }
+
+    return ngx_timer_wheel_min(bt->wheel);
+}
+
+
+static uintptr_t
+ngx_bench_timer_rbtree_find(void *data, ngx_uint_t n)
+{
+    ngx_bench_timer_t *bt = data;
+
+    uintptr_t   sum;
+    ngx_uint_t  i;
+
+    sum = 0;
+
+    for (i = 0; i < n; i++) {
+        sum += ngx_rbtree_min(bt->tree.root, bt->tree.sentinel)->key;
+    }
+
+    return sum;
+}
+
+
+static uintptr_t
+ngx_bench_timer_wheel_find(void *data, ngx_uint_t n)
+{
+    ngx_bench_timer_t *bt = data;
+
+    uintptr_t   sum;
+    ngx_uint_t  i;
+
+    sum = 0;
+
+    for (i = 0; i < n; i++) {
+        sum += ngx_timer_wheel_min(bt->wheel);
+    }
+
+    return sum;
+}
+
+
+static uintptr_t
+ngx_bench_timer_rbtree_loop(void *data, ngx_uint_t n)
+{
+    ngx_bench_timer_t *bt = data;
+
+    uint32_t            r;
+    ngx_uint_t          i, j;
+    ngx_msec_t          timeout;
+    ngx_rbtree_node_t  *node;
+
+    for (i = 0; i < n; i++) {
+        bt->now++;
+
+        r = bt->random[bt->next++ % NGX_BENCH_TIMER_RANDOM];
+        timeout = ngx_bench_timer_timeouts[r >> 30];
+
+        for ( ;; ) {
+            node = ngx_rbtree_min(bt->tree.root, bt->tree.sentinel);
+
+            if ((ngx_msec_int_t) (node->key - bt->now) > 0) {
+                break;
+            }
+
+            ngx_rbtree_delete(&bt->tree, node);
+
+            node->key = bt->now + timeout;
+            ngx_rbtree_insert(&bt->tree, node);
+        }
+
+        for (j = 0; j < NGX_BENCH_TIMER_ACTIVE; j++) {
+            r = bt->random[bt->next++ % NGX_BENCH_TIMER_RANDOM];
+            node = &bt->nodes[r % bt->n];
+
+            ngx_rbtree_delete(&bt->tree, node);
+
+            node->key = bt->now + ngx_bench_timer_timeouts[r >> 30];
+            ngx_rbtree_insert(&bt->tree, node);
+        }
+    }
+
+    return ngx_rbtree_min(bt->tree.root, bt->tree.sentinel)->key;
+}
+
+
+static uintptr_t
+ngx_bench_timer_wheel_loop(void *data, ngx_uint_t n)
+{
+    ngx_bench_timer_t *bt = data;
+
+    uint32_t            r;
+    ngx_uint_t          i, j;
+    ngx_msec_t          timeout;
+    ngx_rbtree_node_t  *node;
+
+    for (i = 0; i < n; i++) {
+        bt->now++;
+
+        r = bt->random[bt->next++ % NGX_BENCH_TIMER_RANDOM];
+        timeout = ngx_bench_timer_timeouts[r >> 30];
+
+        for ( ;; ) {
+            node = ngx_timer_wheel_expired(bt->wheel, bt->now);
+
+            if (node == NULL) {
+                break;
+            }
+
+            ngx_timer_wheel_delete(bt->wheel, node);
+
+            node->key = bt->now + timeout;
+            ngx_timer_wheel_insert(bt->wheel, node);
+        }
+
+        for (j = 0; j < NGX_BENCH_TIMER_ACTIVE; j++) {
+            r = bt->random[bt->next++ % NGX_BENCH_TIMER_RANDOM];
+            node = &bt->nodes[r % bt->n];
+
+            ngx_timer_wheel_delete(bt->wheel, node);
+
+            node->key = bt->now + ngx_bench_timer_timeouts[r >> 30];
+            ngx_timer_wheel_insert(bt->wheel, node);
+        }
+    }
+
+    return ngx_timer_wheel_min(bt->wheel);
+}
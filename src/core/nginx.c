@@ -23,6 +23,10 @@ static char *ngx_set_cpu_affinity(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static char *ngx_set_worker_processes(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+static char *ngx_set_pool_cache(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+static char *ngx_set_shared_zone(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
 
 
 static ngx_conf_enum_t  ngx_debug_points[] = {
@@ -104,6 +108,20 @@ static ngx_command_t  ngx_core_commands[] = {
       0,
       NULL },
 
+    { ngx_string("worker_pool_cache"),
+      NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_TAKE12,
+      ngx_set_pool_cache,
+      0,
+      0,
+      NULL },
+
+    { ngx_string("shared_zone"),
+      NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_2MORE,
+      ngx_set_shared_zone,
+      0,
+      0,
+      NULL },
+
     { ngx_string("worker_rlimit_nofile"),
       NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_num_slot,
@@ -292,6 +310,8 @@ main(int argc, char *const *argv)
         return 1;
     }
 
+    ngx_pool_set_type(init_cycle.pool, NGX_POOL_CONFIG);
+
     if (ngx_save_argv(&init_cycle, argc, argv) != NGX_OK) {
         return 1;
     }
@@ -954,8 +974,10 @@ ngx_core_module_create_conf(ngx_cycle_t *cycle)
      *     ccf->pid = NULL;
      *     ccf->oldpid = NULL;
      *     ccf->priority = 0;
+     *     ccf->cpu_affinity_auto = 0;
      *     ccf->cpu_affinity_n = 0;
      *     ccf->cpu_affinity = NULL;
+     *     ccf->shm_policies = { 0 };
      */
 
     ccf->daemon = NGX_CONF_UNSET;
@@ -971,6 +993,9 @@ ngx_core_module_create_conf(ngx_cycle_t *cycle)
     ccf->user = (ngx_uid_t) NGX_CONF_UNSET_UINT;
     ccf->group = (ngx_gid_t) NGX_CONF_UNSET_UINT;
 
+    ccf->pool_cache_high = NGX_CONF_UNSET_UINT;
+    ccf->pool_cache_low = NGX_CONF_UNSET_UINT;
+
     if (ngx_array_init(&ccf->env, cycle->pool, 1, sizeof(ngx_str_t))
         != NGX_OK)
     {
@@ -993,9 +1018,21 @@ ngx_core_module_init_conf(ngx_cycle_t *cycle, void *conf)
     ngx_conf_init_value(ccf->worker_processes, 1);
     ngx_conf_init_value(ccf->debug_points, 0);
 
+    ngx_conf_init_uint_value(ccf->pool_cache_high, 128);
+    ngx_conf_init_uint_value(ccf->pool_cache_low, ccf->pool_cache_high / 2);
+
+    if (ccf->pool_cache_low > ccf->pool_cache_high) {
+        ngx_log_error(NGX_LOG_EMERG, cycle->log, 0,
+                      "\"worker_pool_cache\" low watermark %ui is above "
+                      "high watermark %ui",
+                      ccf->pool_cache_low, ccf->pool_cache_high);
+        return NGX_CONF_ERROR;
+    }
+
 #if (NGX_HAVE_CPU_AFFINITY)
 
-    if (ccf->cpu_affinity_n
+    if (!ccf->cpu_affinity_auto
+        && ccf->cpu_affinity_n
         && ccf->cpu_affinity_n != 1
         && ccf->cpu_affinity_n != (ngx_uint_t) ccf->worker_processes)
     {
@@ -1247,16 +1284,16 @@ ngx_set_cpu_affinity(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 #if (NGX_HAVE_CPU_AFFINITY)
     ngx_core_conf_t  *ccf = conf;
 
-    u_char            ch;
-    uint64_t         *mask;
+    u_char            ch, *p;
     ngx_str_t        *value;
     ngx_uint_t        i, n;
+    ngx_cpuset_t     *mask;
 
     if (ccf->cpu_affinity) {
         return "is duplicate";
     }
 
-    mask = ngx_palloc(cf->pool, (cf->args->nelts - 1) * sizeof(uint64_t));
+    mask = ngx_palloc(cf->pool, (cf->args->nelts - 1) * sizeof(ngx_cpuset_t));
     if (mask == NULL) {
         return NGX_CONF_ERROR;
     }
@@ -1266,32 +1303,60 @@ ngx_set_cpu_affinity(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
     value = cf->args->elts;
 
-    for (n = 1; n < cf->args->nelts; n++) {
+    if (ngx_strcmp(value[1].data, "auto") == 0) {
+
+        if (cf->args->nelts > 3) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid number of arguments in "
+                               "\"worker_cpu_affinity\" directive");
+            return NGX_CONF_ERROR;
+        }
+
+        ccf->cpu_affinity_auto = 1;
+
+        CPU_ZERO(&mask[0]);
+        for (i = 0; i < CPU_SETSIZE; i++) {
+            CPU_SET(i, &mask[0]);
+        }
+
+        n = 2;
+
+    } else {
+        n = 1;
+    }
 
-        if (value[n].len > 64) {
+    for ( /* void */ ; n < cf->args->nelts; n++) {
+
+        if (value[n].len > CPU_SETSIZE) {
             ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
-                         "\"worker_cpu_affinity\" supports up to 64 CPUs only");
+                               "\"worker_cpu_affinity\" supports up to %d CPUs "
+                               "only", CPU_SETSIZE);
             return NGX_CONF_ERROR;
         }
 
-        mask[n - 1] = 0;
+        /* the last character of a mask is the first CPU */
 
-        for (i = 0; i < value[n].len; i++) {
+        i = 0;
+        CPU_ZERO(&mask[n - 1]);
 
-            ch = value[n].data[i];
+        for (p = value[n].data + value[n].len - 1;
+             p >= value[n].data;
+             p--)
+        {
+            ch = *p;
 
             if (ch == ' ') {
                 continue;
             }
 
-            mask[n - 1] <<= 1;
+            i++;
 
             if (ch == '0') {
                 continue;
             }
 
             if (ch == '1') {
-                mask[n - 1] |= 1;
+                CPU_SET(i - 1, &mask[n - 1]);
                 continue;
             }
 
@@ -1302,6 +1367,14 @@ ngx_set_cpu_affinity(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         }
     }
 
+    if (ccf->cpu_affinity_auto && ccf->cpu_affinity_n == 2) {
+
+        /* the mask limits the CPUs of the automatic affinity */
+
+        mask[0] = mask[1];
+        ccf->cpu_affinity_n = 1;
+    }
+
 #else
 
     ngx_conf_log_error(NGX_LOG_WARN, cf, 0,
@@ -1313,23 +1386,65 @@ ngx_set_cpu_affinity(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 }
 
 
-uint64_t
+ngx_cpuset_t *
 ngx_get_cpu_affinity(ngx_uint_t n)
 {
+#if (NGX_HAVE_CPU_AFFINITY)
+    ngx_uint_t        i, j, cpu;
+    ngx_cpuset_t     *mask;
     ngx_core_conf_t  *ccf;
 
+    static ngx_cpuset_t  result;
+
     ccf = (ngx_core_conf_t *) ngx_get_conf(ngx_cycle->conf_ctx,
                                            ngx_core_module);
 
     if (ccf->cpu_affinity == NULL) {
-        return 0;
+        return NULL;
+    }
+
+    if (ccf->cpu_affinity_auto) {
+        mask = &ccf->cpu_affinity[0];
+
+        /* the CPUs of the mask, in the order of the topology */
+
+        for (i = 0, j = 0; i < ngx_cpu_topology.cpus; i++) {
+            if (CPU_ISSET(ngx_cpu_topology.order[i], mask)) {
+                j++;
+            }
+        }
+
+        if (j == 0) {
+            return NULL;
+        }
+
+        n %= j;
+
+        for (i = 0; /* void */ ; i++) {
+            cpu = ngx_cpu_topology.order[i];
+
+            if (CPU_ISSET(cpu, mask) && n-- == 0) {
+                break;
+            }
+        }
+
+        CPU_ZERO(&result);
+        CPU_SET(cpu, &result);
+
+        return &result;
     }
 
     if (ccf->cpu_affinity_n > n) {
-        return ccf->cpu_affinity[n];
+        return &ccf->cpu_affinity[n];
     }
 
-    return ccf->cpu_affinity[ccf->cpu_affinity_n - 1];
+    return &ccf->cpu_affinity[ccf->cpu_affinity_n - 1];
+
+#else
+
+    return NULL;
+
+#endif
 }
 
 
@@ -1360,3 +1475,236 @@ ngx_set_worker_processes(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
     return NGX_CONF_OK;
 }
+
+
+static char *
+ngx_set_pool_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_core_conf_t  *ccf = conf;
+
+    ngx_int_t         n;
+    ngx_str_t        *value;
+    ngx_uint_t        i;
+
+    if (ccf->pool_cache_high != NGX_CONF_UNSET_UINT) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (cf->args->nelts == 2 && ngx_strcmp(value[1].data, "off") == 0) {
+        ccf->pool_cache_high = 0;
+        ccf->pool_cache_low = 0;
+
+        return NGX_CONF_OK;
+    }
+
+    for (i = 1; i < cf->args->nelts; i++) {
+
+        if (ngx_strncmp(value[i].data, "high=", 5) == 0) {
+
+            n = ngx_atoi(value[i].data + 5, value[i].len - 5);
+            if (n == NGX_ERROR || n == 0) {
+                goto invalid;
+            }
+
+            ccf->pool_cache_high = n;
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "low=", 4) == 0) {
+
+            n = ngx_atoi(value[i].data + 4, value[i].len - 4);
+            if (n == NGX_ERROR) {
+                goto invalid;
+            }
+
+            ccf->pool_cache_low = n;
+
+            continue;
+        }
+
+        goto invalid;
+    }
+
+    if (ccf->pool_cache_high == NGX_CONF_UNSET_UINT) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "\"%V\" must have \"high\" parameter",
+                           &cmd->name);
+        return NGX_CONF_ERROR;
+    }
+
+    return NGX_CONF_OK;
+
+invalid:
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "invalid parameter \"%V\"", &value[i]);
+
+    return NGX_CONF_ERROR;
+}
+
+
+static char *
+ngx_set_shared_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+#if !(NGX_WIN32)
+    ngx_core_conf_t  *ccf = conf;
+
+    u_char            *p, *last;
+    ngx_str_t         *value, s;
+    ngx_uint_t         i;
+    ngx_shm_policy_t  *policy;
+
+    if (ccf->shm_policies.elts == NULL
+        && ngx_array_init(&ccf->shm_policies, cf->pool, 4,
+                          sizeof(ngx_shm_policy_t))
+           != NGX_OK)
+    {
+        return NGX_CONF_ERROR;
+    }
+
+    value = cf->args->elts;
+
+    policy = ccf->shm_policies.elts;
+
+    for (i = 0; i < ccf->shm_policies.nelts; i++) {
+        if (policy[i].name.len == value[1].len
+            && ngx_strncmp(policy[i].name.data, value[1].data, value[1].len)
+               == 0)
+        {
+            return "is duplicate";
+        }
+    }
+
+    policy = ngx_array_push(&ccf->shm_policies);
+    if (policy == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    ngx_memzero(policy, sizeof(ngx_shm_policy_t));
+
+    policy->name = value[1];
+
+    for (i = 2; i < cf->args->nelts; i++) {
+
+        if (ngx_strncmp(value[i].data, "huge_pages=", 11) == 0) {
+
+            s.data = value[i].data + 11;
+            s.len = value[i].len - 11;
+
+            if (ngx_strcmp(s.data, "on") == 0) {
+                policy->huge = NGX_SHM_HUGE_ON;
+
+            } else if (ngx_strcmp(s.data, "try") == 0) {
+                policy->huge = NGX_SHM_HUGE_TRY;
+
+            } else if (ngx_strcmp(s.data, "transparent") == 0) {
+                policy->huge = NGX_SHM_HUGE_TRANSPARENT;
+
+            } else if (ngx_strcmp(s.data, "off") == 0) {
+                policy->huge = NGX_SHM_HUGE_OFF;
+
+            } else {
+                goto invalid;
+            }
+
+#if !(NGX_HAVE_MAP_HUGETLB)
+
+            if (policy->huge == NGX_SHM_HUGE_ON) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "\"huge_pages=on\" is not supported "
+                                   "on this platform");
+                return NGX_CONF_ERROR;
+            }
+
+            if (policy->huge == NGX_SHM_HUGE_TRY) {
+                policy->huge = NGX_SHM_HUGE_TRANSPARENT;
+            }
+
+#endif
+
+#if !(NGX_HAVE_MADV_HUGEPAGE)
+
+            if (policy->huge == NGX_SHM_HUGE_TRANSPARENT) {
+                ngx_conf_log_error(NGX_LOG_WARN, cf, 0,
+                                   "transparent huge pages are not supported "
+                                   "on this platform, ignored");
+                policy->huge = NGX_SHM_HUGE_OFF;
+            }
+
+#endif
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "numa=", 5) == 0) {
+
+            p = value[i].data + 5;
+            last = value[i].data + value[i].len;
+
+            if (ngx_strncmp(p, "interleave", 10) == 0) {
+                policy->numa = NGX_SHM_NUMA_INTERLEAVE;
+                p += 10;
+
+            } else if (ngx_strncmp(p, "bind:", 5) == 0) {
+                policy->numa = NGX_SHM_NUMA_BIND;
+                p += 4;
+
+            } else if (ngx_strcmp(p, "off") == 0) {
+                policy->numa = NGX_SHM_NUMA_OFF;
+                continue;
+
+            } else {
+                goto invalid;
+            }
+
+            if (p < last) {
+                if (*p++ != ':'
+                    || ngx_shm_parse_nodes(p, last - p, &policy->nodes)
+                       != NGX_OK)
+                {
+                    goto invalid;
+                }
+            }
+
+#if !(NGX_HAVE_MBIND)
+
+            ngx_conf_log_error(NGX_LOG_WARN, cf, 0,
+                               "\"numa\" is not supported "
+                               "on this platform, ignored");
+            policy->numa = NGX_SHM_NUMA_OFF;
+
+#endif
+
+            continue;
+        }
+
+        if (ngx_strcmp(value[i].data, "prefault") == 0) {
+            policy->prefault = 1;
+            continue;
+        }
+
+        goto invalid;
+    }
+
+    return NGX_CONF_OK;
+
+invalid:
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "invalid parameter \"%V\"", &value[i]);
+
+    return NGX_CONF_ERROR;
+
+#else
+
+    ngx_conf_log_error(NGX_LOG_WARN, cf, 0,
+                       "\"shared_zone\" is not supported "
+                       "on this platform, ignored");
+
+    return NGX_CONF_OK;
+
+#endif
+}
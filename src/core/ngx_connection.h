@@ -53,6 +53,10 @@ struct ngx_listening_s {
 
     ngx_uint_t          worker;
 
+    /* the adaptive accept budget of the worker, see "multi_accept auto" */
+    ngx_uint_t          accept_budget;
+    ngx_msec_t          accept_time;
+
     unsigned            open:1;
     unsigned            remain:1;
     unsigned            ignore:1;
@@ -64,6 +68,8 @@ struct ngx_listening_s {
     unsigned            nonblocking:1;
     unsigned            shared:1;    /* shared between threads or processes */
     unsigned            addr_ntop:1;
+    unsigned            accept_exhausted:1;
+    unsigned            exclusive:1;   /* wakes up one of the workers */
 
 #if (NGX_HAVE_INET6 && defined IPV6_V6ONLY)
     unsigned            ipv6only:1;
@@ -71,6 +77,9 @@ struct ngx_listening_s {
 #if (NGX_HAVE_REUSEPORT)
     unsigned            reuseport:1;
     unsigned            add_reuseport:1;
+#endif
+#if (NGX_HAVE_INCOMING_CPU)
+    unsigned            incoming_cpu:1;
 #endif
     unsigned            keepalive:2;
 
@@ -46,6 +46,7 @@ typedef void (*ngx_connection_handler_pt)(ngx_connection_t *c);
 #include <ngx_atomic.h>
 #include <ngx_thread.h>
 #include <ngx_rbtree.h>
+#include <ngx_timer_wheel.h>
 #include <ngx_time.h>
 #include <ngx_socket.h>
 #include <ngx_string.h>
@@ -137,3 +137,371 @@ ngx_cpuinfo(void)
 
 
 #endif
+
+
+#if (NGX_HAVE_CPU_AFFINITY)
+
+typedef struct {
+    ngx_uint_t  cpu;
+    ngx_uint_t  node;
+    ngx_uint_t  thread;
+    ngx_uint_t  package;
+    ngx_uint_t  core;
+} ngx_cpu_t;
+
+
+#if (NGX_LINUX)
+static ngx_int_t ngx_cpu_read_list(u_char *path, ngx_cpuset_t *set,
+    ngx_log_t *log);
+static ngx_int_t ngx_cpu_read_id(ngx_uint_t cpu, char *name, ngx_log_t *log);
+static ssize_t ngx_cpu_read(u_char *path, u_char *buf, size_t size,
+    ngx_log_t *log);
+#endif
+static ngx_int_t ngx_cpu_cmp(const void *one, const void *two);
+
+
+ngx_cpu_topology_t  ngx_cpu_topology;
+
+
+ngx_int_t
+ngx_cpu_topology_init(ngx_log_t *log)
+{
+    ngx_int_t      id;
+    ngx_uint_t     i, j, n;
+    ngx_cpu_t     *cpus;
+#if (NGX_LINUX)
+    ngx_uint_t     node;
+    ngx_cpuset_t   online, set;
+    u_char         path[64];
+#endif
+
+    cpus = ngx_alloc(CPU_SETSIZE * sizeof(ngx_cpu_t), log);
+    if (cpus == NULL) {
+        return NGX_ERROR;
+    }
+
+    n = 0;
+
+#if (NGX_LINUX)
+
+    if (ngx_cpu_read_list((u_char *) "/sys/devices/system/cpu/online",
+                          &online, log)
+        == NGX_OK)
+    {
+        for (i = 0; i < CPU_SETSIZE; i++) {
+
+            if (!CPU_ISSET(i, &online)) {
+                continue;
+            }
+
+            cpus[n].cpu = i;
+            cpus[n].node = 0;
+            cpus[n].thread = 0;
+
+            id = ngx_cpu_read_id(i, "physical_package_id", log);
+            cpus[n].package = (id == NGX_ERROR) ? 0 : id;
+
+            id = ngx_cpu_read_id(i, "core_id", log);
+            cpus[n].core = (id == NGX_ERROR) ? i : (ngx_uint_t) id;
+
+            n++;
+        }
+
+        if (ngx_cpu_read_list((u_char *) "/sys/devices/system/node/online",
+                              &online, log)
+            == NGX_OK)
+        {
+            for (node = 0; node < CPU_SETSIZE; node++) {
+
+                if (!CPU_ISSET(node, &online)) {
+                    continue;
+                }
+
+                ngx_sprintf(path, "/sys/devices/system/node/node%ui/cpulist%Z",
+                            node);
+
+                if (ngx_cpu_read_list(path, &set, log) != NGX_OK) {
+                    continue;
+                }
+
+                for (i = 0; i < n; i++) {
+                    if (CPU_ISSET(cpus[i].cpu, &set)) {
+                        cpus[i].node = node;
+                    }
+                }
+            }
+        }
+    }
+
+#endif
+
+    if (n == 0) {
+
+        /* the topology is not known, the CPUs are taken in a row */
+
+        for (i = 0; i < (ngx_uint_t) ngx_ncpu && i < CPU_SETSIZE; i++) {
+            cpus[i].cpu = i;
+            cpus[i].node = 0;
+            cpus[i].thread = 0;
+            cpus[i].package = 0;
+            cpus[i].core = i;
+        }
+
+        n = i;
+    }
+
+    ngx_cpu_topology.cpus = n;
+    ngx_cpu_topology.cores = 0;
+    ngx_cpu_topology.packages = 0;
+    ngx_cpu_topology.nodes = 0;
+
+    for (i = 0; i < n; i++) {
+
+        for (j = 0; j < i; j++) {
+            if (cpus[j].package == cpus[i].package
+                && cpus[j].core == cpus[i].core)
+            {
+                /* a sibling thread of the same core */
+                cpus[i].thread++;
+            }
+        }
+
+        if (cpus[i].thread == 0) {
+            ngx_cpu_topology.cores++;
+        }
+
+        for (j = 0; j < i; j++) {
+            if (cpus[j].package == cpus[i].package) {
+                break;
+            }
+        }
+
+        if (j == i) {
+            ngx_cpu_topology.packages++;
+        }
+
+        for (j = 0; j < i; j++) {
+            if (cpus[j].node == cpus[i].node) {
+                break;
+            }
+        }
+
+        if (j == i) {
+            ngx_cpu_topology.nodes++;
+        }
+    }
+
+    ngx_sort(cpus, n, sizeof(ngx_cpu_t), ngx_cpu_cmp);
+
+    ngx_cpu_topology.order = ngx_alloc(n * sizeof(ngx_uint_t), log);
+    if (ngx_cpu_topology.order == NULL) {
+        ngx_free(cpus);
+        return NGX_ERROR;
+    }
+
+    for (i = 0; i < n; i++) {
+        ngx_cpu_topology.order[i] = cpus[i].cpu;
+    }
+
+    ngx_free(cpus);
+
+    return NGX_OK;
+}
+
+
+void
+ngx_cpu_topology_status(ngx_log_t *log)
+{
+    u_char      *p, *last;
+    ngx_uint_t   i;
+    u_char       buf[NGX_MAX_ERROR_STR];
+
+    ngx_log_error(NGX_LOG_NOTICE, log, 0,
+                  "CPU topology: %ui nodes, %ui packages, %ui cores, "
+                  "%ui CPUs", ngx_cpu_topology.nodes,
+                  ngx_cpu_topology.packages, ngx_cpu_topology.cores,
+                  ngx_cpu_topology.cpus);
+
+    p = buf;
+    last = buf + sizeof(buf);
+
+    for (i = 0; i < ngx_cpu_topology.cpus; i++) {
+        p = ngx_slprintf(p, last, " %ui", ngx_cpu_topology.order[i]);
+    }
+
+    ngx_log_error(NGX_LOG_NOTICE, log, 0,
+                  "CPU order of automatic affinity:%*s",
+                  (size_t) (p - buf), buf);
+}
+
+
+#if (NGX_LINUX)
+
+static ngx_int_t
+ngx_cpu_read_list(u_char *path, ngx_cpuset_t *set, ngx_log_t *log)
+{
+    u_char      *p, *last;
+    ssize_t      n;
+    ngx_uint_t   from, to, digits;
+    u_char       buf[4096];
+
+    CPU_ZERO(set);
+
+    n = ngx_cpu_read(path, buf, sizeof(buf), log);
+
+    if (n == NGX_ERROR) {
+        return NGX_ERROR;
+    }
+
+    /* a list like "0-3,8-11" */
+
+    p = buf;
+    last = buf + n;
+
+    while (last > p && (last[-1] == LF || last[-1] == ' ')) {
+        last--;
+    }
+
+    if (p == last) {
+        return NGX_ERROR;
+    }
+
+    for ( ;; ) {
+
+        for (from = 0, digits = 0; p < last && *p >= '0' && *p <= '9'; p++) {
+            from = from * 10 + (*p - '0');
+            digits++;
+        }
+
+        if (digits == 0 || from >= CPU_SETSIZE) {
+            goto invalid;
+        }
+
+        to = from;
+
+        if (p < last && *p == '-') {
+            p++;
+
+            for (to = 0, digits = 0; p < last && *p >= '0' && *p <= '9'; p++)
+            {
+                to = to * 10 + (*p - '0');
+                digits++;
+            }
+
+            if (digits == 0 || to < from) {
+                goto invalid;
+            }
+
+            if (to >= CPU_SETSIZE) {
+                to = CPU_SETSIZE - 1;
+            }
+        }
+
+        while (from <= to) {
+            CPU_SET(from++, set);
+        }
+
+        if (p == last) {
+            return NGX_OK;
+        }
+
+        if (*p++ != ',') {
+            goto invalid;
+        }
+    }
+
+invalid:
+
+    ngx_log_error(NGX_LOG_WARN, log, 0, "invalid list of CPUs in \"%s\"",
+                  path);
+
+    return NGX_ERROR;
+}
+
+
+static ngx_int_t
+ngx_cpu_read_id(ngx_uint_t cpu, char *name, ngx_log_t *log)
+{
+    ssize_t  n;
+    u_char   path[128], buf[32];
+
+    ngx_sprintf(path, "/sys/devices/system/cpu/cpu%ui/topology/%s%Z",
+                cpu, name);
+
+    n = ngx_cpu_read(path, buf, sizeof(buf), log);
+
+    if (n == NGX_ERROR) {
+        return NGX_ERROR;
+    }
+
+    while (n && (buf[n - 1] == LF || buf[n - 1] == ' ')) {
+        n--;
+    }
+
+    return ngx_atoi(buf, n);
+}
+
+
+static ssize_t
+ngx_cpu_read(u_char *path, u_char *buf, size_t size, ngx_log_t *log)
+{
+    ssize_t   n;
+    ngx_fd_t  fd;
+
+    fd = ngx_open_file(path, NGX_FILE_RDONLY, NGX_FILE_OPEN, 0);
+
+    if (fd == NGX_INVALID_FILE) {
+        ngx_log_debug1(NGX_LOG_DEBUG_CORE, log, ngx_errno,
+                       ngx_open_file_n " \"%s\" failed", path);
+        return NGX_ERROR;
+    }
+
+    n = ngx_read_fd(fd, buf, size);
+
+    if (n == -1) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      ngx_read_fd_n " \"%s\" failed", path);
+        n = NGX_ERROR;
+    }
+
+    if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      ngx_close_file_n " \"%s\" failed", path);
+    }
+
+    return n;
+}
+
+#endif
+
+
+/* node by node, the first threads of the cores before their siblings */
+
+static ngx_int_t
+ngx_cpu_cmp(const void *one, const void *two)
+{
+    ngx_cpu_t  *first, *second;
+
+    first = (ngx_cpu_t *) one;
+    second = (ngx_cpu_t *) two;
+
+    if (first->node != second->node) {
+        return (first->node < second->node) ? -1 : 1;
+    }
+
+    if (first->thread != second->thread) {
+        return (first->thread < second->thread) ? -1 : 1;
+    }
+
+    if (first->package != second->package) {
+        return (first->package < second->package) ? -1 : 1;
+    }
+
+    if (first->core != second->core) {
+        return (first->core < second->core) ? -1 : 1;
+    }
+
+    return (first->cpu < second->cpu) ? -1 : 1;
+}
+
+#endif
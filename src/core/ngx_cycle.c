@@ -13,6 +13,9 @@
 static void ngx_destroy_cycle_pools(ngx_conf_t *conf);
 static ngx_int_t ngx_init_zone_pool(ngx_cycle_t *cycle,
     ngx_shm_zone_t *shm_zone);
+#if !(NGX_WIN32)
+static void ngx_set_shm_policy(ngx_cycle_t *cycle, ngx_shm_t *shm);
+#endif
 static ngx_int_t ngx_test_lockfile(u_char *file, ngx_log_t *log);
 static void ngx_clean_old_cycles(ngx_event_t *ev);
 
@@ -70,6 +73,8 @@ ngx_init_cycle(ngx_cycle_t *old_cycle)
     }
     pool->log = log;
 
+    ngx_pool_set_type(pool, NGX_POOL_CONFIG);
+
     cycle = ngx_pcalloc(pool, sizeof(ngx_cycle_t));
     if (cycle == NULL) {
         ngx_destroy_pool(pool);
@@ -418,6 +423,10 @@ ngx_init_cycle(ngx_cycle_t *old_cycle)
 
         shm_zone[i].shm.log = cycle->log;
 
+#if !(NGX_WIN32)
+        ngx_set_shm_policy(cycle, &shm_zone[i].shm);
+#endif
+
         opart = &old_cycle->shared_memory.part;
         oshm_zone = opart->elts;
 
@@ -451,6 +460,8 @@ ngx_init_cycle(ngx_cycle_t *old_cycle)
                 shm_zone[i].shm.addr = oshm_zone[n].shm.addr;
 #if (NGX_WIN32)
                 shm_zone[i].shm.handle = oshm_zone[n].shm.handle;
+#else
+                shm_zone[i].shm.hugetlb = oshm_zone[n].shm.hugetlb;
 #endif
 
                 if (shm_zone[i].init(&shm_zone[i], oshm_zone[n].data)
@@ -933,6 +944,66 @@ ngx_init_zone_pool(ngx_cycle_t *cycle, ngx_shm_zone_t *zn)
 }
 
 
+#if !(NGX_WIN32)
+
+/*
+ * a "shared_zone" of the zone name takes precedence over "shared_zone *";
+ * the policy only applies when the zone memory is allocated, a zone that
+ * is reused on reconfiguration keeps its pages as they are
+ */
+
+static void
+ngx_set_shm_policy(ngx_cycle_t *cycle, ngx_shm_t *shm)
+{
+    ngx_uint_t         i;
+    ngx_core_conf_t   *ccf;
+    ngx_shm_policy_t  *policy, *found;
+
+    ccf = (ngx_core_conf_t *) ngx_get_conf(cycle->conf_ctx, ngx_core_module);
+
+    found = NULL;
+    policy = ccf->shm_policies.elts;
+
+    for (i = 0; i < ccf->shm_policies.nelts; i++) {
+
+        if (policy[i].name.len == 1 && policy[i].name.data[0] == '*') {
+            if (found == NULL) {
+                found = &policy[i];
+            }
+
+            continue;
+        }
+
+        if (policy[i].name.len == shm->name.len
+            && ngx_strncmp(policy[i].name.data, shm->name.data,
+                           shm->name.len)
+               == 0)
+        {
+            found = &policy[i];
+            break;
+        }
+    }
+
+    if (found == NULL) {
+        shm->huge = NGX_SHM_HUGE_OFF;
+        shm->numa = NGX_SHM_NUMA_OFF;
+        shm->nodes = 0;
+        shm->prefault = 0;
+        shm->hugetlb = 0;
+
+        return;
+    }
+
+    shm->huge = found->huge;
+    shm->numa = found->numa;
+    shm->nodes = found->nodes;
+    shm->prefault = found->prefault ? 1 : 0;
+    shm->hugetlb = 0;
+}
+
+#endif
+
+
 ngx_int_t
 ngx_create_pidfile(ngx_str_t *name, ngx_log_t *log)
 {
@@ -65,6 +65,8 @@ struct ngx_cycle_s {
 
     ngx_cycle_t              *old_cycle;
 
+    ngx_pool_cache_t         *pool_cache;
+
     ngx_str_t                 conf_file;
     ngx_str_t                 conf_param;
     ngx_str_t                 conf_prefix;
@@ -88,8 +90,14 @@ typedef struct {
 
      int                      priority;
 
+     ngx_uint_t               cpu_affinity_auto;
      ngx_uint_t               cpu_affinity_n;
-     uint64_t                *cpu_affinity;
+     ngx_cpuset_t            *cpu_affinity;
+
+     ngx_uint_t               pool_cache_high;
+     ngx_uint_t               pool_cache_low;
+
+     ngx_array_t              shm_policies;
 
      char                    *username;
      ngx_uid_t                user;
@@ -116,7 +124,7 @@ ngx_int_t ngx_signal_process(ngx_cycle_t *cycle, char *sig);
 void ngx_reopen_files(ngx_cycle_t *cycle, ngx_uid_t user);
 char **ngx_set_environment(ngx_cycle_t *cycle, ngx_uint_t *last);
 ngx_pid_t ngx_exec_new_binary(ngx_cycle_t *cycle, char *const *argv);
-uint64_t ngx_get_cpu_affinity(ngx_uint_t n);
+ngx_cpuset_t *ngx_get_cpu_affinity(ngx_uint_t n);
 ngx_shm_zone_t *ngx_shared_memory_add(ngx_conf_t *cf, ngx_str_t *name,
     size_t size, void *tag);
 
@@ -48,3 +48,86 @@ ngx_murmur_hash2(u_char *data, size_t len)
 
     return h;
 }
+
+
+/*
+ * ngx_murmur_hash2() of the key lowercased into dst, the lowercasing is
+ * done eight bytes at a time: a byte is in 'A'..'Z' if adding 0x3f to its
+ * low seven bits sets the high bit and adding 0x25 does not
+ */
+
+uint32_t
+ngx_murmur_hash2_strlow(u_char *dst, u_char *src, size_t len)
+{
+    size_t    i;
+    uint32_t  h, k;
+    uint64_t  w, low, upper;
+
+    h = 0 ^ len;
+
+    while (len >= 8) {
+        ngx_memcpy(&w, src, 8);
+
+        low = w & 0x7f7f7f7f7f7f7f7fULL;
+        upper = (low + 0x3f3f3f3f3f3f3f3fULL) ^ (low + 0x2525252525252525ULL);
+        upper &= ~w & 0x8080808080808080ULL;
+        w |= upper >> 2;
+
+        ngx_memcpy(dst, &w, 8);
+
+        for (i = 0; i < 8; i += 4) {
+            k  = dst[i];
+            k |= dst[i + 1] << 8;
+            k |= dst[i + 2] << 16;
+            k |= dst[i + 3] << 24;
+
+            k *= 0x5bd1e995;
+            k ^= k >> 24;
+            k *= 0x5bd1e995;
+
+            h *= 0x5bd1e995;
+            h ^= k;
+        }
+
+        dst += 8;
+        src += 8;
+        len -= 8;
+    }
+
+    for (i = 0; i < len; i++) {
+        dst[i] = ngx_tolower(src[i]);
+    }
+
+    if (len >= 4) {
+        k  = dst[0];
+        k |= dst[1] << 8;
+        k |= dst[2] << 16;
+        k |= dst[3] << 24;
+
+        k *= 0x5bd1e995;
+        k ^= k >> 24;
+        k *= 0x5bd1e995;
+
+        h *= 0x5bd1e995;
+        h ^= k;
+
+        dst += 4;
+        len -= 4;
+    }
+
+    switch (len) {
+    case 3:
+        h ^= dst[2] << 16;
+    case 2:
+        h ^= dst[1] << 8;
+    case 1:
+        h ^= dst[0];
+        h *= 0x5bd1e995;
+    }
+
+    h ^= h >> 13;
+    h *= 0x5bd1e995;
+    h ^= h >> 15;
+
+    return h;
+}
@@ -14,6 +14,7 @@
 
 
 uint32_t ngx_murmur_hash2(u_char *data, size_t len);
+uint32_t ngx_murmur_hash2_strlow(u_char *dst, u_char *src, size_t len);
 
 
 #endif /* _NGX_MURMURHASH_H_INCLUDED_ */
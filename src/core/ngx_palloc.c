@@ -11,6 +11,23 @@
 
 static void *ngx_palloc_block(ngx_pool_t *pool, size_t size);
 static void *ngx_palloc_large(ngx_pool_t *pool, size_t size);
+static void *ngx_get_cached_block(size_t size, ngx_log_t *log);
+static void ngx_free_cached_block(ngx_pool_t *p);
+
+#if (NGX_POOL_STATS)
+
+#undef ngx_palloc
+#undef ngx_pnalloc
+#undef ngx_pcalloc
+#undef ngx_pmemalign
+
+static void ngx_pool_stat(ngx_pool_t *pool, size_t size, ngx_uint_t large,
+    char *file, ngx_uint_t line);
+
+
+ngx_pool_stats_t  ngx_pool_stats;
+
+#endif
 
 
 ngx_pool_t *
@@ -18,7 +35,7 @@ ngx_create_pool(size_t size, ngx_log_t *log)
 {
     ngx_pool_t  *p;
 
-    p = ngx_memalign(NGX_POOL_ALIGNMENT, size, log);
+    p = ngx_get_cached_block(size, log);
     if (p == NULL) {
         return NULL;
     }
@@ -37,6 +54,11 @@ ngx_create_pool(size_t size, ngx_log_t *log)
     p->cleanup = NULL;
     p->log = log;
 
+#if (NGX_POOL_STATS)
+    p->type = NGX_POOL_TEMP;
+    ngx_pool_stats.types[NGX_POOL_TEMP].pools++;
+#endif
+
     return p;
 }
 
@@ -84,7 +106,7 @@ ngx_destroy_pool(ngx_pool_t *pool)
 #endif
 
     for (p = pool, n = pool->d.next; /* void */; p = n, n = n->d.next) {
-        ngx_free(p);
+        ngx_free_cached_block(p);
 
         if (n == NULL) {
             break;
@@ -185,11 +207,15 @@ ngx_palloc_block(ngx_pool_t *pool, size_t size)
 
     psize = (size_t) (pool->d.end - (u_char *) pool);
 
-    m = ngx_memalign(NGX_POOL_ALIGNMENT, psize, pool->log);
+    m = ngx_get_cached_block(psize, pool->log);
     if (m == NULL) {
         return NULL;
     }
 
+#if (NGX_POOL_STATS)
+    ngx_pool_stats.types[pool->type].blocks++;
+#endif
+
     new = (ngx_pool_t *) m;
 
     new->d.end = m + psize;
@@ -403,30 +429,238 @@ ngx_pool_delete_file(void *data)
 }
 
 
-#if 0
+#if (NGX_POOL_STATS)
+
+/*
+ * The statistics are kept by each process for its own pools.  A call site
+ * is identified by the __FILE__ pointer and line of the call, the sites
+ * are an open addressed table, and the calls from sites that do not fit
+ * there are only counted as dropped.  The allocations the pool makes for
+ * itself, such as cleanup handlers and links of large allocations, are
+ * not counted.  The pools and blocks are counted as they are created, so
+ * the blocks per pool of a type show how often its initial size is short.
+ */
+
+void *
+ngx_palloc_at(ngx_pool_t *pool, size_t size, char *file, ngx_uint_t line)
+{
+    ngx_pool_stat(pool, size, size > pool->max, file, line);
+
+    return ngx_palloc(pool, size);
+}
+
+
+void *
+ngx_pnalloc_at(ngx_pool_t *pool, size_t size, char *file, ngx_uint_t line)
+{
+    ngx_pool_stat(pool, size, size > pool->max, file, line);
+
+    return ngx_pnalloc(pool, size);
+}
+
+
+void *
+ngx_pcalloc_at(ngx_pool_t *pool, size_t size, char *file, ngx_uint_t line)
+{
+    ngx_pool_stat(pool, size, size > pool->max, file, line);
+
+    return ngx_pcalloc(pool, size);
+}
+
+
+void *
+ngx_pmemalign_at(ngx_pool_t *pool, size_t size, size_t alignment, char *file,
+    ngx_uint_t line)
+{
+    ngx_pool_stat(pool, size, 1, file, line);
+
+    return ngx_pmemalign(pool, size, alignment);
+}
+
+
+void
+ngx_pool_set_type(ngx_pool_t *pool, ngx_uint_t type)
+{
+    ngx_pool_stats.types[pool->type].pools--;
+    ngx_pool_stats.types[type].pools++;
+
+    pool->type = type;
+}
+
+
+static void
+ngx_pool_stat(ngx_pool_t *pool, size_t size, ngx_uint_t large, char *file,
+    ngx_uint_t line)
+{
+    ngx_uint_t        i, hash;
+    ngx_pool_stat_t  *st;
+    ngx_pool_site_t  *site;
+
+    st = &ngx_pool_stats.types[pool->type].total;
+
+    st->calls++;
+    st->bytes += size;
+    st->large += large;
+
+    hash = ((uintptr_t) file >> 4) ^ (line * 2654435761u);
+
+    for (i = 0; i < NGX_POOL_STATS_SITES; i++) {
+        site = &ngx_pool_stats.sites[(hash + i) & (NGX_POOL_STATS_SITES - 1)];
+
+        if (site->file == file && site->line == line) {
+            goto found;
+        }
+
+        if (site->file == NULL) {
+            site->file = file;
+            site->line = line;
+            ngx_pool_stats.nsites++;
+            goto found;
+        }
+    }
+
+    ngx_pool_stats.dropped++;
+
+    return;
+
+found:
+
+    st = &site->stat[pool->type];
+
+    st->calls++;
+    st->bytes += size;
+    st->large += large;
+}
+
+#endif
+
+
+/*
+ * The pool blocks a worker frees are kept for the pools it creates next,
+ * so that in the steady state requests and connections do not allocate.
+ * A slot that grows above the high watermark is trimmed to the low one
+ * at once.  The cache is enabled in worker processes only, and they are
+ * single threaded.
+ */
+
+ngx_int_t
+ngx_pool_cache_init(ngx_cycle_t *cycle, ngx_uint_t high, ngx_uint_t low)
+{
+    ngx_pool_cache_t  *cache;
+
+    cache = ngx_calloc(sizeof(ngx_pool_cache_t), cycle->log);
+    if (cache == NULL) {
+        return NGX_ERROR;
+    }
+
+    cache->high = high;
+    cache->low = low;
+
+    cycle->pool_cache = cache;
+
+    return NGX_OK;
+}
+
+
+void
+ngx_pool_cache_counters(ngx_uint_t *hits, ngx_uint_t *misses)
+{
+    ngx_uint_t         i;
+    ngx_pool_cache_t  *cache;
+
+    *hits = 0;
+    *misses = 0;
+
+    cache = ngx_cycle->pool_cache;
+
+    if (cache == NULL) {
+        return;
+    }
+
+    for (i = 0; i < NGX_POOL_CACHE_SLOTS; i++) {
+        *hits += cache->slots[i].hits;
+        *misses += cache->slots[i].misses;
+    }
+}
+
 
 static void *
-ngx_get_cached_block(size_t size)
+ngx_get_cached_block(size_t size, ngx_log_t *log)
 {
     void                     *p;
+    ngx_uint_t                shift;
     ngx_cached_block_slot_t  *slot;
 
-    if (ngx_cycle->cache == NULL) {
-        return NULL;
+    if (size > (size_t) 1 << NGX_POOL_CACHE_MAX_SHIFT) {
+        return ngx_memalign(NGX_POOL_ALIGNMENT, size, log);
+    }
+
+    for (shift = NGX_POOL_CACHE_MIN_SHIFT; size > (size_t) 1 << shift; shift++)
+    {
+        /* void */
     }
 
-    slot = &ngx_cycle->cache[(size + ngx_pagesize - 1) / ngx_pagesize];
+    if (ngx_cycle->pool_cache) {
+        slot = &ngx_cycle->pool_cache->slots[shift - NGX_POOL_CACHE_MIN_SHIFT];
 
-    slot->tries++;
+        if (slot->number) {
+            p = slot->block;
+            slot->block = slot->block->next;
+            slot->number--;
+            slot->hits++;
 
-    if (slot->number) {
-        p = slot->block;
-        slot->block = slot->block->next;
-        slot->number--;
-        return p;
+            return p;
+        }
+
+        slot->misses++;
     }
 
-    return NULL;
+    /*
+     * blocks have the size of their slot whether the cache is enabled or
+     * not, as those of the master process are freed in workers too
+     */
+
+    return ngx_memalign(NGX_POOL_ALIGNMENT, (size_t) 1 << shift, log);
 }
 
-#endif
+
+static void
+ngx_free_cached_block(ngx_pool_t *p)
+{
+    size_t                    size;
+    ngx_uint_t                shift;
+    ngx_pool_cache_t         *cache;
+    ngx_cached_block_t       *block;
+    ngx_cached_block_slot_t  *slot;
+
+    cache = ngx_cycle->pool_cache;
+    size = (size_t) (p->d.end - (u_char *) p);
+
+    if (cache == NULL || size > (size_t) 1 << NGX_POOL_CACHE_MAX_SHIFT) {
+        ngx_free(p);
+        return;
+    }
+
+    for (shift = NGX_POOL_CACHE_MIN_SHIFT; size > (size_t) 1 << shift; shift++)
+    {
+        /* void */
+    }
+
+    slot = &cache->slots[shift - NGX_POOL_CACHE_MIN_SHIFT];
+
+    block = (ngx_cached_block_t *) p;
+    block->next = slot->block;
+    slot->block = block;
+
+    if (++slot->number <= cache->high) {
+        return;
+    }
+
+    while (slot->number > cache->low) {
+        block = slot->block;
+        slot->block = block->next;
+        slot->number--;
+
+        ngx_free(block);
+    }
+}
@@ -26,6 +26,25 @@
     ngx_align((sizeof(ngx_pool_t) + 2 * sizeof(ngx_pool_large_t)),            \
               NGX_POOL_ALIGNMENT)
 
+/*
+ * pool blocks of up to 64K are allocated in sizes of powers of two from
+ * 128 bytes, each size is a slot of the block cache
+ */
+#define NGX_POOL_CACHE_MIN_SHIFT  7
+#define NGX_POOL_CACHE_MAX_SHIFT  16
+#define NGX_POOL_CACHE_SLOTS                                                  \
+    (NGX_POOL_CACHE_MAX_SHIFT - NGX_POOL_CACHE_MIN_SHIFT + 1)
+
+/* pool types of the allocation statistics */
+#define NGX_POOL_TEMP            0
+#define NGX_POOL_CONNECTION      1
+#define NGX_POOL_REQUEST         2
+#define NGX_POOL_CONFIG          3
+#define NGX_POOL_TYPES           4
+
+/* the number of call sites must be a power of two */
+#define NGX_POOL_STATS_SITES     1024
+
 
 typedef void (*ngx_pool_cleanup_pt)(void *data);
 
@@ -62,6 +81,9 @@ struct ngx_pool_s {
     ngx_pool_large_t     *large;
     ngx_pool_cleanup_t   *cleanup;
     ngx_log_t            *log;
+#if (NGX_POOL_STATS)
+    ngx_uint_t            type;
+#endif
 };
 
 
@@ -72,6 +94,61 @@ typedef struct {
 } ngx_pool_cleanup_file_t;
 
 
+typedef struct ngx_cached_block_s  ngx_cached_block_t;
+
+struct ngx_cached_block_s {
+    ngx_cached_block_t   *next;
+};
+
+
+typedef struct {
+    ngx_cached_block_t   *block;
+    ngx_uint_t            number;
+    ngx_uint_t            hits;
+    ngx_uint_t            misses;
+} ngx_cached_block_slot_t;
+
+
+typedef struct {
+    ngx_cached_block_slot_t   slots[NGX_POOL_CACHE_SLOTS];
+    ngx_uint_t                high;
+    ngx_uint_t                low;
+} ngx_pool_cache_t;
+
+
+#if (NGX_POOL_STATS)
+
+typedef struct {
+    ngx_uint_t            calls;
+    uint64_t              bytes;
+    ngx_uint_t            large;
+} ngx_pool_stat_t;
+
+
+typedef struct {
+    char                 *file;
+    ngx_uint_t            line;
+    ngx_pool_stat_t       stat[NGX_POOL_TYPES];
+} ngx_pool_site_t;
+
+
+typedef struct {
+    ngx_uint_t            pools;
+    ngx_uint_t            blocks;
+    ngx_pool_stat_t       total;
+} ngx_pool_type_stat_t;
+
+
+typedef struct {
+    ngx_pool_type_stat_t  types[NGX_POOL_TYPES];
+    ngx_uint_t            nsites;
+    ngx_uint_t            dropped;
+    ngx_pool_site_t       sites[NGX_POOL_STATS_SITES];
+} ngx_pool_stats_t;
+
+#endif
+
+
 void *ngx_alloc(size_t size, ngx_log_t *log);
 void *ngx_calloc(size_t size, ngx_log_t *log);
 
@@ -86,6 +163,47 @@ void *ngx_pmemalign(ngx_pool_t *pool, size_t size, size_t alignment);
 ngx_int_t ngx_pfree(ngx_pool_t *pool, void *p);
 
 
+#if (NGX_POOL_STATS)
+
+/*
+ * the allocations are counted per call site of ngx_palloc() and friends,
+ * the functions themselves are called by ngx_palloc.c only
+ */
+
+#define ngx_palloc(pool, size)                                                \
+    ngx_palloc_at(pool, size, __FILE__, __LINE__)
+#define ngx_pnalloc(pool, size)                                               \
+    ngx_pnalloc_at(pool, size, __FILE__, __LINE__)
+#define ngx_pcalloc(pool, size)                                               \
+    ngx_pcalloc_at(pool, size, __FILE__, __LINE__)
+#define ngx_pmemalign(pool, size, alignment)                                  \
+    ngx_pmemalign_at(pool, size, alignment, __FILE__, __LINE__)
+
+void *ngx_palloc_at(ngx_pool_t *pool, size_t size, char *file,
+    ngx_uint_t line);
+void *ngx_pnalloc_at(ngx_pool_t *pool, size_t size, char *file,
+    ngx_uint_t line);
+void *ngx_pcalloc_at(ngx_pool_t *pool, size_t size, char *file,
+    ngx_uint_t line);
+void *ngx_pmemalign_at(ngx_pool_t *pool, size_t size, size_t alignment,
+    char *file, ngx_uint_t line);
+
+void ngx_pool_set_type(ngx_pool_t *pool, ngx_uint_t type);
+
+extern ngx_pool_stats_t  ngx_pool_stats;
+
+#else
+
+#define ngx_pool_set_type(pool, type)
+
+#endif
+
+
+ngx_int_t ngx_pool_cache_init(ngx_cycle_t *cycle, ngx_uint_t high,
+    ngx_uint_t low);
+void ngx_pool_cache_counters(ngx_uint_t *hits, ngx_uint_t *misses);
+
+
 ngx_pool_cleanup_t *ngx_pool_cleanup_add(ngx_pool_t *p, size_t size);
 void ngx_pool_run_cleanup_file(ngx_pool_t *p, ngx_fd_t fd);
 void ngx_pool_cleanup_file(void *data);
@@ -62,12 +62,22 @@ static void ngx_slab_free_pages(ngx_slab_pool_t *pool, ngx_slab_page_t *page,
     ngx_uint_t pages);
 static void ngx_slab_error(ngx_slab_pool_t *pool, ngx_uint_t level,
     char *text);
+static void *ngx_slab_alloc_magazine(ngx_slab_pool_t *pool, size_t size,
+    ngx_uint_t locked);
+static void ngx_slab_free_magazine(ngx_slab_pool_t *pool, void *p,
+    ngx_uint_t locked);
+static ngx_slab_magazine_t *ngx_slab_get_magazine(ngx_slab_pool_t *pool);
+static void ngx_slab_flush_magazine_locked(ngx_slab_magazine_t *mg);
 
 
 static ngx_uint_t  ngx_slab_max_size;
 static ngx_uint_t  ngx_slab_exact_size;
 static ngx_uint_t  ngx_slab_exact_shift;
 
+static ngx_uint_t            ngx_slab_magazines_enabled;
+static ngx_slab_magazine_t  *ngx_slab_magazines;
+static ngx_slab_magazine_t  *ngx_slab_last_magazine;
+
 
 void
 ngx_slab_init(ngx_slab_pool_t *pool)
@@ -106,6 +116,11 @@ ngx_slab_init(ngx_slab_pool_t *pool)
 
     p += n * sizeof(ngx_slab_page_t);
 
+    pool->stats = (ngx_slab_stat_t *) p;
+    ngx_memzero(pool->stats, n * sizeof(ngx_slab_stat_t));
+
+    p += n * sizeof(ngx_slab_stat_t);
+
     pages = (ngx_uint_t) (size / (ngx_pagesize + sizeof(ngx_slab_page_t)));
 
     ngx_memzero(p, pages * sizeof(ngx_slab_page_t));
@@ -130,6 +145,8 @@ ngx_slab_init(ngx_slab_pool_t *pool)
     }
 
     pool->last = pool->pages + pages;
+    pool->pfree = pages;
+    pool->pfails = 0;
 
     pool->log_nomem = 1;
     pool->log_ctx = &pool->zero;
@@ -158,8 +175,11 @@ ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size)
     size_t            s;
     uintptr_t         p, n, m, mask, *bitmap;
     ngx_uint_t        i, slot, shift, map;
+    ngx_slab_stat_t  *stat;
     ngx_slab_page_t  *page, *prev, *slots;
 
+    stat = NULL;
+
     if (size > ngx_slab_max_size) {
 
         ngx_log_debug1(NGX_LOG_DEBUG_ALLOC, ngx_cycle->log, 0,
@@ -173,6 +193,7 @@ ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size)
 
         } else {
             p = 0;
+            pool->pfails++;
         }
 
         goto done;
@@ -192,6 +213,9 @@ ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size)
     ngx_log_debug2(NGX_LOG_DEBUG_ALLOC, ngx_cycle->log, 0,
                    "slab alloc: %uz slot: %ui", size, slot);
 
+    stat = &pool->stats[slot];
+    stat->reqs++;
+
     slots = (ngx_slab_page_t *) ((u_char *) pool + sizeof(ngx_slab_pool_t));
     page = slots[slot].next;
 
@@ -343,6 +367,8 @@ ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size)
 
             bitmap[0] = (2 << n) - 1;
 
+            stat->total += (ngx_pagesize >> shift) - n;
+
             map = (1 << (ngx_pagesize_shift - shift)) / (sizeof(uintptr_t) * 8);
 
             for (i = 1; i < map; i++) {
@@ -366,6 +392,8 @@ ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size)
             page->next = &slots[slot];
             page->prev = (uintptr_t) &slots[slot] | NGX_SLAB_EXACT;
 
+            stat->total += 8 * sizeof(uintptr_t);
+
             slots[slot].next = page;
 
             p = (page - pool->pages) << ngx_pagesize_shift;
@@ -379,6 +407,8 @@ ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size)
             page->next = &slots[slot];
             page->prev = (uintptr_t) &slots[slot] | NGX_SLAB_BIG;
 
+            stat->total += ngx_pagesize >> shift;
+
             slots[slot].next = page;
 
             p = (page - pool->pages) << ngx_pagesize_shift;
@@ -392,6 +422,15 @@ ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size)
 
 done:
 
+    if (stat) {
+        if (p) {
+            stat->used++;
+
+        } else {
+            stat->fails++;
+        }
+    }
+
     ngx_log_debug1(NGX_LOG_DEBUG_ALLOC, ngx_cycle->log, 0, "slab alloc: %p", p);
 
     return (void *) p;
@@ -443,7 +482,7 @@ ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p)
 {
     size_t            size;
     uintptr_t         slab, m, *bitmap;
-    ngx_uint_t        n, type, slot, shift, map;
+    ngx_uint_t        i, n, type, slot, shift, map;
     ngx_slab_page_t  *slots, *page;
 
     ngx_log_debug1(NGX_LOG_DEBUG_ALLOC, ngx_cycle->log, 0, "slab free: %p", p);
@@ -464,6 +503,7 @@ ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p)
 
         shift = slab & NGX_SLAB_SHIFT_MASK;
         size = 1 << shift;
+        slot = shift - pool->min_shift;
 
         if ((uintptr_t) p & (size - 1)) {
             goto wrong_chunk;
@@ -480,7 +520,6 @@ ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p)
             if (page->next == NULL) {
                 slots = (ngx_slab_page_t *)
                                    ((u_char *) pool + sizeof(ngx_slab_pool_t));
-                slot = shift - pool->min_shift;
 
                 page->next = slots[slot].next;
                 slots[slot].next = page;
@@ -491,6 +530,8 @@ ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p)
 
             bitmap[n] &= ~m;
 
+            pool->stats[slot].used--;
+
             n = (1 << (ngx_pagesize_shift - shift)) / 8 / (1 << shift);
 
             if (n == 0) {
@@ -503,14 +544,16 @@ ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p)
 
             map = (1 << (ngx_pagesize_shift - shift)) / (sizeof(uintptr_t) * 8);
 
-            for (n = 1; n < map; n++) {
-                if (bitmap[n]) {
+            for (i = 1; i < map; i++) {
+                if (bitmap[i]) {
                     goto done;
                 }
             }
 
             ngx_slab_free_pages(pool, page, 1);
 
+            pool->stats[slot].total -= (ngx_pagesize >> shift) - n;
+
             goto done;
         }
 
@@ -521,6 +564,7 @@ ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p)
         m = (uintptr_t) 1 <<
                 (((uintptr_t) p & (ngx_pagesize - 1)) >> ngx_slab_exact_shift);
         size = ngx_slab_exact_size;
+        slot = ngx_slab_exact_shift - pool->min_shift;
 
         if ((uintptr_t) p & (size - 1)) {
             goto wrong_chunk;
@@ -530,7 +574,6 @@ ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p)
             if (slab == NGX_SLAB_BUSY) {
                 slots = (ngx_slab_page_t *)
                                    ((u_char *) pool + sizeof(ngx_slab_pool_t));
-                slot = ngx_slab_exact_shift - pool->min_shift;
 
                 page->next = slots[slot].next;
                 slots[slot].next = page;
@@ -541,12 +584,16 @@ ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p)
 
             page->slab &= ~m;
 
+            pool->stats[slot].used--;
+
             if (page->slab) {
                 goto done;
             }
 
             ngx_slab_free_pages(pool, page, 1);
 
+            pool->stats[slot].total -= 8 * sizeof(uintptr_t);
+
             goto done;
         }
 
@@ -556,6 +603,7 @@ ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p)
 
         shift = slab & NGX_SLAB_SHIFT_MASK;
         size = 1 << shift;
+        slot = shift - pool->min_shift;
 
         if ((uintptr_t) p & (size - 1)) {
             goto wrong_chunk;
@@ -569,7 +617,6 @@ ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p)
             if (page->next == NULL) {
                 slots = (ngx_slab_page_t *)
                                    ((u_char *) pool + sizeof(ngx_slab_pool_t));
-                slot = shift - pool->min_shift;
 
                 page->next = slots[slot].next;
                 slots[slot].next = page;
@@ -580,12 +627,16 @@ ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p)
 
             page->slab &= ~m;
 
+            pool->stats[slot].used--;
+
             if (page->slab & NGX_SLAB_MAP_MASK) {
                 goto done;
             }
 
             ngx_slab_free_pages(pool, page, 1);
 
+            pool->stats[slot].total -= ngx_pagesize >> shift;
+
             goto done;
         }
 
@@ -677,6 +728,8 @@ ngx_slab_alloc_pages(ngx_slab_pool_t *pool, ngx_uint_t pages)
             page->next = NULL;
             page->prev = NGX_SLAB_PAGE;
 
+            pool->pfree -= pages;
+
             if (--pages == 0) {
                 return page;
             }
@@ -708,6 +761,8 @@ ngx_slab_free_pages(ngx_slab_pool_t *pool, ngx_slab_page_t *page,
     ngx_uint_t        type;
     ngx_slab_page_t  *prev, *join;
 
+    pool->pfree += pages;
+
     page->slab = pages--;
 
     if (pages) {
@@ -782,6 +837,305 @@ ngx_slab_free_pages(ngx_slab_pool_t *pool, ngx_slab_page_t *page,
 }
 
 
+/*
+ * The free pages are a list of runs, which are merged with their neighbours
+ * as they are freed, so the longest run is the largest allocation that
+ * can succeed.
+ */
+
+ngx_uint_t
+ngx_slab_largest_free_locked(ngx_slab_pool_t *pool)
+{
+    ngx_uint_t        largest;
+    ngx_slab_page_t  *page;
+
+    largest = 0;
+
+    for (page = pool->free.next; page != &pool->free; page = page->next) {
+        if (page->slab > largest) {
+            largest = page->slab;
+        }
+    }
+
+    return largest;
+}
+
+
+/*
+ * A worker keeps a magazine of free chunks for each size class of every
+ * pool it allocates from with ngx_slab_alloc_cached().  An empty magazine
+ * is refilled with half of its chunks, and a full one is drained by half,
+ * each time under one lock of the pool.  A magazine holds up to a page of
+ * chunks, this is the memory of a class a worker may keep from others.
+ * If the pool has no memory for a refill, the worker returns the chunks
+ * of all its magazines of the pool and tries once more.  The magazines
+ * live in process memory and are returned on exit; a worker that crashes
+ * loses them.  Pages and chunks larger than a half of page are never
+ * kept.  Workers are single threaded.
+ *
+ * The magazines are off unless a process enables them with
+ * ngx_slab_magazines_init() and returns them with ngx_slab_magazines_flush().
+ * They save a lock only for callers that allocate outside the lock of the
+ * pool, and no module does so yet; src/bench/ngx_bench_slab.c uses them.
+ */
+
+void
+ngx_slab_magazines_init(void)
+{
+    ngx_slab_magazines_enabled = 1;
+}
+
+
+void
+ngx_slab_magazines_flush(void)
+{
+    ngx_slab_magazine_t  *mg;
+
+    for (mg = ngx_slab_magazines; mg; mg = mg->next) {
+        ngx_shmtx_lock(&mg->pool->mutex);
+
+        ngx_slab_flush_magazine_locked(mg);
+
+        ngx_shmtx_unlock(&mg->pool->mutex);
+    }
+}
+
+
+void *
+ngx_slab_alloc_cached(ngx_slab_pool_t *pool, size_t size)
+{
+    return ngx_slab_alloc_magazine(pool, size, 0);
+}
+
+
+void *
+ngx_slab_alloc_cached_locked(ngx_slab_pool_t *pool, size_t size)
+{
+    return ngx_slab_alloc_magazine(pool, size, 1);
+}
+
+
+void
+ngx_slab_free_cached(ngx_slab_pool_t *pool, void *p)
+{
+    ngx_slab_free_magazine(pool, p, 0);
+}
+
+
+void
+ngx_slab_free_cached_locked(ngx_slab_pool_t *pool, void *p)
+{
+    ngx_slab_free_magazine(pool, p, 1);
+}
+
+
+static void *
+ngx_slab_alloc_magazine(ngx_slab_pool_t *pool, size_t size, ngx_uint_t locked)
+{
+    void                      *p;
+    size_t                     s;
+    ngx_uint_t                 shift, nomem;
+    ngx_slab_magazine_t       *mg;
+    ngx_slab_magazine_slot_t  *slot;
+
+    mg = (size <= ngx_slab_max_size) ? ngx_slab_get_magazine(pool) : NULL;
+
+    if (mg == NULL) {
+        return locked ? ngx_slab_alloc_locked(pool, size)
+                      : ngx_slab_alloc(pool, size);
+    }
+
+    if (size > pool->min_size) {
+        shift = 1;
+        for (s = size - 1; s >>= 1; shift++) { /* void */ }
+
+    } else {
+        shift = pool->min_shift;
+    }
+
+    slot = &mg->slots[shift - pool->min_shift];
+
+    if (slot->number) {
+        return slot->chunks[--slot->number];
+    }
+
+    if (!locked) {
+        ngx_shmtx_lock(&pool->mutex);
+    }
+
+    /* a short refill is not an error */
+
+    nomem = pool->log_nomem;
+    pool->log_nomem = 0;
+
+    while (slot->number < slot->size / 2) {
+        p = ngx_slab_alloc_locked(pool, (size_t) 1 << shift);
+        if (p == NULL) {
+            break;
+        }
+
+        slot->chunks[slot->number++] = p;
+    }
+
+    pool->log_nomem = nomem;
+
+    if (slot->number) {
+        p = slot->chunks[--slot->number];
+
+    } else {
+        ngx_slab_flush_magazine_locked(mg);
+
+        p = ngx_slab_alloc_locked(pool, size);
+    }
+
+    if (!locked) {
+        ngx_shmtx_unlock(&pool->mutex);
+    }
+
+    return p;
+}
+
+
+static void
+ngx_slab_free_magazine(ngx_slab_pool_t *pool, void *p, ngx_uint_t locked)
+{
+    ngx_uint_t                 shift;
+    ngx_slab_page_t           *page;
+    ngx_slab_magazine_t       *mg;
+    ngx_slab_magazine_slot_t  *slot;
+
+    mg = ngx_slab_get_magazine(pool);
+
+    if (mg == NULL
+        || (u_char *) p < pool->start
+        || (u_char *) p >= pool->end)
+    {
+        goto free;
+    }
+
+    /* the page of an allocated chunk keeps its class */
+
+    page = &pool->pages[((u_char *) p - pool->start) >> ngx_pagesize_shift];
+
+    switch (page->prev & NGX_SLAB_PAGE_MASK) {
+
+    case NGX_SLAB_SMALL:
+    case NGX_SLAB_BIG:
+        shift = page->slab & NGX_SLAB_SHIFT_MASK;
+        break;
+
+    case NGX_SLAB_EXACT:
+        shift = ngx_slab_exact_shift;
+        break;
+
+    default: /* NGX_SLAB_PAGE */
+        goto free;
+    }
+
+    slot = &mg->slots[shift - pool->min_shift];
+
+    if (slot->number < slot->size) {
+        slot->chunks[slot->number++] = p;
+        return;
+    }
+
+    if (!locked) {
+        ngx_shmtx_lock(&pool->mutex);
+    }
+
+    while (slot->number > slot->size / 2) {
+        ngx_slab_free_locked(pool, slot->chunks[--slot->number]);
+    }
+
+    if (!locked) {
+        ngx_shmtx_unlock(&pool->mutex);
+    }
+
+    slot->chunks[slot->number++] = p;
+
+    return;
+
+free:
+
+    if (locked) {
+        ngx_slab_free_locked(pool, p);
+
+    } else {
+        ngx_slab_free(pool, p);
+    }
+}
+
+
+static ngx_slab_magazine_t *
+ngx_slab_get_magazine(ngx_slab_pool_t *pool)
+{
+    size_t                     size;
+    ngx_uint_t                 i, n;
+    ngx_slab_magazine_t       *mg;
+    ngx_slab_magazine_slot_t  *slot;
+
+    if (!ngx_slab_magazines_enabled) {
+        return NULL;
+    }
+
+    if (ngx_slab_last_magazine && ngx_slab_last_magazine->pool == pool) {
+        return ngx_slab_last_magazine;
+    }
+
+    for (mg = ngx_slab_magazines; mg; mg = mg->next) {
+        if (mg->pool == pool) {
+            ngx_slab_last_magazine = mg;
+            return mg;
+        }
+    }
+
+    n = ngx_pagesize_shift - pool->min_shift;
+
+    mg = ngx_alloc(sizeof(ngx_slab_magazine_t)
+                   + n * sizeof(ngx_slab_magazine_slot_t), ngx_cycle->log);
+    if (mg == NULL) {
+        return NULL;
+    }
+
+    mg->pool = pool;
+    mg->slots = (ngx_slab_magazine_slot_t *) &mg[1];
+
+    for (i = 0; i < n; i++) {
+        slot = &mg->slots[i];
+
+        size = ngx_pagesize >> (pool->min_shift + i);
+
+        slot->number = 0;
+        slot->size = ngx_min(size, NGX_SLAB_MAGAZINE_SIZE);
+    }
+
+    mg->next = ngx_slab_magazines;
+    ngx_slab_magazines = mg;
+
+    ngx_slab_last_magazine = mg;
+
+    return mg;
+}
+
+
+static void
+ngx_slab_flush_magazine_locked(ngx_slab_magazine_t *mg)
+{
+    ngx_uint_t                 i, n;
+    ngx_slab_magazine_slot_t  *slot;
+
+    n = ngx_pagesize_shift - mg->pool->min_shift;
+
+    for (i = 0; i < n; i++) {
+        slot = &mg->slots[i];
+
+        while (slot->number) {
+            ngx_slab_free_locked(mg->pool, slot->chunks[--slot->number]);
+        }
+    }
+}
+
+
 static void
 ngx_slab_error(ngx_slab_pool_t *pool, ngx_uint_t level, char *text)
 {
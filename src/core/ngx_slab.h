@@ -22,6 +22,15 @@ struct ngx_slab_page_s {
 };
 
 
+typedef struct {
+    ngx_uint_t        total;
+    ngx_uint_t        used;
+
+    ngx_uint_t        reqs;
+    ngx_uint_t        fails;
+} ngx_slab_stat_t;
+
+
 typedef struct {
     ngx_shmtx_sh_t    lock;
 
@@ -32,6 +41,10 @@ typedef struct {
     ngx_slab_page_t  *last;
     ngx_slab_page_t   free;
 
+    ngx_slab_stat_t  *stats;
+    ngx_uint_t        pfree;
+    ngx_uint_t        pfails;
+
     u_char           *start;
     u_char           *end;
 
@@ -47,6 +60,26 @@ typedef struct {
 } ngx_slab_pool_t;
 
 
+/* the most chunks a magazine of a size class holds */
+#define NGX_SLAB_MAGAZINE_SIZE  32
+
+
+typedef struct {
+    ngx_uint_t        number;
+    ngx_uint_t        size;
+    void             *chunks[NGX_SLAB_MAGAZINE_SIZE];
+} ngx_slab_magazine_slot_t;
+
+
+typedef struct ngx_slab_magazine_s  ngx_slab_magazine_t;
+
+struct ngx_slab_magazine_s {
+    ngx_slab_pool_t           *pool;
+    ngx_slab_magazine_t       *next;
+    ngx_slab_magazine_slot_t  *slots;
+};
+
+
 void ngx_slab_init(ngx_slab_pool_t *pool);
 void *ngx_slab_alloc(ngx_slab_pool_t *pool, size_t size);
 void *ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size);
@@ -54,6 +87,14 @@ void *ngx_slab_calloc(ngx_slab_pool_t *pool, size_t size);
 void *ngx_slab_calloc_locked(ngx_slab_pool_t *pool, size_t size);
 void ngx_slab_free(ngx_slab_pool_t *pool, void *p);
 void ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p);
+ngx_uint_t ngx_slab_largest_free_locked(ngx_slab_pool_t *pool);
+
+void ngx_slab_magazines_init(void);
+void ngx_slab_magazines_flush(void);
+void *ngx_slab_alloc_cached(ngx_slab_pool_t *pool, size_t size);
+void *ngx_slab_alloc_cached_locked(ngx_slab_pool_t *pool, size_t size);
+void ngx_slab_free_cached(ngx_slab_pool_t *pool, void *p);
+void ngx_slab_free_cached_locked(ngx_slab_pool_t *pool, void *p);
 
 
 #endif /* _NGX_SLAB_H_INCLUDED_ */
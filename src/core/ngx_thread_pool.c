@@ -16,21 +16,28 @@ typedef struct {
 } ngx_thread_pool_conf_t;
 
 
-typedef struct {
-    ngx_thread_task_t        *first;
-    ngx_thread_task_t       **last;
-} ngx_thread_pool_queue_t;
+/*
+ * The tasks are posted by the worker to a ring of the pool, which the
+ * threads take them from by moving the head with an atomic operation.
+ * The ring is large enough for max_queue tasks plus a task for every
+ * thread.  A thread waits on the condition variable only if the ring is
+ * empty; the worker signals a thread if no other has been signalled yet,
+ * and a signalled thread signals the next one if tasks are left.
+ */
 
-#define ngx_thread_pool_queue_init(q)                                         \
-    (q)->first = NULL;                                                        \
-    (q)->last = &(q)->first
+struct ngx_thread_pool_s {
+    ngx_thread_task_t       **ring;
+    ngx_atomic_uint_t         mask;
+    ngx_atomic_t              tail;
 
+    u_char                    pad[NGX_CPU_CACHE_LINE];
+
+    ngx_atomic_t              head;
 
-struct ngx_thread_pool_s {
     ngx_thread_mutex_t        mtx;
-    ngx_thread_pool_queue_t   queue;
-    ngx_int_t                 waiting;
     ngx_thread_cond_t         cond;
+    ngx_atomic_t              sleeping;
+    ngx_atomic_t              signals;
 
     ngx_log_t                *log;
 
@@ -38,6 +45,13 @@ struct ngx_thread_pool_s {
     ngx_uint_t                threads;
     ngx_int_t                 max_queue;
 
+    /* statistics, updated by the worker */
+
+    ngx_uint_t                peak;
+    ngx_uint_t                tasks;
+    uint64_t                  wait;
+    uint64_t                  service;
+
     u_char                   *file;
     ngx_uint_t                line;
 };
@@ -48,8 +62,10 @@ static ngx_int_t ngx_thread_pool_init(ngx_thread_pool_t *tp, ngx_log_t *log,
 static void ngx_thread_pool_destroy(ngx_thread_pool_t *tp);
 static void ngx_thread_pool_exit_handler(void *data, ngx_log_t *log);
 
+static ngx_thread_task_t *ngx_thread_pool_take(ngx_thread_pool_t *tp);
 static void *ngx_thread_pool_cycle(void *data);
 static void ngx_thread_pool_handler(ngx_event_t *ev);
+static uint64_t ngx_thread_pool_usec(void);
 
 static char *ngx_thread_pool(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
 
@@ -99,8 +115,9 @@ ngx_module_t  ngx_thread_pool_module = {
 static ngx_str_t  ngx_thread_pool_default = ngx_string("default");
 
 static ngx_uint_t               ngx_thread_pool_task_id;
-static ngx_atomic_t             ngx_thread_pool_done_lock;
-static ngx_thread_pool_queue_t  ngx_thread_pool_done;
+
+/* the completed tasks of all pools, pushed by the threads */
+static ngx_atomic_t             ngx_thread_pool_done;
 
 
 static ngx_int_t
@@ -108,7 +125,7 @@ ngx_thread_pool_init(ngx_thread_pool_t *tp, ngx_log_t *log, ngx_pool_t *pool)
 {
     int             err;
     pthread_t       tid;
-    ngx_uint_t      n;
+    ngx_uint_t      n, size;
     pthread_attr_t  attr;
 
     if (ngx_notify == NULL) {
@@ -117,7 +134,18 @@ ngx_thread_pool_init(ngx_thread_pool_t *tp, ngx_log_t *log, ngx_pool_t *pool)
         return NGX_ERROR;
     }
 
-    ngx_thread_pool_queue_init(&tp->queue);
+    n = (ngx_uint_t) tp->max_queue + tp->threads;
+
+    for (size = 1; size < n; size <<= 1) { /* void */ }
+
+    tp->ring = ngx_pcalloc(pool, size * sizeof(ngx_thread_task_t *));
+    if (tp->ring == NULL) {
+        return NGX_ERROR;
+    }
+
+    tp->mask = size - 1;
+    tp->head = 0;
+    tp->tail = 0;
 
     if (ngx_thread_mutex_create(&tp->mtx, log) != NGX_OK) {
         return NGX_ERROR;
@@ -223,22 +251,26 @@ ngx_thread_task_alloc(ngx_pool_t *pool, size_t size)
 ngx_int_t
 ngx_thread_task_post(ngx_thread_pool_t *tp, ngx_thread_task_t *task)
 {
+    ngx_uint_t         queue;
+    ngx_atomic_uint_t  tail;
+
     if (task->event.active) {
         ngx_log_error(NGX_LOG_ALERT, tp->log, 0,
                       "task #%ui already active", task->id);
         return NGX_ERROR;
     }
 
-    if (ngx_thread_mutex_lock(&tp->mtx, tp->log) != NGX_OK) {
-        return NGX_ERROR;
-    }
+    tail = tp->tail;
+    queue = tail - tp->head;
 
-    if (tp->waiting >= tp->max_queue) {
-        (void) ngx_thread_mutex_unlock(&tp->mtx, tp->log);
+    /* the idle threads are about to take tasks from the queue */
 
+    if (queue > tp->mask
+        || queue >= (ngx_uint_t) tp->max_queue + tp->sleeping)
+    {
         ngx_log_error(NGX_LOG_ERR, tp->log, 0,
-                      "thread pool \"%V\" queue overflow: %i tasks waiting",
-                      &tp->name, tp->waiting);
+                      "thread pool \"%V\" queue overflow: %ui tasks waiting",
+                      &tp->name, queue);
         return NGX_ERROR;
     }
 
@@ -246,18 +278,41 @@ ngx_thread_task_post(ngx_thread_pool_t *tp, ngx_thread_task_t *task)
 
     task->id = ngx_thread_pool_task_id++;
     task->next = NULL;
+    task->pool = tp;
+    task->posted = ngx_thread_pool_usec();
 
-    if (ngx_thread_cond_signal(&tp->cond, tp->log) != NGX_OK) {
-        (void) ngx_thread_mutex_unlock(&tp->mtx, tp->log);
-        return NGX_ERROR;
+    tp->ring[tail & tp->mask] = task;
+
+    /*
+     * the worker publishes the tail and then reads "sleeping", a thread
+     * increments "sleeping" and then reads the tail; both need a full
+     * barrier between the store and the load, which ngx_memory_barrier()
+     * is not on every platform, while a locked atomic operation is
+     */
+
+    (void) ngx_atomic_fetch_add(&tp->tail, 1);
+
+    if (queue + 1 > tp->peak) {
+        tp->peak = queue + 1;
     }
 
-    *tp->queue.last = task;
-    tp->queue.last = &task->next;
+    if (tp->sleeping && tp->signals == 0) {
+
+        if (ngx_thread_mutex_lock(&tp->mtx, tp->log) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        if (tp->sleeping && tp->signals == 0) {
+            tp->signals++;
 
-    tp->waiting++;
+            if (ngx_thread_cond_signal(&tp->cond, tp->log) != NGX_OK) {
+                (void) ngx_thread_mutex_unlock(&tp->mtx, tp->log);
+                return NGX_ERROR;
+            }
+        }
 
-    (void) ngx_thread_mutex_unlock(&tp->mtx, tp->log);
+        (void) ngx_thread_mutex_unlock(&tp->mtx, tp->log);
+    }
 
     ngx_log_debug2(NGX_LOG_DEBUG_CORE, tp->log, 0,
                    "task #%ui added to thread pool \"%V\"",
@@ -267,13 +322,47 @@ ngx_thread_task_post(ngx_thread_pool_t *tp, ngx_thread_task_t *task)
 }
 
 
+static ngx_thread_task_t *
+ngx_thread_pool_take(ngx_thread_pool_t *tp)
+{
+    ngx_atomic_uint_t   head;
+    ngx_thread_task_t  *task;
+
+    for ( ;; ) {
+        head = tp->head;
+
+        ngx_memory_barrier();
+
+        if (head == tp->tail) {
+            return NULL;
+        }
+
+        ngx_memory_barrier();
+
+        task = tp->ring[head & tp->mask];
+
+        /*
+         * the worker does not reuse the slot until the head
+         * has been moved past it, so the task is valid here
+         * if the head has not been moved yet
+         */
+
+        if (ngx_atomic_cmp_set(&tp->head, head, head + 1)) {
+            return task;
+        }
+    }
+}
+
+
 static void *
 ngx_thread_pool_cycle(void *data)
 {
     ngx_thread_pool_t *tp = data;
 
     int                 err;
+    uint64_t            start;
     sigset_t            set;
+    ngx_atomic_uint_t   done;
     ngx_thread_task_t  *task;
 
 #if 0
@@ -297,36 +386,53 @@ ngx_thread_pool_cycle(void *data)
     }
 
     for ( ;; ) {
-        if (ngx_thread_mutex_lock(&tp->mtx, tp->log) != NGX_OK) {
-            return NULL;
-        }
+        task = ngx_thread_pool_take(tp);
 
-        /* the number may become negative */
-        tp->waiting--;
-
-        while (tp->queue.first == NULL) {
-            if (ngx_thread_cond_wait(&tp->cond, &tp->mtx, tp->log)
-                != NGX_OK)
-            {
-                (void) ngx_thread_mutex_unlock(&tp->mtx, tp->log);
+        if (task == NULL) {
+            if (ngx_thread_mutex_lock(&tp->mtx, tp->log) != NGX_OK) {
                 return NULL;
             }
-        }
 
-        task = tp->queue.first;
-        tp->queue.first = task->next;
+            (void) ngx_atomic_fetch_add(&tp->sleeping, 1);
 
-        if (tp->queue.first == NULL) {
-            tp->queue.last = &tp->queue.first;
-        }
+            for ( ;; ) {
+                task = ngx_thread_pool_take(tp);
 
-        if (ngx_thread_mutex_unlock(&tp->mtx, tp->log) != NGX_OK) {
-            return NULL;
+                if (task) {
+                    break;
+                }
+
+                /*
+                 * a signal is consumed by exactly one thread,
+                 * a spurious wakeup finds none and waits again
+                 */
+
+                while (tp->signals == 0) {
+                    if (ngx_thread_cond_wait(&tp->cond, &tp->mtx, tp->log)
+                        != NGX_OK)
+                    {
+                        (void) ngx_atomic_fetch_add(&tp->sleeping, -1);
+                        (void) ngx_thread_mutex_unlock(&tp->mtx, tp->log);
+                        return NULL;
+                    }
+                }
+
+                tp->signals--;
+            }
+
+            (void) ngx_atomic_fetch_add(&tp->sleeping, -1);
+
+            if (tp->sleeping > tp->signals && tp->head != tp->tail) {
+                tp->signals++;
+                (void) ngx_thread_cond_signal(&tp->cond, tp->log);
+            }
+
+            if (ngx_thread_mutex_unlock(&tp->mtx, tp->log) != NGX_OK) {
+                return NULL;
+            }
         }
 
-#if 0
-        ngx_time_update();
-#endif
+        start = ngx_thread_pool_usec();
 
         ngx_log_debug2(NGX_LOG_DEBUG_CORE, tp->log, 0,
                        "run task #%ui in thread pool \"%V\"",
@@ -338,16 +444,24 @@ ngx_thread_pool_cycle(void *data)
                        "complete task #%ui in thread pool \"%V\"",
                        task->id, &tp->name);
 
-        task->next = NULL;
+        task->wait = start - task->posted;
+        task->service = ngx_thread_pool_usec() - start;
 
-        ngx_spinlock(&ngx_thread_pool_done_lock, 1, 2048);
+        /*
+         * the completed tasks are pushed to a list, the worker is
+         * notified only by the thread that finds the list empty
+         */
 
-        *ngx_thread_pool_done.last = task;
-        ngx_thread_pool_done.last = &task->next;
+        do {
+            done = ngx_thread_pool_done;
+            task->next = (ngx_thread_task_t *) done;
 
-        ngx_unlock(&ngx_thread_pool_done_lock);
+        } while (!ngx_atomic_cmp_set(&ngx_thread_pool_done, done,
+                                     (ngx_atomic_uint_t) task));
 
-        (void) ngx_notify(ngx_thread_pool_handler);
+        if (done == 0) {
+            (void) ngx_notify(ngx_thread_pool_handler);
+        }
     }
 }
 
@@ -356,24 +470,41 @@ static void
 ngx_thread_pool_handler(ngx_event_t *ev)
 {
     ngx_event_t        *event;
-    ngx_thread_task_t  *task;
+    ngx_atomic_uint_t   done;
+    ngx_thread_pool_t  *tp;
+    ngx_thread_task_t  *task, *next, *first;
 
     ngx_log_debug0(NGX_LOG_DEBUG_CORE, ev->log, 0, "thread pool handler");
 
-    ngx_spinlock(&ngx_thread_pool_done_lock, 1, 2048);
+    do {
+        done = ngx_thread_pool_done;
+
+    } while (!ngx_atomic_cmp_set(&ngx_thread_pool_done, done, 0));
 
-    task = ngx_thread_pool_done.first;
-    ngx_thread_pool_done.first = NULL;
-    ngx_thread_pool_done.last = &ngx_thread_pool_done.first;
+    /* the list is in the reverse order of completion */
 
-    ngx_unlock(&ngx_thread_pool_done_lock);
+    first = NULL;
+
+    for (task = (ngx_thread_task_t *) done; task; task = next) {
+        next = task->next;
+        task->next = first;
+        first = task;
+    }
+
+    while (first) {
+        task = first;
+        first = task->next;
 
-    while (task) {
         ngx_log_debug1(NGX_LOG_DEBUG_CORE, ev->log, 0,
                        "run completion handler for task #%ui", task->id);
 
+        tp = task->pool;
+
+        tp->tasks++;
+        tp->wait += task->wait;
+        tp->service += task->service;
+
         event = &task->event;
-        task = task->next;
 
         event->complete = 1;
         event->active = 0;
@@ -383,6 +514,58 @@ ngx_thread_pool_handler(ngx_event_t *ev)
 }
 
 
+/* a monotonic clock, the wall clock may be stepped while a task waits */
+
+static uint64_t
+ngx_thread_pool_usec(void)
+{
+#if (NGX_HAVE_CLOCK_MONOTONIC)
+    struct timespec  ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    struct timeval   tv;
+
+    ngx_gettimeofday(&tv);
+
+    return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
+
+ngx_int_t
+ngx_thread_pool_stat(ngx_cycle_t *cycle, ngx_uint_t n,
+    ngx_thread_pool_stat_t *st)
+{
+    ngx_thread_pool_t       **tpp, *tp;
+    ngx_thread_pool_conf_t   *tcf;
+
+    tcf = (ngx_thread_pool_conf_t *) ngx_get_conf(cycle->conf_ctx,
+                                                  ngx_thread_pool_module);
+
+    if (tcf == NULL || n >= tcf->pools.nelts) {
+        return NGX_DECLINED;
+    }
+
+    tpp = tcf->pools.elts;
+    tp = tpp[n];
+
+    st->name = &tp->name;
+    st->threads = tp->threads;
+    st->max_queue = tp->max_queue;
+
+    st->queue = (tp->ring == NULL) ? 0 : (ngx_uint_t) (tp->tail - tp->head);
+    st->peak = tp->peak;
+    st->tasks = tp->tasks;
+    st->wait = tp->wait;
+    st->service = tp->service;
+
+    return NGX_OK;
+}
+
+
 static void *
 ngx_thread_pool_create_conf(ngx_cycle_t *cycle)
 {
@@ -588,7 +771,7 @@ ngx_thread_pool_init_worker(ngx_cycle_t *cycle)
         return NGX_OK;
     }
 
-    ngx_thread_pool_queue_init(&ngx_thread_pool_done);
+    ngx_thread_pool_done = 0;
 
     tpp = tcf->pools.elts;
 
@@ -14,16 +14,36 @@
 #include <ngx_event.h>
 
 
+typedef struct ngx_thread_pool_s  ngx_thread_pool_t;
+
+
 struct ngx_thread_task_s {
     ngx_thread_task_t   *next;
     ngx_uint_t           id;
     void                *ctx;
     void               (*handler)(void *data, ngx_log_t *log);
     ngx_event_t          event;
+
+    ngx_thread_pool_t   *pool;
+    uint64_t             posted;
+    uint64_t             wait;
+    uint64_t             service;
 };
 
 
-typedef struct ngx_thread_pool_s  ngx_thread_pool_t;
+/* the times are in microseconds, summed over the completed tasks */
+
+typedef struct {
+    ngx_str_t           *name;
+    ngx_uint_t           threads;
+    ngx_int_t            max_queue;
+
+    ngx_uint_t           queue;
+    ngx_uint_t           peak;
+    ngx_uint_t           tasks;
+    uint64_t             wait;
+    uint64_t             service;
+} ngx_thread_pool_stat_t;
 
 
 ngx_thread_pool_t *ngx_thread_pool_add(ngx_conf_t *cf, ngx_str_t *name);
@@ -32,5 +52,8 @@ ngx_thread_pool_t *ngx_thread_pool_get(ngx_cycle_t *cycle, ngx_str_t *name);
 ngx_thread_task_t *ngx_thread_task_alloc(ngx_pool_t *pool, size_t size);
 ngx_int_t ngx_thread_task_post(ngx_thread_pool_t *tp, ngx_thread_task_t *task);
 
+ngx_int_t ngx_thread_pool_stat(ngx_cycle_t *cycle, ngx_uint_t n,
+    ngx_thread_pool_stat_t *st);
+
 
 #endif /* _NGX_THREAD_POOL_H_INCLUDED_ */
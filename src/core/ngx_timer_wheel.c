@@ -0,0 +1,386 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+/*
+ * A node of the first level slot of "now" has already expired.  A node
+ * of a higher level is moved down when the wheel reaches the start of its
+ * slot, as a node of the first level would; a node too far away for the
+ * wheel is kept in the last slot of the top level and is moved down
+ * until it fits.
+ */
+
+
+#define ngx_timer_wheel_shift(level)  (8 + 6 * ((level) - 1))
+#define ngx_timer_wheel_base(level)   (256 + 64 * ((level) - 1))
+
+
+static void ngx_timer_wheel_link(ngx_timer_wheel_t *wheel,
+    ngx_rbtree_node_t *node);
+static void ngx_timer_wheel_cascade(ngx_timer_wheel_t *wheel);
+static void ngx_timer_wheel_rebuild(ngx_timer_wheel_t *wheel,
+    ngx_rbtree_key_t now);
+static ngx_uint_t ngx_timer_wheel_find(ngx_timer_wheel_t *wheel,
+    ngx_uint_t base, ngx_uint_t size, ngx_uint_t from);
+
+
+void
+ngx_timer_wheel_init(ngx_timer_wheel_t *wheel, ngx_rbtree_key_t now)
+{
+    ngx_uint_t          i;
+    ngx_rbtree_node_t  *head;
+
+    for (i = 0; i < NGX_TIMER_WHEEL_SLOTS; i++) {
+        head = &wheel->slots[i];
+
+        head->left = head;
+        head->right = head;
+        head->parent = NULL;
+    }
+
+    ngx_memzero(wheel->map, sizeof(wheel->map));
+
+    wheel->now = now;
+    wheel->count = 0;
+}
+
+
+void
+ngx_timer_wheel_insert(ngx_timer_wheel_t *wheel, ngx_rbtree_node_t *node)
+{
+    ngx_timer_wheel_link(wheel, node);
+
+    wheel->count++;
+}
+
+
+void
+ngx_timer_wheel_delete(ngx_timer_wheel_t *wheel, ngx_rbtree_node_t *node)
+{
+    ngx_uint_t          n;
+    ngx_rbtree_node_t  *head;
+
+    head = node->parent;
+
+    node->left->right = node->right;
+    node->right->left = node->left;
+
+    if (head->right == head) {
+        n = head - wheel->slots;
+        wheel->map[n / 64] &= ~((uint64_t) 1 << (n % 64));
+    }
+
+    wheel->count--;
+}
+
+
+/*
+ * The key of the nearest node if it is on the first level, otherwise
+ * the time the wheel moves down the nearest slot of a higher level, which
+ * is not later than any key in the slot.  The wheel must not be empty.
+ */
+
+ngx_rbtree_key_t
+ngx_timer_wheel_min(ngx_timer_wheel_t *wheel)
+{
+    ngx_uint_t        level, n, shift, slot;
+    ngx_rbtree_key_t  key, min;
+
+    slot = wheel->now & 255;
+
+    if (wheel->slots[slot].right != &wheel->slots[slot]) {
+        return wheel->now;
+    }
+
+    n = ngx_timer_wheel_find(wheel, 0, 256, slot + 1);
+
+    min = (n == 256) ? wheel->now + ((ngx_rbtree_key_t) 1 << 31)
+                     : wheel->now + 1 + n;
+
+    for (level = 1; level < NGX_TIMER_WHEEL_LEVELS; level++) {
+
+        shift = ngx_timer_wheel_shift(level);
+        slot = (wheel->now >> shift) & 63;
+
+        n = ngx_timer_wheel_find(wheel, ngx_timer_wheel_base(level), 64,
+                                 slot + 1);
+        if (n == 64) {
+            continue;
+        }
+
+        key = ((wheel->now >> shift) + 1 + n) << shift;
+
+        if ((ngx_rbtree_key_int_t) (key - min) < 0) {
+            min = key;
+        }
+    }
+
+    return min;
+}
+
+
+/*
+ * Returns an expired node, or NULL when there are no nodes with the key
+ * not later than "now".  The node stays in the wheel.
+ */
+
+ngx_rbtree_node_t *
+ngx_timer_wheel_expired(ngx_timer_wheel_t *wheel, ngx_rbtree_key_t now)
+{
+    ngx_uint_t          left;
+    ngx_rbtree_node_t  *head;
+
+    if ((ngx_rbtree_key_int_t) (now - wheel->now) < 0) {
+
+        /* the time has been moved back */
+
+        ngx_timer_wheel_rebuild(wheel, now);
+    }
+
+    for ( ;; ) {
+        head = &wheel->slots[wheel->now & 255];
+
+        if (head->right != head) {
+            return head->right;
+        }
+
+        if (wheel->now == now) {
+            return NULL;
+        }
+
+        if (wheel->count == 0) {
+            wheel->now = now;
+            return NULL;
+        }
+
+        if ((wheel->map[0] | wheel->map[1] | wheel->map[2] | wheel->map[3])
+            == 0)
+        {
+            /* nothing to expire up to the end of the first level */
+
+            left = 255 - (wheel->now & 255);
+
+            if (now - wheel->now <= left) {
+                wheel->now = now;
+                return NULL;
+            }
+
+            wheel->now += left;
+        }
+
+        wheel->now++;
+
+        if ((wheel->now & 255) == 0) {
+            ngx_timer_wheel_cascade(wheel);
+        }
+    }
+}
+
+
+/* iterates over the wheel in no particular order */
+
+ngx_rbtree_node_t *
+ngx_timer_wheel_next(ngx_timer_wheel_t *wheel, ngx_rbtree_node_t *node)
+{
+    ngx_uint_t  n;
+
+    if (node == NULL) {
+        n = 0;
+
+    } else {
+        if (node->right != node->parent) {
+            return node->right;
+        }
+
+        n = node->parent - wheel->slots + 1;
+    }
+
+    for ( /* void */ ; n < NGX_TIMER_WHEEL_SLOTS; n++) {
+        if (wheel->slots[n].right != &wheel->slots[n]) {
+            return wheel->slots[n].right;
+        }
+    }
+
+    return NULL;
+}
+
+
+static void
+ngx_timer_wheel_link(ngx_timer_wheel_t *wheel, ngx_rbtree_node_t *node)
+{
+    ngx_uint_t            n;
+    ngx_rbtree_key_t      key;
+    ngx_rbtree_node_t    *head;
+    ngx_rbtree_key_int_t  delta;
+
+    key = node->key;
+    delta = (ngx_rbtree_key_int_t) (key - wheel->now);
+
+    if (delta <= 0) {
+        n = wheel->now & 255;
+
+    } else if (delta < 1 << 8) {
+        n = key & 255;
+
+    } else if (delta < 1 << 14) {
+        n = ngx_timer_wheel_base(1) + ((key >> 8) & 63);
+
+    } else if (delta < 1 << 20) {
+        n = ngx_timer_wheel_base(2) + ((key >> 14) & 63);
+
+    } else if (delta < 1 << 26) {
+        n = ngx_timer_wheel_base(3) + ((key >> 20) & 63);
+
+    } else {
+        if ((uint64_t) delta > 0xffffffff) {
+            key = wheel->now + (ngx_rbtree_key_t) 0xffffffff;
+        }
+
+        n = ngx_timer_wheel_base(4) + ((key >> 26) & 63);
+    }
+
+    head = &wheel->slots[n];
+
+    node->parent = head;
+    node->left = head->left;
+    node->right = head;
+    head->left->right = node;
+    head->left = node;
+
+    wheel->map[n / 64] |= (uint64_t) 1 << (n % 64);
+}
+
+
+static void
+ngx_timer_wheel_cascade(ngx_timer_wheel_t *wheel)
+{
+    ngx_uint_t          level, n, slot;
+    ngx_rbtree_node_t  *head, *node, *next;
+
+    for (level = 1; level < NGX_TIMER_WHEEL_LEVELS; level++) {
+
+        slot = (wheel->now >> ngx_timer_wheel_shift(level)) & 63;
+        n = ngx_timer_wheel_base(level) + slot;
+
+        head = &wheel->slots[n];
+
+        if (head->right != head) {
+            node = head->right;
+
+            head->left->right = NULL;
+            head->left = head;
+            head->right = head;
+
+            wheel->map[n / 64] &= ~((uint64_t) 1 << (n % 64));
+
+            while (node) {
+                next = node->right;
+                ngx_timer_wheel_link(wheel, node);
+                node = next;
+            }
+        }
+
+        if (slot != 0) {
+            break;
+        }
+    }
+}
+
+
+static void
+ngx_timer_wheel_rebuild(ngx_timer_wheel_t *wheel, ngx_rbtree_key_t now)
+{
+    ngx_uint_t          i;
+    ngx_rbtree_node_t  *head, *node, *next, *list;
+
+    list = NULL;
+
+    for (i = 0; i < NGX_TIMER_WHEEL_SLOTS; i++) {
+        head = &wheel->slots[i];
+
+        for (node = head->right; node != head; node = next) {
+            next = node->right;
+            node->right = list;
+            list = node;
+        }
+
+        head->left = head;
+        head->right = head;
+    }
+
+    ngx_memzero(wheel->map, sizeof(wheel->map));
+
+    wheel->now = now;
+
+    while (list) {
+        next = list->right;
+        ngx_timer_wheel_link(wheel, list);
+        list = next;
+    }
+}
+
+
+/*
+ * the distance from "from" to the first used slot of a level,
+ * wrapping around, or "size" if the level is empty; the levels
+ * are aligned to the words of the map
+ */
+
+static ngx_uint_t
+ngx_timer_wheel_find(ngx_timer_wheel_t *wheel, ngx_uint_t base,
+    ngx_uint_t size, ngx_uint_t from)
+{
+    uint64_t    bits;
+    ngx_uint_t  i, n, off;
+
+    for (i = 0; i < size; /* void */ ) {
+        n = (from + i) & (size - 1);
+        off = (base + n) % 64;
+
+        bits = wheel->map[(base + n) / 64] >> off;
+
+        if (bits == 0) {
+            i += 64 - off;
+            continue;
+        }
+
+        if ((bits & 0xffffffff) == 0) {
+            bits >>= 32;
+            i += 32;
+        }
+
+        if ((bits & 0xffff) == 0) {
+            bits >>= 16;
+            i += 16;
+        }
+
+        if ((bits & 0xff) == 0) {
+            bits >>= 8;
+            i += 8;
+        }
+
+        if ((bits & 0xf) == 0) {
+            bits >>= 4;
+            i += 4;
+        }
+
+        if ((bits & 0x3) == 0) {
+            bits >>= 2;
+            i += 2;
+        }
+
+        if ((bits & 0x1) == 0) {
+            i += 1;
+        }
+
+        return (i < size) ? i : size;
+    }
+
+    return size;
+}
@@ -0,0 +1,50 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#ifndef _NGX_TIMER_WHEEL_H_INCLUDED_
+#define _NGX_TIMER_WHEEL_H_INCLUDED_
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+/*
+ * A hierarchical timing wheel of millisecond ticks: the first level has
+ * 256 slots of one tick, each next one 64 slots of 64 slots of the level
+ * below, so that the five levels cover 2^32 milliseconds.  The nodes are
+ * rbtree nodes: the key is the expiry time, the left and right pointers
+ * link a node into the list of its slot and the parent points to the slot.
+ */
+
+#define NGX_TIMER_WHEEL_LEVELS  5
+#define NGX_TIMER_WHEEL_SLOTS   (256 + 64 * (NGX_TIMER_WHEEL_LEVELS - 1))
+
+
+typedef struct {
+    ngx_rbtree_node_t   slots[NGX_TIMER_WHEEL_SLOTS];
+    uint64_t            map[NGX_TIMER_WHEEL_SLOTS / 64];
+    ngx_rbtree_key_t    now;
+    ngx_uint_t          count;
+} ngx_timer_wheel_t;
+
+
+#define ngx_timer_wheel_empty(wheel)  ((wheel)->count == 0)
+
+
+void ngx_timer_wheel_init(ngx_timer_wheel_t *wheel, ngx_rbtree_key_t now);
+void ngx_timer_wheel_insert(ngx_timer_wheel_t *wheel,
+    ngx_rbtree_node_t *node);
+void ngx_timer_wheel_delete(ngx_timer_wheel_t *wheel,
+    ngx_rbtree_node_t *node);
+ngx_rbtree_key_t ngx_timer_wheel_min(ngx_timer_wheel_t *wheel);
+ngx_rbtree_node_t *ngx_timer_wheel_expired(ngx_timer_wheel_t *wheel,
+    ngx_rbtree_key_t now);
+ngx_rbtree_node_t *ngx_timer_wheel_next(ngx_timer_wheel_t *wheel,
+    ngx_rbtree_node_t *node);
+
+
+#endif /* _NGX_TIMER_WHEEL_H_INCLUDED_ */
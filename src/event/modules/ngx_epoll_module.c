@@ -101,6 +101,9 @@ typedef struct {
 
 
 static ngx_int_t ngx_epoll_init(ngx_cycle_t *cycle, ngx_msec_t timer);
+#if (NGX_HAVE_EPOLLEXCLUSIVE)
+static void ngx_epoll_test_exclusive(ngx_cycle_t *cycle);
+#endif
 #if (NGX_HAVE_EVENTFD)
 static ngx_int_t ngx_epoll_notify_init(ngx_log_t *log);
 static void ngx_epoll_notify_handler(ngx_event_t *ev);
@@ -130,6 +133,10 @@ static int                  ep = -1;
 static struct epoll_event  *event_list;
 static ngx_uint_t           nevents;
 
+#if (NGX_HAVE_EPOLLEXCLUSIVE)
+static ngx_uint_t           use_exclusive;
+#endif
+
 #if (NGX_HAVE_EVENTFD)
 static int                  notify_fd = -1;
 static ngx_event_t          notify_event;
@@ -337,6 +344,10 @@ ngx_epoll_init(ngx_cycle_t *cycle, ngx_msec_t timer)
 
         ngx_epoll_aio_init(cycle, epcf);
 
+#endif
+
+#if (NGX_HAVE_EPOLLEXCLUSIVE)
+        ngx_epoll_test_exclusive(cycle);
 #endif
     }
 
@@ -366,10 +377,72 @@ ngx_epoll_init(ngx_cycle_t *cycle, ngx_msec_t timer)
                       |NGX_USE_GREEDY_EVENT
                       |NGX_USE_EPOLL_EVENT;
 
+#if (NGX_HAVE_EPOLLEXCLUSIVE)
+    if (use_exclusive) {
+        ngx_event_flags |= NGX_USE_EXCLUSIVE_EVENT;
+    }
+#endif
+
     return NGX_OK;
 }
 
 
+#if (NGX_HAVE_EPOLLEXCLUSIVE)
+
+/*
+ * kernels before 4.5 silently ignore EPOLLEXCLUSIVE, newer ones
+ * do not allow to modify an exclusive event
+ */
+
+static void
+ngx_epoll_test_exclusive(ngx_cycle_t *cycle)
+{
+    int                 s[2];
+    struct epoll_event  ee;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, s) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "socketpair() failed");
+        return;
+    }
+
+    ee.events = EPOLLIN|EPOLLEXCLUSIVE;
+    ee.data.ptr = NULL;
+
+    if (epoll_ctl(ep, EPOLL_CTL_ADD, s[0], &ee) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "epoll_ctl() failed");
+        goto failed;
+    }
+
+    if (epoll_ctl(ep, EPOLL_CTL_MOD, s[0], &ee) == -1) {
+        use_exclusive = 1;
+    }
+
+    if (epoll_ctl(ep, EPOLL_CTL_DEL, s[0], &ee) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "epoll_ctl() failed");
+    }
+
+failed:
+
+    if (close(s[0]) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "close() failed");
+    }
+
+    if (close(s[1]) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "close() failed");
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                   "epoll exclusive: %ui", use_exclusive);
+}
+
+#endif
+
+
 #if (NGX_HAVE_EVENTFD)
 
 static ngx_int_t
@@ -526,6 +599,12 @@ ngx_epoll_add_event(ngx_event_t *ev, ngx_int_t event, ngx_uint_t flags)
 #endif
     }
 
+#if (NGX_HAVE_EPOLLEXCLUSIVE && NGX_HAVE_EPOLLRDHUP)
+    if (flags & NGX_EXCLUSIVE_EVENT) {
+        events &= ~EPOLLRDHUP;
+    }
+#endif
+
     if (e->active) {
         op = EPOLL_CTL_MOD;
         events |= prev;
@@ -0,0 +1,879 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_event.h>
+
+
+/*
+ * The readiness of sockets is watched with multishot poll requests, one
+ * for each direction of a connection, which report every change as
+ * EPOLLET does.  Listening sockets are watched with single-shot polls
+ * instead, which are armed again after each completion and so report
+ * the pending connections as a level-triggered event does: an accept
+ * handler takes only one connection unless multi_accept is enabled, and
+ * connections that queue while a multishot poll is armed would not wake
+ * a worker again.  The requests to add and to remove polls, and the file
+ * AIO reads, are queued in the submission ring and are passed to the
+ * kernel together with the wait for completions, so a worker makes one
+ * syscall per iteration of its event loop.  Sockets are still read and written
+ * with ngx_io, when they are ready.
+ *
+ * A poll request holds a reference to the file, so the poll is removed
+ * even if the socket is being closed, and the socket is released when
+ * the removal is submitted.
+ */
+
+
+typedef struct {
+    ngx_uint_t  entries;
+} ngx_io_uring_conf_t;
+
+
+typedef struct {
+    uint32_t                   sq_entries;
+    uint32_t                   sq_mask;
+    uint32_t                   sq_tail;
+    uint32_t                   sq_pending;
+    volatile uint32_t         *sq_khead;
+    volatile uint32_t         *sq_ktail;
+    uint32_t                  *sq_array;
+    struct io_uring_sqe       *sqes;
+
+    uint32_t                   cq_mask;
+    volatile uint32_t         *cq_khead;
+    volatile uint32_t         *cq_ktail;
+    struct io_uring_cqe       *cqes;
+
+    void                      *sq_ring;
+    size_t                     sq_ring_size;
+    void                      *cq_ring;
+    size_t                     cq_ring_size;
+    size_t                     sqes_size;
+} ngx_io_uring_t;
+
+
+/* the user data of a request is an event with these bits */
+
+#define NGX_IO_URING_INSTANCE  1
+#define NGX_IO_URING_AIO       2
+#define NGX_IO_URING_MASK      3
+
+
+static ngx_int_t ngx_io_uring_init(ngx_cycle_t *cycle, ngx_msec_t timer);
+#if (NGX_HAVE_EVENTFD)
+static ngx_int_t ngx_io_uring_notify_init(ngx_log_t *log);
+static void ngx_io_uring_notify_handler(ngx_event_t *ev);
+#endif
+static void ngx_io_uring_done(ngx_cycle_t *cycle);
+static ngx_int_t ngx_io_uring_add_event(ngx_event_t *ev, ngx_int_t event,
+    ngx_uint_t flags);
+static ngx_int_t ngx_io_uring_del_event(ngx_event_t *ev, ngx_int_t event,
+    ngx_uint_t flags);
+static ngx_int_t ngx_io_uring_add_connection(ngx_connection_t *c);
+static ngx_int_t ngx_io_uring_del_connection(ngx_connection_t *c,
+    ngx_uint_t flags);
+#if (NGX_HAVE_EVENTFD)
+static ngx_int_t ngx_io_uring_notify(ngx_event_handler_pt handler);
+#endif
+static ngx_int_t ngx_io_uring_process_events(ngx_cycle_t *cycle,
+    ngx_msec_t timer, ngx_uint_t flags);
+
+static struct io_uring_sqe *ngx_io_uring_get_sqe(ngx_log_t *log);
+static ngx_int_t ngx_io_uring_poll(ngx_event_t *ev, ngx_socket_t fd,
+    uint32_t events, ngx_log_t *log);
+static ngx_int_t ngx_io_uring_poll_remove(ngx_event_t *ev, ngx_log_t *log);
+
+static void *ngx_io_uring_create_conf(ngx_cycle_t *cycle);
+static char *ngx_io_uring_init_conf(ngx_cycle_t *cycle, void *conf);
+
+
+static int                  uring = -1;
+static ngx_io_uring_t       ring;
+
+#if (NGX_HAVE_EVENTFD)
+static int                  notify_fd = -1;
+static ngx_event_t          notify_event;
+#endif
+
+static ngx_str_t      io_uring_name = ngx_string("io_uring");
+
+static ngx_command_t  ngx_io_uring_commands[] = {
+
+    { ngx_string("io_uring_entries"),
+      NGX_EVENT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      0,
+      offsetof(ngx_io_uring_conf_t, entries),
+      NULL },
+
+      ngx_null_command
+};
+
+
+ngx_event_module_t  ngx_io_uring_module_ctx = {
+    &io_uring_name,
+    ngx_io_uring_create_conf,            /* create configuration */
+    ngx_io_uring_init_conf,              /* init configuration */
+
+    {
+        ngx_io_uring_add_event,          /* add an event */
+        ngx_io_uring_del_event,          /* delete an event */
+        ngx_io_uring_add_event,          /* enable an event */
+        ngx_io_uring_del_event,          /* disable an event */
+        ngx_io_uring_add_connection,     /* add an connection */
+        ngx_io_uring_del_connection,     /* delete an connection */
+#if (NGX_HAVE_EVENTFD)
+        ngx_io_uring_notify,             /* trigger a notify */
+#else
+        NULL,                            /* trigger a notify */
+#endif
+        ngx_io_uring_process_events,     /* process the events */
+        ngx_io_uring_init,               /* init the events */
+        ngx_io_uring_done,               /* done the events */
+    }
+};
+
+ngx_module_t  ngx_io_uring_module = {
+    NGX_MODULE_V1,
+    &ngx_io_uring_module_ctx,            /* module context */
+    ngx_io_uring_commands,               /* module directives */
+    NGX_EVENT_MODULE,                    /* module type */
+    NULL,                                /* init master */
+    NULL,                                /* init module */
+    NULL,                                /* init process */
+    NULL,                                /* init thread */
+    NULL,                                /* exit thread */
+    NULL,                                /* exit process */
+    NULL,                                /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+/*
+ * We call io_uring_setup() and io_uring_enter() directly as syscalls,
+ * there is no need in liburing for a single ring.
+ */
+
+static int
+io_uring_setup(u_int entries, struct io_uring_params *p)
+{
+    return syscall(SYS_io_uring_setup, entries, p);
+}
+
+
+static int
+io_uring_enter(int fd, u_int to_submit, u_int min_complete, u_int flags,
+    void *arg, size_t argsz)
+{
+    return syscall(SYS_io_uring_enter, fd, to_submit, min_complete, flags,
+                   arg, argsz);
+}
+
+
+static ngx_int_t
+ngx_io_uring_init(ngx_cycle_t *cycle, ngx_msec_t timer)
+{
+    u_char                 *sq, *cq;
+    ngx_io_uring_conf_t    *urcf;
+    struct io_uring_params  p;
+
+    urcf = ngx_event_get_conf(cycle->conf_ctx, ngx_io_uring_module);
+
+    if (uring == -1) {
+
+        ngx_memzero(&p, sizeof(struct io_uring_params));
+
+        /* the poll requests may complete many times */
+
+        p.flags = IORING_SETUP_CQSIZE;
+        p.cq_entries = urcf->entries * 4;
+
+        uring = io_uring_setup(urcf->entries, &p);
+
+        if (uring == -1) {
+            ngx_log_error(NGX_LOG_EMERG, cycle->log, ngx_errno,
+                          "io_uring_setup(%ui) failed", urcf->entries);
+            return NGX_ERROR;
+        }
+
+        /* the timeout of io_uring_enter() and multishot poll, Linux 5.13 */
+
+        if ((p.features & (IORING_FEAT_EXT_ARG|IORING_FEAT_RSRC_TAGS))
+            != (IORING_FEAT_EXT_ARG|IORING_FEAT_RSRC_TAGS))
+        {
+            ngx_log_error(NGX_LOG_EMERG, cycle->log, 0,
+                          "io_uring of this kernel lacks multishot poll, "
+                          "Linux 5.13 is required");
+            goto failed;
+        }
+
+        ring.sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+        ring.cq_ring_size = p.cq_off.cqes
+                            + p.cq_entries * sizeof(struct io_uring_cqe);
+        ring.sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+        if (p.features & IORING_FEAT_SINGLE_MMAP) {
+            ring.sq_ring_size = ngx_max(ring.sq_ring_size, ring.cq_ring_size);
+            ring.cq_ring_size = 0;
+        }
+
+        ring.sq_ring = mmap(NULL, ring.sq_ring_size, PROT_READ|PROT_WRITE,
+                            MAP_SHARED|MAP_POPULATE, uring,
+                            IORING_OFF_SQ_RING);
+
+        if (ring.sq_ring == MAP_FAILED) {
+            ngx_log_error(NGX_LOG_EMERG, cycle->log, ngx_errno,
+                          "mmap(IORING_OFF_SQ_RING) failed");
+            ring.sq_ring = NULL;
+            goto failed;
+        }
+
+        if (ring.cq_ring_size) {
+            ring.cq_ring = mmap(NULL, ring.cq_ring_size, PROT_READ|PROT_WRITE,
+                                MAP_SHARED|MAP_POPULATE, uring,
+                                IORING_OFF_CQ_RING);
+
+            if (ring.cq_ring == MAP_FAILED) {
+                ngx_log_error(NGX_LOG_EMERG, cycle->log, ngx_errno,
+                              "mmap(IORING_OFF_CQ_RING) failed");
+                ring.cq_ring = NULL;
+                goto failed;
+            }
+
+        } else {
+            ring.cq_ring = ring.sq_ring;
+        }
+
+        ring.sqes = mmap(NULL, ring.sqes_size, PROT_READ|PROT_WRITE,
+                         MAP_SHARED|MAP_POPULATE, uring, IORING_OFF_SQES);
+
+        if (ring.sqes == MAP_FAILED) {
+            ngx_log_error(NGX_LOG_EMERG, cycle->log, ngx_errno,
+                          "mmap(IORING_OFF_SQES) failed");
+            ring.sqes = NULL;
+            goto failed;
+        }
+
+        sq = ring.sq_ring;
+        cq = ring.cq_ring;
+
+        ring.sq_entries = p.sq_entries;
+        ring.sq_mask = *(uint32_t *) (sq + p.sq_off.ring_mask);
+        ring.sq_khead = (uint32_t *) (sq + p.sq_off.head);
+        ring.sq_ktail = (uint32_t *) (sq + p.sq_off.tail);
+        ring.sq_array = (uint32_t *) (sq + p.sq_off.array);
+        ring.sq_tail = *ring.sq_ktail;
+        ring.sq_pending = 0;
+
+        ring.cq_mask = *(uint32_t *) (cq + p.cq_off.ring_mask);
+        ring.cq_khead = (uint32_t *) (cq + p.cq_off.head);
+        ring.cq_ktail = (uint32_t *) (cq + p.cq_off.tail);
+        ring.cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                       "io_uring: fd:%d sq:%uD cq:%uD",
+                       uring, p.sq_entries, p.cq_entries);
+
+#if (NGX_HAVE_EVENTFD)
+        if (ngx_io_uring_notify_init(cycle->log) != NGX_OK) {
+            ngx_io_uring_module_ctx.actions.notify = NULL;
+        }
+#endif
+    }
+
+    ngx_io = ngx_os_io;
+
+    ngx_event_actions = ngx_io_uring_module_ctx.actions;
+
+    /* the poll requests report sockets as epoll does */
+
+    ngx_event_flags = NGX_USE_CLEAR_EVENT
+                      |NGX_USE_GREEDY_EVENT
+                      |NGX_USE_EPOLL_EVENT
+                      |NGX_USE_IO_URING_EVENT;
+
+    return NGX_OK;
+
+failed:
+
+    ngx_io_uring_done(cycle);
+
+    return NGX_ERROR;
+}
+
+
+#if (NGX_HAVE_EVENTFD)
+
+static ngx_int_t
+ngx_io_uring_notify_init(ngx_log_t *log)
+{
+#if (NGX_HAVE_SYS_EVENTFD_H)
+    notify_fd = eventfd(0, 0);
+#else
+    notify_fd = syscall(SYS_eventfd, 0);
+#endif
+
+    if (notify_fd == -1) {
+        ngx_log_error(NGX_LOG_EMERG, log, ngx_errno, "eventfd() failed");
+        return NGX_ERROR;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, log, 0,
+                   "notify eventfd: %d", notify_fd);
+
+    notify_event.handler = ngx_io_uring_notify_handler;
+    notify_event.log = log;
+
+    if (ngx_io_uring_poll(&notify_event, notify_fd, POLLIN, log) != NGX_OK) {
+
+        if (close(notify_fd) == -1) {
+            ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                            "eventfd close() failed");
+        }
+
+        notify_fd = -1;
+
+        return NGX_ERROR;
+    }
+
+    notify_event.active = 1;
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_io_uring_notify_handler(ngx_event_t *ev)
+{
+    ssize_t               n;
+    uint64_t              count;
+    ngx_err_t             err;
+    ngx_event_handler_pt  handler;
+
+    if (++ev->index == NGX_MAX_UINT32_VALUE) {
+        ev->index = 0;
+
+        n = read(notify_fd, &count, sizeof(uint64_t));
+
+        err = ngx_errno;
+
+        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                       "read() eventfd %d: %z count:%uL", notify_fd, n, count);
+
+        if ((size_t) n != sizeof(uint64_t)) {
+            ngx_log_error(NGX_LOG_ALERT, ev->log, err,
+                          "read() eventfd %d failed", notify_fd);
+        }
+    }
+
+    handler = ev->data;
+    handler(ev);
+}
+
+#endif
+
+
+static void
+ngx_io_uring_done(ngx_cycle_t *cycle)
+{
+#if (NGX_HAVE_EVENTFD)
+
+    if (notify_fd != -1) {
+        if (close(notify_fd) == -1) {
+            ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                          "eventfd close() failed");
+        }
+
+        notify_fd = -1;
+    }
+
+#endif
+
+    if (ring.sqes && munmap(ring.sqes, ring.sqes_size) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "munmap(IORING_OFF_SQES) failed");
+    }
+
+    if (ring.cq_ring && ring.cq_ring != ring.sq_ring
+        && munmap(ring.cq_ring, ring.cq_ring_size) == -1)
+    {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "munmap(IORING_OFF_CQ_RING) failed");
+    }
+
+    if (ring.sq_ring && munmap(ring.sq_ring, ring.sq_ring_size) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "munmap(IORING_OFF_SQ_RING) failed");
+    }
+
+    if (uring != -1 && close(uring) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "io_uring close() failed");
+    }
+
+    ngx_memzero(&ring, sizeof(ngx_io_uring_t));
+
+    uring = -1;
+}
+
+
+static ngx_int_t
+ngx_io_uring_add_event(ngx_event_t *ev, ngx_int_t event, ngx_uint_t flags)
+{
+    uint32_t           events;
+    ngx_connection_t  *c;
+
+    if (ev->active) {
+        return NGX_OK;
+    }
+
+    c = ev->data;
+
+    if (event == NGX_READ_EVENT) {
+        events = POLLIN|POLLRDHUP;
+
+    } else {
+        events = POLLOUT;
+    }
+
+    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                   "io_uring add event: fd:%d ev:%04XD i:%ui",
+                   c->fd, events, ev->instance);
+
+    if (ngx_io_uring_poll(ev, c->fd, events, ev->log) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ev->active = 1;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_io_uring_del_event(ngx_event_t *ev, ngx_int_t event, ngx_uint_t flags)
+{
+    if (!ev->active) {
+        return NGX_OK;
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                   "io_uring del event: fd:%d ev:%d",
+                   ((ngx_connection_t *) ev->data)->fd, event);
+
+    /* the poll holds the file, so it is removed even on close */
+
+    ev->active = 0;
+
+    return ngx_io_uring_poll_remove(ev, ev->log);
+}
+
+
+static ngx_int_t
+ngx_io_uring_add_connection(ngx_connection_t *c)
+{
+    if (ngx_io_uring_add_event(c->read, NGX_READ_EVENT, NGX_CLEAR_EVENT)
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    if (ngx_io_uring_add_event(c->write, NGX_WRITE_EVENT, NGX_CLEAR_EVENT)
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_io_uring_del_connection(ngx_connection_t *c, ngx_uint_t flags)
+{
+    ngx_int_t  rc;
+
+    rc = NGX_OK;
+
+    if (ngx_io_uring_del_event(c->read, NGX_READ_EVENT, flags) != NGX_OK) {
+        rc = NGX_ERROR;
+    }
+
+    if (ngx_io_uring_del_event(c->write, NGX_WRITE_EVENT, flags) != NGX_OK) {
+        rc = NGX_ERROR;
+    }
+
+    return rc;
+}
+
+
+#if (NGX_HAVE_EVENTFD)
+
+static ngx_int_t
+ngx_io_uring_notify(ngx_event_handler_pt handler)
+{
+    static uint64_t inc = 1;
+
+    notify_event.data = handler;
+
+    if ((size_t) write(notify_fd, &inc, sizeof(uint64_t)) != sizeof(uint64_t)) {
+        ngx_log_error(NGX_LOG_ALERT, notify_event.log, ngx_errno,
+                      "write() to eventfd %d failed", notify_fd);
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+#endif
+
+
+static ngx_int_t
+ngx_io_uring_process_events(ngx_cycle_t *cycle, ngx_msec_t timer,
+    ngx_uint_t flags)
+{
+    int                              n;
+    uint32_t                         head, tail, revents;
+    ngx_int_t                        instance, res;
+    ngx_uint_t                       level, events, more;
+    ngx_err_t                        err;
+    ngx_event_t                     *ev;
+    ngx_queue_t                     *queue;
+    ngx_connection_t                *c;
+#if (NGX_HAVE_FILE_AIO)
+    ngx_event_aio_t                 *aio;
+#endif
+    struct io_uring_cqe             *cqe;
+    struct __kernel_timespec         ts;
+    struct io_uring_getevents_arg    arg;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                   "io_uring timer: %M, submit: %uD", timer, ring.sq_pending);
+
+    ngx_memzero(&arg, sizeof(struct io_uring_getevents_arg));
+
+    if (timer != NGX_TIMER_INFINITE) {
+        ts.tv_sec = timer / 1000;
+        ts.tv_nsec = (timer % 1000) * 1000000;
+        arg.ts = (uint64_t) (uintptr_t) &ts;
+    }
+
+    n = io_uring_enter(uring, ring.sq_pending, 1,
+                       IORING_ENTER_GETEVENTS|IORING_ENTER_EXT_ARG,
+                       &arg, sizeof(struct io_uring_getevents_arg));
+
+    err = (n == -1) ? ngx_errno : 0;
+
+    if (n > 0) {
+        ring.sq_pending -= ngx_min((uint32_t) n, ring.sq_pending);
+    }
+
+    if (flags & NGX_UPDATE_TIME || ngx_event_timer_alarm) {
+        ngx_time_update();
+    }
+
+    if (err && err != ETIME && err != NGX_EBUSY && err != NGX_EAGAIN) {
+        if (err == NGX_EINTR) {
+
+            if (ngx_event_timer_alarm) {
+                ngx_event_timer_alarm = 0;
+                return NGX_OK;
+            }
+
+            level = NGX_LOG_INFO;
+
+        } else {
+            level = NGX_LOG_ALERT;
+        }
+
+        ngx_log_error(level, cycle->log, err, "io_uring_enter() failed");
+        return NGX_ERROR;
+    }
+
+    events = 0;
+
+    for ( ;; ) {
+        head = *ring.cq_khead;
+        tail = *ring.cq_ktail;
+
+        ngx_memory_barrier();
+
+        if (head == tail) {
+            break;
+        }
+
+        cqe = &ring.cqes[head & ring.cq_mask];
+
+        ev = (ngx_event_t *) (uintptr_t) cqe->user_data;
+        res = cqe->res;
+        more = cqe->flags & IORING_CQE_F_MORE;
+
+        ngx_memory_barrier();
+
+        *ring.cq_khead = head + 1;
+
+        events++;
+
+        if (ev == NULL) {
+            /* a removal of a poll */
+            continue;
+        }
+
+#if (NGX_HAVE_FILE_AIO)
+
+        if ((uintptr_t) ev & NGX_IO_URING_AIO) {
+            ev = (ngx_event_t *) ((uintptr_t) ev & ~NGX_IO_URING_MASK);
+
+            ngx_log_debug2(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                           "io_uring: aio %p res:%i", ev, res);
+
+            ev->complete = 1;
+            ev->active = 0;
+            ev->ready = 1;
+
+            aio = ev->data;
+            aio->res = res;
+
+            ngx_post_event(ev, &ngx_posted_events);
+
+            continue;
+        }
+
+#endif
+
+        instance = (uintptr_t) ev & NGX_IO_URING_INSTANCE;
+        ev = (ngx_event_t *) ((uintptr_t) ev & ~NGX_IO_URING_MASK);
+
+        if (res == -NGX_ECANCELED) {
+            continue;
+        }
+
+#if (NGX_HAVE_EVENTFD)
+
+        if (ev == &notify_event) {
+            if (!more) {
+                (void) ngx_io_uring_poll(ev, notify_fd, POLLIN, cycle->log);
+            }
+
+            ev->handler(ev);
+            continue;
+        }
+
+#endif
+
+        c = ev->data;
+
+        if (c->fd == -1 || ev->instance != instance || !ev->active) {
+
+            /*
+             * the stale event from a file descriptor
+             * that was just closed in this iteration
+             */
+
+            ngx_log_debug1(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                           "io_uring: stale event %p", ev);
+            continue;
+        }
+
+        revents = (res < 0) ? POLLERR : (uint32_t) res;
+
+        ngx_log_debug4(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                       "io_uring: fd:%d ev:%04XD more:%ui d:%p",
+                       c->fd, revents, more, ev);
+
+        if (!more) {
+
+            /*
+             * the poll is single-shot, or it is finished by an error,
+             * which the handler will see, or by an overflow of the
+             * completion ring
+             */
+
+            if (res < 0
+                || ngx_io_uring_poll(ev, c->fd,
+                                     ev->write ? POLLOUT : POLLIN|POLLRDHUP,
+                                     cycle->log)
+                   != NGX_OK)
+            {
+                ev->active = 0;
+            }
+        }
+
+        if (!ev->write && (revents & POLLRDHUP)) {
+            ev->pending_eof = 1;
+        }
+
+        ev->ready = 1;
+
+        if (flags & NGX_POST_EVENTS) {
+            queue = ev->accept ? &ngx_posted_accept_events
+                               : &ngx_posted_events;
+
+            ngx_post_event(ev, queue);
+
+        } else {
+            ev->handler(ev);
+        }
+    }
+
+    if (events == 0 && err == 0 && timer == NGX_TIMER_INFINITE) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, 0,
+                      "io_uring_enter() returned no events without timeout");
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+static struct io_uring_sqe *
+ngx_io_uring_get_sqe(ngx_log_t *log)
+{
+    int                   n;
+    uint32_t              index;
+    struct io_uring_sqe  *sqe;
+
+    if (ring.sq_tail - *ring.sq_khead == ring.sq_entries) {
+
+        /* the submission ring is full */
+
+        n = io_uring_enter(uring, ring.sq_pending, 0, 0, NULL, 0);
+
+        if (n == -1) {
+            ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                          "io_uring_enter() failed");
+            return NULL;
+        }
+
+        ring.sq_pending -= ngx_min((uint32_t) n, ring.sq_pending);
+
+        if (ring.sq_tail - *ring.sq_khead == ring.sq_entries) {
+            ngx_log_error(NGX_LOG_ALERT, log, 0,
+                          "io_uring submission ring is full");
+            return NULL;
+        }
+    }
+
+    index = ring.sq_tail & ring.sq_mask;
+
+    sqe = &ring.sqes[index];
+    ngx_memzero(sqe, sizeof(struct io_uring_sqe));
+
+    ring.sq_array[index] = index;
+
+    return sqe;
+}
+
+
+#define ngx_io_uring_put_sqe()                                                \
+    ngx_memory_barrier();                                                     \
+    *ring.sq_ktail = ++ring.sq_tail;                                          \
+    ring.sq_pending++
+
+
+static ngx_int_t
+ngx_io_uring_poll(ngx_event_t *ev, ngx_socket_t fd, uint32_t events,
+    ngx_log_t *log)
+{
+    struct io_uring_sqe  *sqe;
+
+    sqe = ngx_io_uring_get_sqe(log);
+    if (sqe == NULL) {
+        return NGX_ERROR;
+    }
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->len = ev->accept ? 0 : IORING_POLL_ADD_MULTI;
+    sqe->user_data = (uintptr_t) ev | ev->instance;
+
+#if (NGX_HAVE_LITTLE_ENDIAN)
+    sqe->poll32_events = events;
+#else
+    sqe->poll32_events = (events << 16) | (events >> 16);
+#endif
+
+    ngx_io_uring_put_sqe();
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_io_uring_poll_remove(ngx_event_t *ev, ngx_log_t *log)
+{
+    struct io_uring_sqe  *sqe;
+
+    sqe = ngx_io_uring_get_sqe(log);
+    if (sqe == NULL) {
+        return NGX_ERROR;
+    }
+
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->addr = (uintptr_t) ev | ev->instance;
+    sqe->user_data = 0;
+
+    ngx_io_uring_put_sqe();
+
+    return NGX_OK;
+}
+
+
+#if (NGX_HAVE_FILE_AIO)
+
+ngx_int_t
+ngx_io_uring_aio_read(ngx_event_aio_t *aio, u_char *buf, size_t size,
+    off_t offset)
+{
+    struct io_uring_sqe  *sqe;
+
+    sqe = ngx_io_uring_get_sqe(aio->event.log);
+    if (sqe == NULL) {
+        return NGX_ERROR;
+    }
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = aio->fd;
+    sqe->addr = (uintptr_t) buf;
+    sqe->len = size;
+    sqe->off = offset;
+    sqe->user_data = (uintptr_t) &aio->event | NGX_IO_URING_AIO;
+
+    ngx_io_uring_put_sqe();
+
+    return NGX_OK;
+}
+
+#endif
+
+
+static void *
+ngx_io_uring_create_conf(ngx_cycle_t *cycle)
+{
+    ngx_io_uring_conf_t  *urcf;
+
+    urcf = ngx_palloc(cycle->pool, sizeof(ngx_io_uring_conf_t));
+    if (urcf == NULL) {
+        return NULL;
+    }
+
+    urcf->entries = NGX_CONF_UNSET;
+
+    return urcf;
+}
+
+
+static char *
+ngx_io_uring_init_conf(ngx_cycle_t *cycle, void *conf)
+{
+    ngx_io_uring_conf_t *urcf = conf;
+
+    ngx_conf_init_uint_value(urcf->entries, 1024);
+
+    return NGX_CONF_OK;
+}
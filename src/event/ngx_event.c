@@ -73,6 +73,10 @@ ngx_atomic_t   ngx_stat_writing0;
 ngx_atomic_t  *ngx_stat_writing = &ngx_stat_writing0;
 ngx_atomic_t   ngx_stat_waiting0;
 ngx_atomic_t  *ngx_stat_waiting = &ngx_stat_waiting0;
+ngx_atomic_t   ngx_stat_wakeups0;
+ngx_atomic_t  *ngx_stat_wakeups = &ngx_stat_wakeups0;
+ngx_atomic_t   ngx_stat_exhausted0;
+ngx_atomic_t  *ngx_stat_exhausted = &ngx_stat_exhausted0;
 
 #endif
 
@@ -117,6 +121,14 @@ ngx_module_t  ngx_events_module = {
 static ngx_str_t  event_core_name = ngx_string("event_core");
 
 
+static ngx_conf_enum_t  ngx_event_multi_accept[] = {
+    { ngx_string("off"), NGX_EVENT_MULTI_ACCEPT_OFF },
+    { ngx_string("on"), NGX_EVENT_MULTI_ACCEPT_ON },
+    { ngx_string("auto"), NGX_EVENT_MULTI_ACCEPT_AUTO },
+    { ngx_null_string, 0 }
+};
+
+
 static ngx_command_t  ngx_event_core_commands[] = {
 
     { ngx_string("worker_connections"),
@@ -134,11 +146,11 @@ static ngx_command_t  ngx_event_core_commands[] = {
       NULL },
 
     { ngx_string("multi_accept"),
-      NGX_EVENT_CONF|NGX_CONF_FLAG,
-      ngx_conf_set_flag_slot,
+      NGX_EVENT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_enum_slot,
       0,
       offsetof(ngx_event_conf_t, multi_accept),
-      NULL },
+      &ngx_event_multi_accept },
 
     { ngx_string("accept_mutex"),
       NGX_EVENT_CONF|NGX_CONF_FLAG,
@@ -154,6 +166,13 @@ static ngx_command_t  ngx_event_core_commands[] = {
       offsetof(ngx_event_conf_t, accept_mutex_delay),
       NULL },
 
+    { ngx_string("timer_wheel"),
+      NGX_EVENT_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      0,
+      offsetof(ngx_event_conf_t, timer_wheel),
+      NULL },
+
     { ngx_string("debug_connection"),
       NGX_EVENT_CONF|NGX_CONF_TAKE1,
       ngx_event_debug_connection,
@@ -237,6 +256,13 @@ ngx_process_events_and_timers(ngx_cycle_t *cycle)
         }
     }
 
+    /* after the accept mutex, as the deferred accepts need it */
+
+    if (!ngx_queue_empty(&ngx_posted_next_events)) {
+        ngx_event_move_posted_next(cycle);
+        timer = 0;
+    }
+
     delta = ngx_current_msec;
 
     (void) ngx_process_events(cycle, timer, flags);
@@ -495,10 +521,14 @@ ngx_event_module_init(ngx_cycle_t *cycle)
            + cl          /* ngx_stat_active */
            + cl          /* ngx_stat_reading */
            + cl          /* ngx_stat_writing */
-           + cl;         /* ngx_stat_waiting */
+           + cl          /* ngx_stat_waiting */
+           + cl          /* ngx_stat_wakeups */
+           + cl;         /* ngx_stat_exhausted */
 
 #endif
 
+    ngx_memzero(&shm, sizeof(ngx_shm_t));
+
     shm.size = size;
     shm.name.len = sizeof("nginx_shared_zone") - 1;
     shm.name.data = (u_char *) "nginx_shared_zone";
@@ -543,6 +573,8 @@ ngx_event_module_init(ngx_cycle_t *cycle)
     ngx_stat_reading = (ngx_atomic_t *) (shared + 7 * cl);
     ngx_stat_writing = (ngx_atomic_t *) (shared + 8 * cl);
     ngx_stat_waiting = (ngx_atomic_t *) (shared + 9 * cl);
+    ngx_stat_wakeups = (ngx_atomic_t *) (shared + 10 * cl);
+    ngx_stat_exhausted = (ngx_atomic_t *) (shared + 11 * cl);
 
 #endif
 
@@ -601,6 +633,7 @@ ngx_event_process_init(ngx_cycle_t *cycle)
 
     ngx_queue_init(&ngx_posted_accept_events);
     ngx_queue_init(&ngx_posted_events);
+    ngx_queue_init(&ngx_posted_next_events);
 
     if (ngx_event_timer_init(cycle->log) == NGX_ERROR) {
         return NGX_ERROR;
@@ -625,6 +658,18 @@ ngx_event_process_init(ngx_cycle_t *cycle)
         break;
     }
 
+    /*
+     * unless "accept_mutex" is set, exclusive wakeups replace
+     * the accept mutex where the kernel supports them
+     */
+
+    if (ngx_use_accept_mutex
+        && ecf->accept_mutex == NGX_CONF_UNSET
+        && (ngx_event_flags & NGX_USE_EXCLUSIVE_EVENT))
+    {
+        ngx_use_accept_mutex = 0;
+    }
+
 #if !(NGX_WIN32)
 
     if (ngx_timer_resolution && !(ngx_event_flags & NGX_USE_TIMER_EVENT)) {
@@ -731,6 +776,45 @@ ngx_event_process_init(ngx_cycle_t *cycle)
         }
 #endif
 
+#if (NGX_HAVE_INCOMING_CPU && NGX_HAVE_CPU_AFFINITY)
+
+        if (ls[i].incoming_cpu) {
+            int            cpu;
+            ngx_cpuset_t  *mask;
+
+            /*
+             * the socket of the worker is preferred for connections
+             * whose packets are received on the CPU the worker is bound to
+             */
+
+            mask = ngx_get_cpu_affinity(ngx_worker);
+
+            if (mask == NULL) {
+                ngx_log_error(NGX_LOG_WARN, cycle->log, 0,
+                              "incoming_cpu of %V is ignored "
+                              "without \"worker_cpu_affinity\"",
+                              &ls[i].addr_text);
+
+            } else {
+                cpu = 0;
+
+                while (cpu < CPU_SETSIZE && !CPU_ISSET(cpu, mask)) {
+                    cpu++;
+                }
+
+                if (setsockopt(ls[i].fd, SOL_SOCKET, SO_INCOMING_CPU,
+                               (const void *) &cpu, sizeof(int))
+                    == -1)
+                {
+                    ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_socket_errno,
+                                  "setsockopt(SO_INCOMING_CPU, %d) %V failed, "
+                                  "ignored", cpu, &ls[i].addr_text);
+                }
+            }
+        }
+
+#endif
+
         c = ngx_get_connection(ls[i].fd, cycle->log);
 
         if (c == NULL) {
@@ -811,15 +895,45 @@ ngx_event_process_init(ngx_cycle_t *cycle)
 
         rev->handler = ngx_event_accept;
 
-        if (ngx_use_accept_mutex
 #if (NGX_HAVE_REUSEPORT)
-            && !ls[i].reuseport
+
+        if (ls[i].reuseport) {
+            if (ngx_add_event(rev, NGX_READ_EVENT, 0) == NGX_ERROR) {
+                return NGX_ERROR;
+            }
+
+            continue;
+        }
+
 #endif
-           )
+
+        if (ngx_use_accept_mutex) {
+            continue;
+        }
+
+#if (NGX_HAVE_EPOLLEXCLUSIVE)
+
+        /*
+         * a socket shared by workers wakes up only one of them,
+         * which replaces the accept mutex and avoids thundering herd
+         */
+
+        if ((ngx_event_flags & NGX_USE_EXCLUSIVE_EVENT)
+            && ccf->master && ccf->worker_processes > 1)
         {
+            ls[i].exclusive = 1;
+
+            if (ngx_add_event(rev, NGX_READ_EVENT, NGX_EXCLUSIVE_EVENT)
+                == NGX_ERROR)
+            {
+                return NGX_ERROR;
+            }
+
             continue;
         }
 
+#endif
+
         if (ngx_add_event(rev, NGX_READ_EVENT, 0) == NGX_ERROR) {
             return NGX_ERROR;
         }
@@ -1155,9 +1269,10 @@ ngx_event_core_create_conf(ngx_cycle_t *cycle)
 
     ecf->connections = NGX_CONF_UNSET_UINT;
     ecf->use = NGX_CONF_UNSET_UINT;
-    ecf->multi_accept = NGX_CONF_UNSET;
+    ecf->multi_accept = NGX_CONF_UNSET_UINT;
     ecf->accept_mutex = NGX_CONF_UNSET;
     ecf->accept_mutex_delay = NGX_CONF_UNSET_MSEC;
+    ecf->timer_wheel = NGX_CONF_UNSET;
     ecf->name = (void *) NGX_CONF_UNSET;
 
 #if (NGX_DEBUG)
@@ -1254,9 +1369,10 @@ ngx_event_core_init_conf(ngx_cycle_t *cycle, void *conf)
     event_module = module->ctx;
     ngx_conf_init_ptr_value(ecf->name, event_module->name->data);
 
-    ngx_conf_init_value(ecf->multi_accept, 0);
-    ngx_conf_init_value(ecf->accept_mutex, 1);
+    ngx_conf_init_uint_value(ecf->multi_accept, NGX_EVENT_MULTI_ACCEPT_OFF);
+    /* an unset accept_mutex is resolved by ngx_event_process_init() */
     ngx_conf_init_msec_value(ecf->accept_mutex_delay, 500);
+    ngx_conf_init_value(ecf->timer_wheel, 0);
 
     return NGX_CONF_OK;
 }
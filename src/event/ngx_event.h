@@ -276,6 +276,17 @@ extern ngx_event_actions_t   ngx_event_actions;
  */
 #define NGX_USE_VNODE_EVENT      0x00002000
 
+/*
+ * The event filter is io_uring, it also reads files: io_uring.
+ */
+#define NGX_USE_IO_URING_EVENT   0x00004000
+
+/*
+ * The event filter wakes up only one of the processes waiting for
+ * a shared socket: epoll with EPOLLEXCLUSIVE, Linux 4.5.
+ */
+#define NGX_USE_EXCLUSIVE_EVENT  0x00008000
+
 
 /*
  * The event filter is deleted just before the closing file.
@@ -364,6 +375,10 @@ extern ngx_event_actions_t   ngx_event_actions;
 #define NGX_ONESHOT_EVENT  EPOLLONESHOT
 #endif
 
+#if (NGX_HAVE_EPOLLEXCLUSIVE)
+#define NGX_EXCLUSIVE_EVENT  EPOLLEXCLUSIVE
+#endif
+
 
 #elif (NGX_HAVE_POLL)
 
@@ -424,15 +439,22 @@ extern ngx_os_io_t  ngx_io;
 #define NGX_EVENT_CONF        0x02000000
 
 
+#define NGX_EVENT_MULTI_ACCEPT_OFF   0
+#define NGX_EVENT_MULTI_ACCEPT_ON    1
+#define NGX_EVENT_MULTI_ACCEPT_AUTO  2
+
+
 typedef struct {
     ngx_uint_t    connections;
     ngx_uint_t    use;
 
-    ngx_flag_t    multi_accept;
+    ngx_uint_t    multi_accept;
     ngx_flag_t    accept_mutex;
 
     ngx_msec_t    accept_mutex_delay;
 
+    ngx_flag_t    timer_wheel;
+
     u_char       *name;
 
 #if (NGX_DEBUG)
@@ -451,6 +473,14 @@ typedef struct {
 } ngx_event_module_t;
 
 
+typedef struct {
+    ngx_uint_t    queue;       /* connections waiting to be accepted */
+    ngx_uint_t    backlog;
+    ngx_uint_t    overflows;   /* system wide, since boot */
+    ngx_uint_t    drops;       /* system wide, since boot */
+} ngx_accept_backlog_t;
+
+
 extern ngx_atomic_t          *ngx_connection_counter;
 
 extern ngx_atomic_t          *ngx_accept_mutex_ptr;
@@ -471,6 +501,8 @@ extern ngx_atomic_t  *ngx_stat_active;
 extern ngx_atomic_t  *ngx_stat_reading;
 extern ngx_atomic_t  *ngx_stat_writing;
 extern ngx_atomic_t  *ngx_stat_waiting;
+extern ngx_atomic_t  *ngx_stat_wakeups;
+extern ngx_atomic_t  *ngx_stat_exhausted;
 
 #endif
 
@@ -493,6 +525,7 @@ extern ngx_module_t           ngx_event_core_module;
 void ngx_event_accept(ngx_event_t *ev);
 ngx_int_t ngx_trylock_accept_mutex(ngx_cycle_t *cycle);
 u_char *ngx_accept_log_error(ngx_log_t *log, u_char *buf, size_t len);
+void ngx_event_accept_backlog(ngx_cycle_t *cycle, ngx_accept_backlog_t *bl);
 
 
 void ngx_process_events_and_timers(ngx_cycle_t *cycle);
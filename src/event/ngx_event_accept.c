@@ -10,9 +10,25 @@
 #include <ngx_event.h>
 
 
+#define NGX_ACCEPT_BUDGET      16
+#define NGX_ACCEPT_BUDGET_MAX  512
+#define NGX_ACCEPT_LATENCY     10
+
+
+static ngx_uint_t ngx_event_accept_budget(ngx_listening_t *ls,
+    ngx_event_conf_t *ecf);
 static ngx_int_t ngx_enable_accept_events(ngx_cycle_t *cycle);
 static ngx_int_t ngx_disable_accept_events(ngx_cycle_t *cycle, ngx_uint_t all);
 static void ngx_close_accepted_connection(ngx_connection_t *c);
+#if (NGX_LINUX)
+static void ngx_event_accept_netstat(ngx_accept_backlog_t *bl,
+    ngx_log_t *log);
+#endif
+
+
+static ngx_accept_backlog_t  ngx_accept_backlog;
+static ngx_msec_t            ngx_accept_backlog_time;
+static ngx_uint_t            ngx_accept_backlog_valid;
 
 
 void
@@ -21,7 +37,7 @@ ngx_event_accept(ngx_event_t *ev)
     socklen_t          socklen;
     ngx_err_t          err;
     ngx_log_t         *log;
-    ngx_uint_t         level;
+    ngx_uint_t         level, budget;
     ngx_socket_t       s;
     ngx_event_t       *rev, *wev;
     ngx_listening_t   *ls;
@@ -40,18 +56,32 @@ ngx_event_accept(ngx_event_t *ev)
         ev->timedout = 0;
     }
 
+    if (ev->posted) {
+
+        /* the event has been posted to continue after the exhausted budget */
+
+        ngx_delete_posted_event(ev);
+    }
+
     ecf = ngx_event_get_conf(ngx_cycle->conf_ctx, ngx_event_core_module);
 
     if (!(ngx_event_flags & NGX_USE_KQUEUE_EVENT)) {
-        ev->available = ecf->multi_accept;
+        ev->available = (ecf->multi_accept != NGX_EVENT_MULTI_ACCEPT_OFF);
     }
 
     lc = ev->data;
     ls = lc->listening;
     ev->ready = 0;
 
-    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ev->log, 0,
-                   "accept on %V, ready: %d", &ls->addr_text, ev->available);
+    budget = ngx_event_accept_budget(ls, ecf);
+
+#if (NGX_STAT_STUB)
+    (void) ngx_atomic_fetch_add(ngx_stat_wakeups, 1);
+#endif
+
+    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                   "accept on %V, ready: %d, budget: %ui",
+                   &ls->addr_text, ev->available, budget);
 
     do {
         socklen = NGX_SOCKADDRLEN;
@@ -159,6 +189,8 @@ ngx_event_accept(ngx_event_t *ev)
             return;
         }
 
+        ngx_pool_set_type(c->pool, NGX_POOL_CONNECTION);
+
         c->sockaddr = ngx_palloc(c->pool, socklen);
         if (c->sockaddr == NULL) {
             ngx_close_accepted_connection(c);
@@ -359,7 +391,76 @@ ngx_event_accept(ngx_event_t *ev)
             ev->available--;
         }
 
-    } while (ev->available);
+    } while (ev->available && --budget);
+
+    if (budget == 0) {
+
+        /*
+         * the rest of the queue is accepted in the next iteration
+         * of the event loop, after the events of the connections
+         * already accepted have been handled
+         */
+
+        ngx_log_debug0(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                       "accept budget exhausted");
+
+#if (NGX_STAT_STUB)
+        (void) ngx_atomic_fetch_add(ngx_stat_exhausted, 1);
+#endif
+
+        ls->accept_exhausted = 1;
+
+        ngx_post_event(ev, &ngx_posted_next_events);
+    }
+}
+
+
+/*
+ * The budget of "multi_accept auto" is the number of connections
+ * accepted at once.  While the accept queue is not drained, the budget
+ * is doubled if the worker came back to the queue within
+ * NGX_ACCEPT_LATENCY, and halved otherwise.  It never exceeds the
+ * connections left before the worker stops accepting, see
+ * ngx_accept_disabled.
+ */
+
+static ngx_uint_t
+ngx_event_accept_budget(ngx_listening_t *ls, ngx_event_conf_t *ecf)
+{
+    ngx_int_t   free;
+    ngx_uint_t  budget;
+
+    if (ecf->multi_accept != NGX_EVENT_MULTI_ACCEPT_AUTO) {
+        return NGX_MAX_UINT32_VALUE;
+    }
+
+    if (ls->accept_budget == 0) {
+        ls->accept_budget = NGX_ACCEPT_BUDGET;
+
+    } else if (ls->accept_exhausted) {
+
+        if (ngx_current_msec - ls->accept_time > NGX_ACCEPT_LATENCY) {
+            if (ls->accept_budget > 1) {
+                ls->accept_budget /= 2;
+            }
+
+        } else if (ls->accept_budget < NGX_ACCEPT_BUDGET_MAX) {
+            ls->accept_budget *= 2;
+        }
+    }
+
+    ls->accept_time = ngx_current_msec;
+    ls->accept_exhausted = 0;
+
+    budget = ls->accept_budget;
+
+    free = ngx_cycle->free_connection_n - ngx_cycle->connection_n / 8;
+
+    if (free < (ngx_int_t) budget) {
+        budget = (free > 1) ? free : 1;
+    }
+
+    return budget;
 }
 
 
@@ -404,7 +505,7 @@ ngx_trylock_accept_mutex(ngx_cycle_t *cycle)
 static ngx_int_t
 ngx_enable_accept_events(ngx_cycle_t *cycle)
 {
-    ngx_uint_t         i;
+    ngx_uint_t         i, flags;
     ngx_listening_t   *ls;
     ngx_connection_t  *c;
 
@@ -417,7 +518,19 @@ ngx_enable_accept_events(ngx_cycle_t *cycle)
             continue;
         }
 
-        if (ngx_add_event(c->read, NGX_READ_EVENT, 0) == NGX_ERROR) {
+        flags = 0;
+
+#if (NGX_HAVE_EPOLLEXCLUSIVE)
+
+        /* as added by ngx_event_process_init() */
+
+        if (ls[i].exclusive) {
+            flags = NGX_EXCLUSIVE_EVENT;
+        }
+
+#endif
+
+        if (ngx_add_event(c->read, NGX_READ_EVENT, flags) == NGX_ERROR) {
             return NGX_ERROR;
         }
     }
@@ -455,6 +568,10 @@ ngx_disable_accept_events(ngx_cycle_t *cycle, ngx_uint_t all)
 
 #endif
 
+        if (c->read->posted) {
+            ngx_delete_posted_event(c->read);
+        }
+
         if (ngx_del_event(c->read, NGX_READ_EVENT, NGX_DISABLE_EVENT)
             == NGX_ERROR)
         {
@@ -491,6 +608,182 @@ ngx_close_accepted_connection(ngx_connection_t *c)
 }
 
 
+void
+ngx_event_accept_backlog(ngx_cycle_t *cycle, ngx_accept_backlog_t *bl)
+{
+#if (NGX_LINUX && NGX_HAVE_TCP_INFO)
+    socklen_t         len;
+    ngx_uint_t        i;
+    struct tcp_info   ti;
+    ngx_listening_t  *ls;
+#endif
+
+    /* the values are read once per timer tick */
+
+    if (ngx_accept_backlog_valid
+        && ngx_accept_backlog_time == ngx_current_msec)
+    {
+        *bl = ngx_accept_backlog;
+        return;
+    }
+
+    ngx_memzero(bl, sizeof(ngx_accept_backlog_t));
+
+#if (NGX_LINUX && NGX_HAVE_TCP_INFO)
+
+    /*
+     * Linux reports the accept queue of a listening socket
+     * in tcpi_unacked and its backlog in tcpi_sacked
+     */
+
+    ls = cycle->listening.elts;
+    for (i = 0; i < cycle->listening.nelts; i++) {
+
+        if (ls[i].fd == (ngx_socket_t) -1 || ls[i].type != SOCK_STREAM) {
+            continue;
+        }
+
+#if (NGX_HAVE_UNIX_DOMAIN)
+        if (ls[i].sockaddr->sa_family == AF_UNIX) {
+            continue;
+        }
+#endif
+
+        len = sizeof(struct tcp_info);
+
+        if (getsockopt(ls[i].fd, IPPROTO_TCP, TCP_INFO, &ti, &len) == -1) {
+            continue;
+        }
+
+        if (ti.tcpi_state != TCP_LISTEN) {
+            continue;
+        }
+
+        bl->queue += ti.tcpi_unacked;
+        bl->backlog += ti.tcpi_sacked;
+    }
+
+#endif
+
+#if (NGX_LINUX)
+    ngx_event_accept_netstat(bl, cycle->log);
+#endif
+
+    ngx_accept_backlog = *bl;
+    ngx_accept_backlog_time = ngx_current_msec;
+    ngx_accept_backlog_valid = 1;
+}
+
+
+#if (NGX_LINUX)
+
+/*
+ * the TcpExt lines of /proc/net/netstat, one of the counter names
+ * followed by one of their values
+ */
+
+static void
+ngx_event_accept_netstat(ngx_accept_backlog_t *bl, ngx_log_t *log)
+{
+    u_char     *name, *value, *p, *q;
+    size_t      len;
+    ssize_t     n;
+    ngx_fd_t    fd;
+    ngx_int_t   v;
+    u_char      buf[8192];
+
+    fd = ngx_open_file((u_char *) "/proc/net/netstat", NGX_FILE_RDONLY,
+                       NGX_FILE_OPEN, 0);
+
+    if (fd == NGX_INVALID_FILE) {
+        ngx_log_debug0(NGX_LOG_DEBUG_EVENT, log, ngx_errno,
+                       ngx_open_file_n " \"/proc/net/netstat\" failed");
+        return;
+    }
+
+    n = ngx_read_fd(fd, buf, sizeof(buf) - 1);
+
+    if (n == -1) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      ngx_read_fd_n " \"/proc/net/netstat\" failed");
+    }
+
+    if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      ngx_close_file_n " \"/proc/net/netstat\" failed");
+    }
+
+    if (n < (ssize_t) sizeof("TcpExt:") - 1
+        || ngx_strncmp(buf, "TcpExt:", sizeof("TcpExt:") - 1) != 0)
+    {
+        return;
+    }
+
+    buf[n] = LF;
+
+    name = buf + sizeof("TcpExt:") - 1;
+
+    value = ngx_strlchr(name, buf + n, LF);
+
+    if (value == NULL
+        || buf + n - value < (ssize_t) sizeof("TcpExt:")
+        || ngx_strncmp(value + 1, "TcpExt:", sizeof("TcpExt:") - 1) != 0)
+    {
+        return;
+    }
+
+    value += sizeof("TcpExt:");
+
+    for ( ;; ) {
+
+        while (*name == ' ') {
+            name++;
+        }
+
+        while (*value == ' ') {
+            value++;
+        }
+
+        if (*name == LF || *value == LF) {
+            return;
+        }
+
+        p = name;
+
+        while (*name != ' ' && *name != LF) {
+            name++;
+        }
+
+        q = value;
+
+        while (*value != ' ' && *value != LF) {
+            value++;
+        }
+
+        len = name - p;
+
+        v = ngx_atoi(q, value - q);
+
+        if (v == NGX_ERROR) {
+            continue;
+        }
+
+        if (len == sizeof("ListenOverflows") - 1
+            && ngx_strncmp(p, "ListenOverflows", len) == 0)
+        {
+            bl->overflows = v;
+
+        } else if (len == sizeof("ListenDrops") - 1
+                   && ngx_strncmp(p, "ListenDrops", len) == 0)
+        {
+            bl->drops = v;
+        }
+    }
+}
+
+#endif
+
+
 u_char *
 ngx_accept_log_error(ngx_log_t *log, u_char *buf, size_t len)
 {
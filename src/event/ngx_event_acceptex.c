@@ -126,6 +126,8 @@ ngx_event_post_acceptex(ngx_listening_t *ls, ngx_uint_t n)
             return NGX_ERROR;
         }
 
+        ngx_pool_set_type(c->pool, NGX_POOL_CONNECTION);
+
         log = ngx_palloc(c->pool, sizeof(ngx_log_t));
         if (log == NULL) {
             ngx_close_posted_connection(c);
@@ -12,6 +12,7 @@
 
 ngx_queue_t  ngx_posted_accept_events;
 ngx_queue_t  ngx_posted_events;
+ngx_queue_t  ngx_posted_next_events;
 
 
 void
@@ -33,3 +34,39 @@ ngx_event_process_posted(ngx_cycle_t *cycle, ngx_queue_t *posted)
         ev->handler(ev);
     }
 }
+
+
+void
+ngx_event_move_posted_next(ngx_cycle_t *cycle)
+{
+    ngx_queue_t  *q, *queue;
+    ngx_event_t  *ev;
+
+    while (!ngx_queue_empty(&ngx_posted_next_events)) {
+
+        q = ngx_queue_head(&ngx_posted_next_events);
+        ev = ngx_queue_data(q, ngx_event_t, queue);
+
+        ngx_log_debug1(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                      "posted next event %p", ev);
+
+        ngx_delete_posted_event(ev);
+
+        if (ev->accept && ngx_use_accept_mutex && !ngx_accept_mutex_held) {
+
+            /*
+             * the accept mutex has been lost since the accept was
+             * deferred; the listening socket is level-triggered,
+             * so the worker holding the mutex accepts the rest
+             */
+
+            continue;
+        }
+
+        ev->ready = 1;
+
+        queue = ev->accept ? &ngx_posted_accept_events : &ngx_posted_events;
+
+        ngx_post_event(ev, queue);
+    }
+}
@@ -13,6 +13,14 @@
 ngx_rbtree_t              ngx_event_timer_rbtree;
 static ngx_rbtree_node_t  ngx_event_timer_sentinel;
 
+ngx_timer_wheel_t        *ngx_event_timer_wheel;
+
+
+static ngx_msec_t ngx_event_find_timer_wheel(void);
+static void ngx_event_expire_timers_wheel(void);
+static void ngx_event_cancel_timers_wheel(void);
+
+
 /*
  * the event timer rbtree may contain the duplicate keys, however,
  * it should not be a problem, because we use the rbtree to find
@@ -22,9 +30,24 @@ static ngx_rbtree_node_t  ngx_event_timer_sentinel;
 ngx_int_t
 ngx_event_timer_init(ngx_log_t *log)
 {
+    ngx_event_conf_t  *ecf;
+
     ngx_rbtree_init(&ngx_event_timer_rbtree, &ngx_event_timer_sentinel,
                     ngx_rbtree_insert_timer_value);
 
+    ecf = ngx_event_get_conf(ngx_cycle->conf_ctx, ngx_event_core_module);
+
+    if (!ecf->timer_wheel) {
+        return NGX_OK;
+    }
+
+    ngx_event_timer_wheel = ngx_alloc(sizeof(ngx_timer_wheel_t), log);
+    if (ngx_event_timer_wheel == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_timer_wheel_init(ngx_event_timer_wheel, ngx_current_msec);
+
     return NGX_OK;
 }
 
@@ -35,6 +58,10 @@ ngx_event_find_timer(void)
     ngx_msec_int_t      timer;
     ngx_rbtree_node_t  *node, *root, *sentinel;
 
+    if (ngx_event_timer_wheel) {
+        return ngx_event_find_timer_wheel();
+    }
+
     if (ngx_event_timer_rbtree.root == &ngx_event_timer_sentinel) {
         return NGX_TIMER_INFINITE;
     }
@@ -56,6 +83,11 @@ ngx_event_expire_timers(void)
     ngx_event_t        *ev;
     ngx_rbtree_node_t  *node, *root, *sentinel;
 
+    if (ngx_event_timer_wheel) {
+        ngx_event_expire_timers_wheel();
+        return;
+    }
+
     sentinel = ngx_event_timer_rbtree.sentinel;
 
     for ( ;; ) {
@@ -102,6 +134,11 @@ ngx_event_cancel_timers(void)
     ngx_event_t        *ev;
     ngx_rbtree_node_t  *node, *root, *sentinel;
 
+    if (ngx_event_timer_wheel) {
+        ngx_event_cancel_timers_wheel();
+        return;
+    }
+
     sentinel = ngx_event_timer_rbtree.sentinel;
 
     for ( ;; ) {
@@ -136,3 +173,121 @@ ngx_event_cancel_timers(void)
         ev->handler(ev);
     }
 }
+
+
+ngx_int_t
+ngx_event_no_timers_left(void)
+{
+    if (ngx_event_timer_wheel) {
+        return ngx_timer_wheel_empty(ngx_event_timer_wheel) ? NGX_OK
+                                                            : NGX_AGAIN;
+    }
+
+    if (ngx_event_timer_rbtree.root == ngx_event_timer_rbtree.sentinel) {
+        return NGX_OK;
+    }
+
+    return NGX_AGAIN;
+}
+
+
+/*
+ * The timer wheel finds the nearest timer exactly if it expires within
+ * 256 milliseconds, and otherwise the time when the wheel has to move
+ * the timers of the nearest slot of a higher level, which is not later
+ * than any of them; then nothing is expired, and the next call is exact.
+ */
+
+static ngx_msec_t
+ngx_event_find_timer_wheel(void)
+{
+    ngx_msec_int_t  timer;
+
+    if (ngx_timer_wheel_empty(ngx_event_timer_wheel)) {
+        return NGX_TIMER_INFINITE;
+    }
+
+    timer = (ngx_msec_int_t) (ngx_timer_wheel_min(ngx_event_timer_wheel)
+                              - ngx_current_msec);
+
+    return (ngx_msec_t) (timer > 0 ? timer : 0);
+}
+
+
+static void
+ngx_event_expire_timers_wheel(void)
+{
+    ngx_event_t        *ev;
+    ngx_rbtree_node_t  *node;
+
+    for ( ;; ) {
+        node = ngx_timer_wheel_expired(ngx_event_timer_wheel,
+                                       ngx_current_msec);
+        if (node == NULL) {
+            return;
+        }
+
+        ev = (ngx_event_t *) ((char *) node - offsetof(ngx_event_t, timer));
+
+        ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                       "event timer del: %d: %M",
+                       ngx_event_ident(ev->data), ev->timer.key);
+
+        ngx_timer_wheel_delete(ngx_event_timer_wheel, &ev->timer);
+
+#if (NGX_DEBUG)
+        ev->timer.left = NULL;
+        ev->timer.right = NULL;
+        ev->timer.parent = NULL;
+#endif
+
+        ev->timer_set = 0;
+
+        ev->timedout = 1;
+
+        ev->handler(ev);
+    }
+}
+
+
+/*
+ * the wheel is not ordered, so all cancelable timers are cancelled,
+ * while the rbtree stops at the first timer that is not cancelable;
+ * a handler may add or delete other timers, so the walk starts over
+ */
+
+static void
+ngx_event_cancel_timers_wheel(void)
+{
+    ngx_event_t        *ev;
+    ngx_rbtree_node_t  *node;
+
+    node = ngx_timer_wheel_next(ngx_event_timer_wheel, NULL);
+
+    while (node) {
+        ev = (ngx_event_t *) ((char *) node - offsetof(ngx_event_t, timer));
+
+        if (!ev->cancelable) {
+            node = ngx_timer_wheel_next(ngx_event_timer_wheel, node);
+            continue;
+        }
+
+        ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                       "event timer cancel: %d: %M",
+                       ngx_event_ident(ev->data), ev->timer.key);
+
+        ngx_timer_wheel_delete(ngx_event_timer_wheel, &ev->timer);
+
+#if (NGX_DEBUG)
+        ev->timer.left = NULL;
+        ev->timer.right = NULL;
+        ev->timer.parent = NULL;
+#endif
+
+        ev->timer_set = 0;
+
+        ev->handler(ev);
+
+        node = ngx_timer_wheel_next(ngx_event_timer_wheel, NULL);
+    }
+}
@@ -0,0 +1,248 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+
+
+static ngx_int_t ngx_http_pool_stats_handler(ngx_http_request_t *r);
+static int ngx_libc_cdecl ngx_http_pool_stats_cmp_sites(const void *one,
+    const void *two);
+static char *ngx_http_pool_stats(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+
+
+static ngx_str_t  ngx_http_pool_stats_types[] = {
+    ngx_string("temp"),
+    ngx_string("connection"),
+    ngx_string("request"),
+    ngx_string("config")
+};
+
+
+static ngx_command_t  ngx_http_pool_stats_commands[] = {
+
+    { ngx_string("pool_stats"),
+      NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_NOARGS,
+      ngx_http_pool_stats,
+      0,
+      0,
+      NULL },
+
+      ngx_null_command
+};
+
+
+static ngx_http_module_t  ngx_http_pool_stats_module_ctx = {
+    NULL,                                  /* preconfiguration */
+    NULL,                                  /* postconfiguration */
+
+    NULL,                                  /* create main configuration */
+    NULL,                                  /* init main configuration */
+
+    NULL,                                  /* create server configuration */
+    NULL,                                  /* merge server configuration */
+
+    NULL,                                  /* create location configuration */
+    NULL                                   /* merge location configuration */
+};
+
+
+ngx_module_t  ngx_http_pool_stats_module = {
+    NGX_MODULE_V1,
+    &ngx_http_pool_stats_module_ctx,       /* module context */
+    ngx_http_pool_stats_commands,          /* module directives */
+    NGX_HTTP_MODULE,                       /* module type */
+    NULL,                                  /* init master */
+    NULL,                                  /* init module */
+    NULL,                                  /* init process */
+    NULL,                                  /* init thread */
+    NULL,                                  /* exit thread */
+    NULL,                                  /* exit process */
+    NULL,                                  /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+/*
+ * The report is of the worker that serves the request: the totals of each
+ * pool type, and then the call sites with the most bytes allocated first,
+ * a line for every pool type a site allocated from.
+ */
+
+static ngx_int_t
+ngx_http_pool_stats_handler(ngx_http_request_t *r)
+{
+    size_t                 size;
+    ngx_int_t              rc;
+    ngx_buf_t             *b;
+    ngx_uint_t             i, n, t;
+    ngx_chain_t            out;
+    ngx_pool_stat_t       *st;
+    ngx_pool_site_t       *site, **sites;
+    ngx_pool_type_stat_t  *ts;
+
+    if (r->method != NGX_HTTP_GET && r->method != NGX_HTTP_HEAD) {
+        return NGX_HTTP_NOT_ALLOWED;
+    }
+
+    rc = ngx_http_discard_request_body(r);
+
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    r->headers_out.content_type_len = sizeof("text/plain") - 1;
+    ngx_str_set(&r->headers_out.content_type, "text/plain");
+    r->headers_out.content_type_lowcase = NULL;
+
+    if (r->method == NGX_HTTP_HEAD) {
+        r->headers_out.status = NGX_HTTP_OK;
+
+        rc = ngx_http_send_header(r);
+
+        if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
+            return rc;
+        }
+    }
+
+    /*
+     * the sites are collected first, as the allocations below
+     * may add sites of their own
+     */
+
+    sites = ngx_palloc(r->pool,
+                       NGX_POOL_STATS_SITES * sizeof(ngx_pool_site_t *));
+    if (sites == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    n = 0;
+    size = 0;
+
+    for (i = 0; i < NGX_POOL_STATS_SITES; i++) {
+        site = &ngx_pool_stats.sites[i];
+
+        if (site->file == NULL) {
+            continue;
+        }
+
+        /*
+         * the file is printed on the line of every pool type,
+         * and the allocations below may add to any of them
+         */
+
+        sites[n++] = site;
+        size += NGX_POOL_TYPES * ngx_strlen(site->file);
+    }
+
+    ngx_qsort(sites, n, sizeof(ngx_pool_site_t *),
+              ngx_http_pool_stats_cmp_sites);
+
+    size += sizeof("pid: \n") + NGX_INT_T_LEN
+            + sizeof("type pools blocks calls bytes large\n") - 1
+            + NGX_POOL_TYPES * (sizeof("connection     \n")
+                                + 5 * NGX_INT64_LEN)
+            + sizeof("sites:  dropped: \n") + 2 * NGX_INT_T_LEN
+            + sizeof("type calls bytes large site\n") - 1
+            + n * NGX_POOL_TYPES * (sizeof("connection    :\n")
+                                    + 4 * NGX_INT64_LEN);
+
+    b = ngx_create_temp_buf(r->pool, size);
+    if (b == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    out.buf = b;
+    out.next = NULL;
+
+    b->last = ngx_sprintf(b->last, "pid: %P\n", ngx_pid);
+
+    b->last = ngx_cpymem(b->last, "type pools blocks calls bytes large\n",
+                         sizeof("type pools blocks calls bytes large\n") - 1);
+
+    for (t = 0; t < NGX_POOL_TYPES; t++) {
+        ts = &ngx_pool_stats.types[t];
+
+        b->last = ngx_sprintf(b->last, "%V %ui %ui %ui %uL %ui\n",
+                              &ngx_http_pool_stats_types[t],
+                              ts->pools, ts->blocks, ts->total.calls,
+                              ts->total.bytes, ts->total.large);
+    }
+
+    b->last = ngx_sprintf(b->last, "sites: %ui dropped: %ui\n",
+                          n, ngx_pool_stats.dropped);
+
+    b->last = ngx_cpymem(b->last, "type calls bytes large site\n",
+                         sizeof("type calls bytes large site\n") - 1);
+
+    for (i = 0; i < n; i++) {
+        for (t = 0; t < NGX_POOL_TYPES; t++) {
+            st = &sites[i]->stat[t];
+
+            if (st->calls == 0) {
+                continue;
+            }
+
+            b->last = ngx_sprintf(b->last, "%V %ui %uL %ui %s:%ui\n",
+                                  &ngx_http_pool_stats_types[t],
+                                  st->calls, st->bytes, st->large,
+                                  sites[i]->file, sites[i]->line);
+        }
+    }
+
+    r->headers_out.status = NGX_HTTP_OK;
+    r->headers_out.content_length_n = b->last - b->pos;
+
+    b->last_buf = (r == r->main) ? 1 : 0;
+    b->last_in_chain = 1;
+
+    rc = ngx_http_send_header(r);
+
+    if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
+        return rc;
+    }
+
+    return ngx_http_output_filter(r, &out);
+}
+
+
+static int ngx_libc_cdecl
+ngx_http_pool_stats_cmp_sites(const void *one, const void *two)
+{
+    ngx_pool_site_t  *first = *(ngx_pool_site_t **) one;
+    ngx_pool_site_t  *second = *(ngx_pool_site_t **) two;
+
+    uint64_t    b1, b2;
+    ngx_uint_t  t;
+
+    b1 = 0;
+    b2 = 0;
+
+    for (t = 0; t < NGX_POOL_TYPES; t++) {
+        b1 += first->stat[t].bytes;
+        b2 += second->stat[t].bytes;
+    }
+
+    if (b1 == b2) {
+        return 0;
+    }
+
+    return (b1 < b2) ? 1 : -1;
+}
+
+
+static char *
+ngx_http_pool_stats(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_core_loc_conf_t  *clcf;
+
+    clcf = ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module);
+    clcf->handler = ngx_http_pool_stats_handler;
+
+    return NGX_CONF_OK;
+}
@@ -0,0 +1,236 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+
+
+static ngx_int_t ngx_http_slab_status_handler(ngx_http_request_t *r);
+static u_char *ngx_http_slab_status_zone(u_char *p, ngx_shm_zone_t *zone);
+static char *ngx_http_slab_status(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+
+
+static ngx_command_t  ngx_http_slab_status_commands[] = {
+
+    { ngx_string("slab_status"),
+      NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_NOARGS,
+      ngx_http_slab_status,
+      0,
+      0,
+      NULL },
+
+      ngx_null_command
+};
+
+
+static ngx_http_module_t  ngx_http_slab_status_module_ctx = {
+    NULL,                                  /* preconfiguration */
+    NULL,                                  /* postconfiguration */
+
+    NULL,                                  /* create main configuration */
+    NULL,                                  /* init main configuration */
+
+    NULL,                                  /* create server configuration */
+    NULL,                                  /* merge server configuration */
+
+    NULL,                                  /* create location configuration */
+    NULL                                   /* merge location configuration */
+};
+
+
+ngx_module_t  ngx_http_slab_status_module = {
+    NGX_MODULE_V1,
+    &ngx_http_slab_status_module_ctx,      /* module context */
+    ngx_http_slab_status_commands,         /* module directives */
+    NGX_HTTP_MODULE,                       /* module type */
+    NULL,                                  /* init master */
+    NULL,                                  /* init module */
+    NULL,                                  /* init process */
+    NULL,                                  /* init thread */
+    NULL,                                  /* exit thread */
+    NULL,                                  /* exit process */
+    NULL,                                  /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+#define NGX_HTTP_SLAB_STATUS_ZONE_LEN                                         \
+    (sizeof(": size  pages  free  largest  fails \n") + 5 * NGX_INT_T_LEN)
+
+#define NGX_HTTP_SLAB_STATUS_SLOT_LEN                                         \
+    (sizeof(": slot  total  used  free  reqs  fails \n") + 6 * NGX_INT_T_LEN)
+
+
+static ngx_int_t
+ngx_http_slab_status_handler(ngx_http_request_t *r)
+{
+    size_t            size;
+    ngx_int_t         rc;
+    ngx_buf_t        *b;
+    ngx_uint_t        i, slots;
+    ngx_chain_t       out;
+    ngx_list_part_t  *part;
+    ngx_shm_zone_t   *zone;
+
+    if (r->method != NGX_HTTP_GET && r->method != NGX_HTTP_HEAD) {
+        return NGX_HTTP_NOT_ALLOWED;
+    }
+
+    rc = ngx_http_discard_request_body(r);
+
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    r->headers_out.content_type_len = sizeof("text/plain") - 1;
+    ngx_str_set(&r->headers_out.content_type, "text/plain");
+    r->headers_out.content_type_lowcase = NULL;
+
+    if (r->method == NGX_HTTP_HEAD) {
+        r->headers_out.status = NGX_HTTP_OK;
+
+        rc = ngx_http_send_header(r);
+
+        if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
+            return rc;
+        }
+    }
+
+    size = 0;
+
+    part = (ngx_list_part_t *) &ngx_cycle->shared_memory.part;
+    zone = part->elts;
+
+    for (i = 0; /* void */ ; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            zone = part->elts;
+            i = 0;
+        }
+
+        slots = ngx_pagesize_shift
+                - ((ngx_slab_pool_t *) zone[i].shm.addr)->min_shift;
+
+        size += (slots + 1) * zone[i].shm.name.len
+                + NGX_HTTP_SLAB_STATUS_ZONE_LEN
+                + slots * NGX_HTTP_SLAB_STATUS_SLOT_LEN;
+    }
+
+    if (size == 0) {
+
+        /* no shared zones, an empty buffer would upset the writer */
+
+        r->headers_out.status = NGX_HTTP_OK;
+        r->headers_out.content_length_n = 0;
+        r->header_only = 1;
+
+        return ngx_http_send_header(r);
+    }
+
+    b = ngx_create_temp_buf(r->pool, size);
+    if (b == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    out.buf = b;
+    out.next = NULL;
+
+    part = (ngx_list_part_t *) &ngx_cycle->shared_memory.part;
+    zone = part->elts;
+
+    for (i = 0; /* void */ ; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            zone = part->elts;
+            i = 0;
+        }
+
+        b->last = ngx_http_slab_status_zone(b->last, &zone[i]);
+    }
+
+    r->headers_out.status = NGX_HTTP_OK;
+    r->headers_out.content_length_n = b->last - b->pos;
+
+    b->last_buf = (r == r->main) ? 1 : 0;
+    b->last_in_chain = 1;
+
+    rc = ngx_http_send_header(r);
+
+    if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
+        return rc;
+    }
+
+    return ngx_http_output_filter(r, &out);
+}
+
+
+/*
+ * A zone is reported as a line of its pages and a line for every size
+ * class that has been requested.  The chunks kept in magazines of workers
+ * are counted as used.
+ */
+
+static u_char *
+ngx_http_slab_status_zone(u_char *p, ngx_shm_zone_t *zone)
+{
+    ngx_uint_t        i, n;
+    ngx_slab_stat_t  *stat;
+    ngx_slab_pool_t  *pool;
+
+    pool = (ngx_slab_pool_t *) zone->shm.addr;
+
+    n = ngx_pagesize_shift - pool->min_shift;
+
+    ngx_shmtx_lock(&pool->mutex);
+
+    p = ngx_sprintf(p, "%V: size %uz pages %ui free %ui largest %ui "
+                    "fails %ui\n",
+                    &zone->shm.name, zone->shm.size,
+                    (ngx_uint_t) (pool->last - pool->pages), pool->pfree,
+                    ngx_slab_largest_free_locked(pool), pool->pfails);
+
+    for (i = 0; i < n; i++) {
+        stat = &pool->stats[i];
+
+        if (stat->reqs == 0) {
+            continue;
+        }
+
+        p = ngx_sprintf(p, "%V: slot %uz total %ui used %ui free %ui "
+                        "reqs %ui fails %ui\n",
+                        &zone->shm.name, (size_t) 1 << (pool->min_shift + i),
+                        stat->total, stat->used, stat->total - stat->used,
+                        stat->reqs, stat->fails);
+    }
+
+    ngx_shmtx_unlock(&pool->mutex);
+
+    return p;
+}
+
+
+static char *
+ngx_http_slab_status(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_core_loc_conf_t  *clcf;
+
+    clcf = ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module);
+    clcf->handler = ngx_http_slab_status_handler;
+
+    return NGX_CONF_OK;
+}
@@ -76,6 +76,30 @@ static ngx_http_variable_t  ngx_http_stub_status_vars[] = {
     { ngx_string("connections_waiting"), NULL, ngx_http_stub_status_variable,
       3, NGX_HTTP_VAR_NOCACHEABLE, 0 },
 
+    { ngx_string("pool_cache_hits"), NULL, ngx_http_stub_status_variable,
+      4, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("pool_cache_misses"), NULL, ngx_http_stub_status_variable,
+      5, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("accept_wakeups"), NULL, ngx_http_stub_status_variable,
+      6, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("accept_exhausted"), NULL, ngx_http_stub_status_variable,
+      7, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("listen_queue"), NULL, ngx_http_stub_status_variable,
+      8, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("listen_backlog"), NULL, ngx_http_stub_status_variable,
+      9, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("listen_overflows"), NULL, ngx_http_stub_status_variable,
+      10, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
+    { ngx_string("listen_drops"), NULL, ngx_http_stub_status_variable,
+      11, NGX_HTTP_VAR_NOCACHEABLE, 0 },
+
     { ngx_null_string, NULL, NULL, 0, 0, 0 }
 };
 
@@ -164,8 +188,10 @@ static ngx_int_t
 ngx_http_stub_status_variable(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data)
 {
-    u_char            *p;
-    ngx_atomic_int_t   value;
+    u_char                *p;
+    ngx_uint_t             hits, misses;
+    ngx_atomic_int_t       value;
+    ngx_accept_backlog_t   bl;
 
     p = ngx_pnalloc(r->pool, NGX_ATOMIC_T_LEN);
     if (p == NULL) {
@@ -189,6 +215,48 @@ ngx_http_stub_status_variable(ngx_http_request_t *r,
         value = *ngx_stat_waiting;
         break;
 
+    /* the pool block cache of this worker */
+
+    case 4:
+        ngx_pool_cache_counters(&hits, &misses);
+        value = hits;
+        break;
+
+    case 5:
+        ngx_pool_cache_counters(&hits, &misses);
+        value = misses;
+        break;
+
+    case 6:
+        value = *ngx_stat_wakeups;
+        break;
+
+    case 7:
+        value = *ngx_stat_exhausted;
+        break;
+
+    /* the listening sockets of the cycle */
+
+    case 8:
+        ngx_event_accept_backlog((ngx_cycle_t *) ngx_cycle, &bl);
+        value = bl.queue;
+        break;
+
+    case 9:
+        ngx_event_accept_backlog((ngx_cycle_t *) ngx_cycle, &bl);
+        value = bl.backlog;
+        break;
+
+    case 10:
+        ngx_event_accept_backlog((ngx_cycle_t *) ngx_cycle, &bl);
+        value = bl.overflows;
+        break;
+
+    case 11:
+        ngx_event_accept_backlog((ngx_cycle_t *) ngx_cycle, &bl);
+        value = bl.drops;
+        break;
+
     /* suppress warning */
     default:
         value = 0;
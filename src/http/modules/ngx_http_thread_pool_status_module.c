@@ -0,0 +1,185 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+#include <ngx_thread_pool.h>
+
+
+static ngx_int_t ngx_http_thread_pool_status_handler(ngx_http_request_t *r);
+static u_char *ngx_http_thread_pool_status_pool(u_char *p,
+    ngx_thread_pool_stat_t *st);
+static char *ngx_http_thread_pool_status(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+
+
+static ngx_command_t  ngx_http_thread_pool_status_commands[] = {
+
+    { ngx_string("thread_pool_status"),
+      NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_NOARGS,
+      ngx_http_thread_pool_status,
+      0,
+      0,
+      NULL },
+
+      ngx_null_command
+};
+
+
+static ngx_http_module_t  ngx_http_thread_pool_status_module_ctx = {
+    NULL,                                  /* preconfiguration */
+    NULL,                                  /* postconfiguration */
+
+    NULL,                                  /* create main configuration */
+    NULL,                                  /* init main configuration */
+
+    NULL,                                  /* create server configuration */
+    NULL,                                  /* merge server configuration */
+
+    NULL,                                  /* create location configuration */
+    NULL                                   /* merge location configuration */
+};
+
+
+ngx_module_t  ngx_http_thread_pool_status_module = {
+    NGX_MODULE_V1,
+    &ngx_http_thread_pool_status_module_ctx, /* module context */
+    ngx_http_thread_pool_status_commands,  /* module directives */
+    NGX_HTTP_MODULE,                       /* module type */
+    NULL,                                  /* init master */
+    NULL,                                  /* init module */
+    NULL,                                  /* init process */
+    NULL,                                  /* init thread */
+    NULL,                                  /* exit thread */
+    NULL,                                  /* exit process */
+    NULL,                                  /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+#define NGX_HTTP_THREAD_POOL_STATUS_LEN                                       \
+    (sizeof(": threads  max_queue  queue  peak  tasks  wait  service\n")      \
+     + 5 * NGX_INT_T_LEN + 2 * NGX_INT64_LEN)
+
+
+/*
+ * The thread pools are run by every worker, so the statistics
+ * are those of the worker that serves the request.
+ */
+
+static ngx_int_t
+ngx_http_thread_pool_status_handler(ngx_http_request_t *r)
+{
+    size_t                   size;
+    ngx_int_t                rc;
+    ngx_buf_t               *b;
+    ngx_uint_t               i;
+    ngx_chain_t              out;
+    ngx_thread_pool_stat_t   st;
+
+    if (r->method != NGX_HTTP_GET && r->method != NGX_HTTP_HEAD) {
+        return NGX_HTTP_NOT_ALLOWED;
+    }
+
+    rc = ngx_http_discard_request_body(r);
+
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    r->headers_out.content_type_len = sizeof("text/plain") - 1;
+    ngx_str_set(&r->headers_out.content_type, "text/plain");
+    r->headers_out.content_type_lowcase = NULL;
+
+    if (r->method == NGX_HTTP_HEAD) {
+        r->headers_out.status = NGX_HTTP_OK;
+
+        rc = ngx_http_send_header(r);
+
+        if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
+            return rc;
+        }
+    }
+
+    size = 0;
+
+    for (i = 0; ngx_thread_pool_stat((ngx_cycle_t *) ngx_cycle, i, &st)
+                == NGX_OK;
+         i++)
+    {
+        size += st.name->len + NGX_HTTP_THREAD_POOL_STATUS_LEN;
+    }
+
+    if (size == 0) {
+
+        /* no thread pools, an empty buffer would upset the writer */
+
+        r->headers_out.status = NGX_HTTP_OK;
+        r->headers_out.content_length_n = 0;
+        r->header_only = 1;
+
+        return ngx_http_send_header(r);
+    }
+
+    b = ngx_create_temp_buf(r->pool, size);
+    if (b == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    out.buf = b;
+    out.next = NULL;
+
+    for (i = 0; ngx_thread_pool_stat((ngx_cycle_t *) ngx_cycle, i, &st)
+                == NGX_OK;
+         i++)
+    {
+        b->last = ngx_http_thread_pool_status_pool(b->last, &st);
+    }
+
+    r->headers_out.status = NGX_HTTP_OK;
+    r->headers_out.content_length_n = b->last - b->pos;
+
+    b->last_buf = (r == r->main) ? 1 : 0;
+    b->last_in_chain = 1;
+
+    rc = ngx_http_send_header(r);
+
+    if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
+        return rc;
+    }
+
+    return ngx_http_output_filter(r, &out);
+}
+
+
+/* the wait and service times are the mean ones in microseconds */
+
+static u_char *
+ngx_http_thread_pool_status_pool(u_char *p, ngx_thread_pool_stat_t *st)
+{
+    uint64_t  wait, service;
+
+    wait = st->tasks ? st->wait / st->tasks : 0;
+    service = st->tasks ? st->service / st->tasks : 0;
+
+    return ngx_sprintf(p, "%V: threads %ui max_queue %i queue %ui peak %ui "
+                       "tasks %ui wait %uL service %uL\n",
+                       st->name, st->threads, st->max_queue, st->queue,
+                       st->peak, st->tasks, wait, service);
+}
+
+
+static char *
+ngx_http_thread_pool_status(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_core_loc_conf_t  *clcf;
+
+    clcf = ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module);
+    clcf->handler = ngx_http_thread_pool_status_handler;
+
+    return NGX_CONF_OK;
+}
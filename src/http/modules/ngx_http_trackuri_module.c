@@ -9,26 +9,116 @@
 #include <ngx_http.h>
 #include <ngx_http_uri_hash_table.h>
 
+// popular_uri_snapshot of a zone, or of the private tables of a location
+typedef struct {
+    ngx_str_t        path;
+    ngx_msec_t       interval;
+    ngx_shm_zone_t  *shm_zone;
+    ngx_uri_table   *uri_table;
+    u_char          *file;      // null terminated, per worker if private
+    ngx_event_t      event;
+    ngx_flag_t       reloaded;  // the old cycle still counts into it
+} ngx_http_trackuri_snapshot_t;
+
+typedef struct {
+    ngx_array_t      snapshots;  // of ngx_http_trackuri_snapshot_t *
+} ngx_http_trackuri_main_conf_t;
+
+// shared popular_uri_zone
+typedef struct {
+    ngx_uri_table   *uri_table;
+    ngx_slab_pool_t *shpool;
+    ngx_uint_t       engine;
+    ngx_uint_t       top;
+    ngx_uri_recency  recency;
+    ngx_uint_t       metrics;
+    ngx_http_trackuri_snapshot_t *snapshot;
+} ngx_http_trackuri_ctx_t;
+
 // trackuri directives
 typedef struct {
-    ngx_flag_t    track_uri;
-    ngx_flag_t    return_uri_stats;
-    ngx_uri_table uri_table;
+    ngx_flag_t      track_uri;
+    ngx_flag_t      return_uri_stats;
+    ngx_flag_t      log_uri;
+    ngx_uint_t      metrics;
+    ngx_uint_t      engine;
+    ngx_uint_t      top;
+    ngx_uri_recency recency;
+    ngx_shm_zone_t *shm_zone;
+    ngx_uri_table   uri_table;
+    ngx_uint_t      batch_size;
+    ngx_msec_t      batch_interval;
+    ngx_uri_batch   batch;
+    ngx_event_t     batch_event;
+    ngx_http_trackuri_snapshot_t *snapshot;
 } ngx_http_trackuri_loc_conf_t;
 
 // predefine functions
 static char *
 ngx_http_trackuri_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child);
+static char *
+ngx_http_trackuri_add_snapshot(ngx_conf_t *cf,
+    ngx_http_trackuri_snapshot_t *snapshot);
 //static void
 //ngx_http_trackuri_cleanup(void *data);
 static ngx_int_t
 ngx_http_trackuri_handler(ngx_http_request_t *r);
+static ngx_int_t
+ngx_http_trackuri_log_handler(ngx_http_request_t *r);
+static ngx_int_t
+ngx_http_trackuri_init(ngx_conf_t *cf);
+static char *
+ngx_http_trackuri_log(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
 static char *
 ngx_http_trackuri(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
 static void *
 ngx_http_trackuri_create_loc_conf(ngx_conf_t *cf);
 static char *
 ngx_http_return_uristats(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
+static char *
+ngx_http_trackuri_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
+static ngx_int_t
+ngx_http_trackuri_init_zone(ngx_shm_zone_t *shm_zone, void *data);
+static char *
+ngx_http_trackuri_batch(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
+static char *
+ngx_http_trackuri_window(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
+static ngx_int_t
+ngx_http_trackuri_args(ngx_http_request_t *r, ngx_uri_report_args *args);
+static ngx_int_t
+ngx_http_trackuri_rank(ngx_http_request_t *r,
+    const ngx_uri_recency *recency, ngx_uint_t *rank);
+static void
+ngx_http_trackuri_flush(ngx_http_trackuri_loc_conf_t *flcf);
+static void
+ngx_http_trackuri_flush_handler(ngx_event_t *ev);
+static char *
+ngx_http_trackuri_snapshot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
+static void *
+ngx_http_trackuri_create_main_conf(ngx_conf_t *cf);
+static ngx_int_t
+ngx_http_trackuri_init_process(ngx_cycle_t *cycle);
+static void
+ngx_http_trackuri_exit_process(ngx_cycle_t *cycle);
+static void
+ngx_http_trackuri_snapshot_handler(ngx_event_t *ev);
+static void
+ngx_http_trackuri_save(ngx_http_trackuri_snapshot_t *snapshot,
+    ngx_log_t *log);
+static void
+ngx_http_trackuri_load(ngx_uri_table *uri_table, u_char *file,
+    ngx_log_t *log);
+
+static ngx_conf_enum_t  ngx_http_trackuri_engines[] = {
+    { ngx_string("lru"), NGX_URI_ENGINE_LRU },
+    { ngx_string("space_saving"), NGX_URI_ENGINE_SPACE_SAVING },
+    { ngx_string("count_min"), NGX_URI_ENGINE_COUNT_MIN },
+    { ngx_null_string, 0 }
+};
+
+static ngx_conf_num_bounds_t  ngx_http_trackuri_top_bounds = {
+    ngx_conf_check_num_bounds, 1, 100000
+};
 
 // trackuri directives
 static ngx_command_t  ngx_http_trackuri_commands[] = {
@@ -47,14 +137,70 @@ static ngx_command_t  ngx_http_trackuri_commands[] = {
       0,
       NULL },
 
+    { ngx_string("popular_uri_log"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_1MORE,
+      ngx_http_trackuri_log,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("popular_uri_engine"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_enum_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_trackuri_loc_conf_t, engine),
+      &ngx_http_trackuri_engines },
+
+    { ngx_string("popular_uri_top"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_trackuri_loc_conf_t, top),
+      &ngx_http_trackuri_top_bounds },
+
+    { ngx_string("popular_uri_window"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE123,
+      ngx_http_trackuri_window,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("popular_uri_decay"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_msec_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_trackuri_loc_conf_t, recency.half_life),
+      NULL },
+
+    { ngx_string("popular_uri_zone"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE2,
+      ngx_http_trackuri_zone,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("popular_uri_snapshot"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE12,
+      ngx_http_trackuri_snapshot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
+    { ngx_string("popular_uri_batch"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE12,
+      ngx_http_trackuri_batch,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
       ngx_null_command
 };
 
 static ngx_http_module_t  ngx_http_trackuri_module_ctx = {
     NULL,                                  /* preconfiguration */
-    NULL,                                  /* postconfiguration */
+    ngx_http_trackuri_init,                /* postconfiguration */
 
-    NULL,                                  /* create main configuration */
+    ngx_http_trackuri_create_main_conf,    /* create main configuration */
     NULL,                                  /* init main configuration */
 
     NULL,                                  /* create server configuration */
@@ -71,14 +217,63 @@ ngx_module_t  ngx_http_trackuri_module = {
     NGX_HTTP_MODULE,                       /* module type */
     NULL,                                  /* init master */
     NULL,                                  /* init module */
-    NULL,                                  /* init process */
+    ngx_http_trackuri_init_process,        /* init process */
     NULL,                                  /* init thread */
     NULL,                                  /* exit thread */
-    NULL,                                  /* exit process */
+    ngx_http_trackuri_exit_process,        /* exit process */
     NULL,                                  /* exit master */
     NGX_MODULE_V1_PADDING
 };
 
+static char *
+ngx_http_trackuri_add_snapshot(ngx_conf_t *cf,
+    ngx_http_trackuri_snapshot_t *snapshot)
+{
+    ngx_uint_t                      i;
+    ngx_http_trackuri_main_conf_t  *tmcf;
+    ngx_http_trackuri_snapshot_t  **s;
+
+    if (snapshot->shm_zone || snapshot->uri_table) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "popular_uri_snapshot \"%V\" is already used "
+                           "by another table", &snapshot->path);
+        return NGX_CONF_ERROR;
+    }
+
+    // on a reload the file on disk is older than the counts the workers
+    // of the old cycle still hold, it is not loaded over them
+    if (!ngx_is_init_cycle(cf->cycle->old_cycle)) {
+        tmcf = ngx_http_cycle_get_module_main_conf(cf->cycle->old_cycle,
+                                                   ngx_http_trackuri_module);
+
+        if (tmcf) {
+            s = tmcf->snapshots.elts;
+
+            for (i = 0; i < tmcf->snapshots.nelts; i++) {
+                if (s[i]->path.len == snapshot->path.len
+                    && ngx_strncmp(s[i]->path.data, snapshot->path.data,
+                                   snapshot->path.len)
+                       == 0)
+                {
+                    snapshot->reloaded = 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    tmcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_trackuri_module);
+
+    s = ngx_array_push(&tmcf->snapshots);
+    if (s == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    *s = snapshot;
+
+    return NGX_CONF_OK;
+}
+
 static char *
 ngx_http_trackuri_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
 {
@@ -87,37 +282,460 @@ ngx_http_trackuri_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
 
     ngx_conf_merge_value(conf->track_uri, prev->track_uri, 0);
     ngx_conf_merge_value(conf->return_uri_stats, prev->return_uri_stats, 0);
+    if (conf->log_uri == NGX_CONF_UNSET) {
+        conf->log_uri = prev->log_uri == NGX_CONF_UNSET ? 0 : prev->log_uri;
+        conf->metrics = prev->log_uri == NGX_CONF_UNSET ? 0 : prev->metrics;
+    }
+    ngx_conf_merge_uint_value(conf->engine, prev->engine,
+                              NGX_URI_ENGINE_LRU);
+    ngx_conf_merge_uint_value(conf->top, prev->top, 100);
+    ngx_conf_merge_msec_value(conf->recency.half_life,
+                              prev->recency.half_life, 0);
+
+    if (conf->recency.windows[0] == NGX_CONF_UNSET_MSEC) {
+        if (prev->recency.windows[0] == NGX_CONF_UNSET_MSEC) {
+            ngx_memzero(conf->recency.windows, sizeof(conf->recency.windows));
+        } else {
+            ngx_memcpy(conf->recency.windows, prev->recency.windows,
+                       sizeof(conf->recency.windows));
+        }
+    }
+    ngx_conf_merge_ptr_value(conf->shm_zone, prev->shm_zone, NULL);
+    ngx_conf_merge_ptr_value(conf->snapshot, prev->snapshot, NULL);
+    ngx_conf_merge_uint_value(conf->batch_size, prev->batch_size, 0);
+    ngx_conf_merge_msec_value(conf->batch_interval, prev->batch_interval,
+                              1000);
+
+    if (conf->track_uri != 1 && conf->log_uri != 1) {
+        if (conf->return_uri_stats == 1 && conf->shm_zone == NULL) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "popular_uri_stats requires popular_uri_track "
+                               "or a popular_uri_zone to report");
+            return NGX_CONF_ERROR;
+        }
+
+        return NGX_CONF_OK;
+    }
+
+    if ((conf->recency.windows[0] || conf->recency.half_life || conf->metrics)
+        && conf->engine != NGX_URI_ENGINE_LRU)
+    {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "popular_uri_window, popular_uri_decay and "
+                           "the metrics of popular_uri_log "
+                           "require \"popular_uri_engine lru\"");
+        return NGX_CONF_ERROR;
+    }
+
+    if (conf->log_uri == 1 && conf->shm_zone == NULL) {
+        // the location serves its own content, a stats location reads
+        // the counts from the zone
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "popular_uri_log requires popular_uri_zone");
+        return NGX_CONF_ERROR;
+    }
+
+    if (conf->metrics && conf->batch_size) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "popular_uri_batch cannot batch the metrics "
+                           "of popular_uri_log");
+        return NGX_CONF_ERROR;
+    }
+
+    if (conf->batch_size && conf->batch.slots == NULL) {
+        // every worker counts into its own copy of the batch
+        if (!ngx_uri_batch_init(cf->pool, &conf->batch, conf->batch_size))
+            return NGX_CONF_ERROR;
+
+        conf->batch_event.handler = ngx_http_trackuri_flush_handler;
+        conf->batch_event.data = conf;
+        conf->batch_event.log = cf->cycle->log;
+    }
+
+    if (conf->shm_zone) {
+        // the zone is created once all locations agreed on its layout
+        ngx_http_trackuri_ctx_t *ctx = conf->shm_zone->data;
+
+        if (ctx->engine == NGX_CONF_UNSET_UINT) {
+            ctx->engine = conf->engine;
+            ctx->top = conf->top;
+            ctx->recency = conf->recency;
+
+        } else if (ctx->engine != conf->engine || ctx->top != conf->top
+                   || ngx_memcmp(&ctx->recency, &conf->recency,
+                                 sizeof(ngx_uri_recency)) != 0)
+        {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "popular_uri_zone \"%V\" is already used "
+                               "with another popular_uri_engine, "
+                               "popular_uri_top, popular_uri_window "
+                               "or popular_uri_decay",
+                               &conf->shm_zone->shm.name);
+            return NGX_CONF_ERROR;
+        }
+
+        // locations without metrics count into the same entries
+        ctx->metrics |= conf->metrics;
+
+        if (conf->snapshot && ctx->snapshot == NULL) {
+            if (ngx_http_trackuri_add_snapshot(cf, conf->snapshot)
+                != NGX_CONF_OK)
+            {
+                return NGX_CONF_ERROR;
+            }
+
+            conf->snapshot->shm_zone = conf->shm_zone;
+            ctx->snapshot = conf->snapshot;
+
+        } else if (conf->snapshot && conf->snapshot != ctx->snapshot) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "popular_uri_zone \"%V\" already has "
+                               "a popular_uri_snapshot",
+                               &conf->shm_zone->shm.name);
+            return NGX_CONF_ERROR;
+        }
+
+    } else if (conf->uri_table.capacity == 0) {
+        // initialize a per-worker uri_table to start tracking popular uris
+        if (!ngx_uri_table_init(cf->log, conf->engine, conf->top,
+                                &conf->recency, 0, &conf->uri_table))
+            return NGX_CONF_ERROR;
+        ngx_conf_log_error(NGX_LOG_WARN, cf, 0,
+                           "Initialized uri table of capacity: \"%ui\"",
+                           conf->uri_table.capacity);
+
+        if (conf->snapshot) {
+            // the tables of every worker are restored by init_process
+            if (ngx_http_trackuri_add_snapshot(cf, conf->snapshot)
+                != NGX_CONF_OK)
+            {
+                return NGX_CONF_ERROR;
+            }
+
+            conf->snapshot->uri_table = &conf->uri_table;
+        }
+    }
 
     return NGX_CONF_OK;
 }
 
-static ngx_str_t  ngx_http_text_type = ngx_string("text/plain");
+static ngx_str_t  ngx_http_trackuri_types[] = {
+    ngx_string("text/plain"),
+    ngx_string("application/json"),
+    ngx_string("application/octet-stream")
+};
 //static ngx_str_t  popular_uri_stats = ngx_string("/images/1.jpg 100\n/images/2.jpg 45\n/test.html 200\n");
 
+// count a request into the table of its location
+static ngx_int_t
+ngx_http_trackuri_count(ngx_http_request_t *r,
+    ngx_http_trackuri_loc_conf_t *flcf, ngx_uri_sample *sample)
+{
+    ngx_http_trackuri_ctx_t       *ctx;
+    ngx_uri_table                 *uri_table;
+    ngx_int_t                      rc;
+    bool                           added;
+
+    if (flcf->batch_size) {
+        // the fast path: one hash and one increment in the local batch
+        rc = ngx_uri_batch_add(&flcf->batch, &r->uri);
+
+        if (rc == NGX_AGAIN) {
+            ngx_http_trackuri_flush(flcf);
+            rc = ngx_uri_batch_add(&flcf->batch, &r->uri);
+        }
+
+        if (rc != NGX_OK)
+            return NGX_ERROR;
+
+        if (!flcf->batch_event.timer_set) {
+            ngx_add_timer(&flcf->batch_event, flcf->batch_interval);
+        }
+
+        return NGX_OK;
+    }
+
+    if (flcf->shm_zone == NULL) {
+        added = ngx_uri_table_add(&flcf->uri_table, &r->uri, sample);
+        return added ? NGX_OK : NGX_ERROR;
+    }
+
+    ctx = flcf->shm_zone->data;
+    uri_table = ctx->uri_table;
+
+    ngx_shmtx_lock(&ctx->shpool->mutex);
+    added = ngx_uri_table_add(uri_table, &r->uri, sample);
+    ngx_shmtx_unlock(&ctx->shpool->mutex);
+
+    return added ? NGX_OK : NGX_ERROR;
+}
+
 static ngx_int_t
 ngx_http_trackuri_handler(ngx_http_request_t *r)
 {
+    ngx_int_t                      rc;
+    size_t                         size;
+    ngx_chain_t                   *out, *cl;
     ngx_http_trackuri_loc_conf_t  *flcf;
+    ngx_http_trackuri_ctx_t       *ctx;
+    ngx_uri_table                 *uri_table;
+    ngx_uri_report_args            args;
+    bool                           added;
+
     flcf = ngx_http_get_module_loc_conf(r, ngx_http_trackuri_module);
-    if (flcf->track_uri != 1)
-        return NGX_HTTP_NOT_ALLOWED;
 
-    if (!ngx_uri_table_add(&flcf->uri_table, &r->uri))
+    if (!(r->method & NGX_HTTP_GET) || flcf->return_uri_stats != 1) {
+        if (flcf->track_uri != 1)
+            return NGX_HTTP_NOT_ALLOWED;
+
+        if (ngx_http_trackuri_count(r, flcf, NULL) != NGX_OK)
+            return NGX_HTTP_INTERNAL_SERVER_ERROR;
+
+        return NGX_HTTP_CLOSE;
+    }
+
+    rc = ngx_http_discard_request_body(r);
+    if (rc != NGX_OK) {
+        return rc;
+    }
+
+    if (ngx_http_trackuri_args(r, &args) != NGX_OK) {
+        return NGX_HTTP_BAD_REQUEST;
+    }
+
+    ctx = NULL;
+    uri_table = &flcf->uri_table;
+
+    if (flcf->shm_zone) {
+        ctx = flcf->shm_zone->data;
+        uri_table = ctx->uri_table;
+        ngx_shmtx_lock(&ctx->shpool->mutex);
+    }
+
+    if (ngx_http_trackuri_rank(r, &uri_table->recency, &args.rank) != NGX_OK) {
+        if (ctx) {
+            ngx_shmtx_unlock(&ctx->shpool->mutex);
+        }
+
+        return NGX_HTTP_BAD_REQUEST;
+    }
+
+    added = true;
+    if (flcf->track_uri == 1) {
+        if (flcf->batch_size) {
+            // the report includes what this worker has not flushed yet
+            ngx_uri_batch_flush(&flcf->batch, uri_table);
+        }
+
+        added = ngx_uri_table_add(uri_table, &r->uri, NULL);
+    }
+
+    out = NULL;
+    if (added) {
+        // the report is copied into request pool buffers, so the zone
+        // can be unlocked before the response is sent
+        out = ngx_uri_table_report(uri_table, r->pool, &args, &size);
+    }
+
+    if (ctx) {
+        ngx_shmtx_unlock(&ctx->shpool->mutex);
+    }
+
+    if (out == NULL)
         return NGX_HTTP_INTERNAL_SERVER_ERROR;
 
-    // add top-n stats to response body.
-    if ((r->method & NGX_HTTP_GET) && flcf->return_uri_stats == 1) {
-        ngx_str_t report;
-        ngx_uri_table_report(&flcf->uri_table, &report);
-        ngx_http_complex_value_t  cv;
-        ngx_memzero(&cv, sizeof(ngx_http_complex_value_t));
-        cv.value.len  = report.len;
-        cv.value.data = report.data;
-        r->headers_out.last_modified_time = 23349600;
-        return ngx_http_send_response(r, NGX_HTTP_OK, &ngx_http_text_type, &cv);
+    r->headers_out.status = NGX_HTTP_OK;
+    r->headers_out.content_length_n = size;
+    r->headers_out.content_type = ngx_http_trackuri_types[args.format];
+    r->headers_out.content_type_len = r->headers_out.content_type.len;
+    r->headers_out.last_modified_time = 23349600;
+
+    if (size == 0) {
+        // nothing counted yet, an empty buffer would upset the writer
+        r->header_only = 1;
+    }
+
+    rc = ngx_http_send_header(r);
+
+    if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
+        return rc;
     }
 
-    return NGX_HTTP_CLOSE;
+    for (cl = out; cl->next; cl = cl->next) { /* void */ }
+    cl->buf->last_buf = (r == r->main) ? 1 : 0;
+
+    return ngx_http_output_filter(r, out);
+}
+
+// popular_uri_log: count the requests a location serves as usual
+static ngx_int_t
+ngx_http_trackuri_log_handler(ngx_http_request_t *r)
+{
+    ngx_http_trackuri_loc_conf_t  *flcf;
+    ngx_uri_sample                 sample, *s;
+    ngx_time_t                    *tp;
+    ngx_msec_int_t                 ms;
+
+    flcf = ngx_http_get_module_loc_conf(r, ngx_http_trackuri_module);
+    if (flcf->log_uri != 1) {
+        return NGX_OK;
+    }
+
+    s = NULL;
+
+    if (flcf->metrics) {
+        s = &sample;
+
+        sample.status = r->err_status ? r->err_status
+                                      : r->headers_out.status;
+        sample.bytes = r->connection->sent;
+
+        tp = ngx_timeofday();
+        ms = (ngx_msec_int_t)
+                 ((tp->sec - r->start_sec) * 1000 + (tp->msec - r->start_msec));
+        sample.msec = ngx_max(ms, 0);
+    }
+
+    // a failure only means the uri is not tracked
+    (void) ngx_http_trackuri_count(r, flcf, s);
+
+    return NGX_OK;
+}
+
+// ?format=text|json|binary&limit=n&offset=n&prefix=uri&rank=...
+static ngx_int_t
+ngx_http_trackuri_args(ngx_http_request_t *r, ngx_uri_report_args *args)
+{
+    u_char     *dst, *src;
+    ngx_str_t   value;
+    ngx_int_t   n;
+
+    args->format = NGX_URI_REPORT_TEXT;
+
+    if (ngx_http_arg(r, (u_char *) "format", 6, &value) == NGX_OK) {
+        if (value.len == 4 && ngx_strncmp(value.data, "json", 4) == 0) {
+            args->format = NGX_URI_REPORT_JSON;
+
+        } else if (value.len == 6
+                   && ngx_strncmp(value.data, "binary", 6) == 0)
+        {
+            args->format = NGX_URI_REPORT_BINARY;
+
+        } else if (value.len != 4
+                   || ngx_strncmp(value.data, "text", 4) != 0)
+        {
+            return NGX_DECLINED;
+        }
+    }
+
+    args->limit = NGX_MAX_UINT32_VALUE;
+
+    if (ngx_http_arg(r, (u_char *) "limit", 5, &value) == NGX_OK) {
+        n = ngx_atoi(value.data, value.len);
+        if (n == NGX_ERROR) {
+            return NGX_DECLINED;
+        }
+
+        args->limit = n;
+    }
+
+    args->offset = 0;
+
+    if (ngx_http_arg(r, (u_char *) "offset", 6, &value) == NGX_OK) {
+        n = ngx_atoi(value.data, value.len);
+        if (n == NGX_ERROR) {
+            return NGX_DECLINED;
+        }
+
+        args->offset = n;
+    }
+
+    ngx_str_null(&args->prefix);
+
+    if (ngx_http_arg(r, (u_char *) "prefix", 6, &value) == NGX_OK
+        && value.len)
+    {
+        // the uris are tracked unescaped and in lowercase
+        dst = ngx_pnalloc(r->pool, value.len);
+        if (dst == NULL) {
+            return NGX_ERROR;
+        }
+
+        src = value.data;
+        args->prefix.data = dst;
+        ngx_unescape_uri(&dst, &src, value.len, NGX_UNESCAPE_URI);
+        args->prefix.len = dst - args->prefix.data;
+        ngx_strlow(args->prefix.data, args->prefix.data, args->prefix.len);
+    }
+
+    return NGX_OK;
+}
+
+// ?rank=total, decay or the span of one of the windows, e.g. 5m; these are
+// the windows of the table itself, a location that only reads a zone may
+// be configured with others
+static ngx_int_t
+ngx_http_trackuri_rank(ngx_http_request_t *r,
+    const ngx_uri_recency *recency, ngx_uint_t *rank)
+{
+    ngx_str_t   value;
+    ngx_msec_t  span;
+    ngx_uint_t  w;
+
+    if (ngx_http_arg(r, (u_char *) "rank", 4, &value) != NGX_OK
+        || (value.len == 5 && ngx_strncmp(value.data, "total", 5) == 0))
+    {
+        *rank = NGX_URI_RANK_TOTAL;
+        return NGX_OK;
+    }
+
+    if (value.len == 5 && ngx_strncmp(value.data, "decay", 5) == 0) {
+        if (recency->half_life == 0) {
+            return NGX_DECLINED;
+        }
+
+        *rank = NGX_URI_RANK_DECAY;
+        return NGX_OK;
+    }
+
+    span = ngx_parse_time(&value, 0);
+    if (span == (ngx_msec_t) NGX_ERROR) {
+        return NGX_DECLINED;
+    }
+
+    for (w = 0; w < NGX_URI_WINDOWS && recency->windows[w]; w++) {
+        if (recency->windows[w] == span) {
+            *rank = NGX_URI_RANK_WINDOW + w;
+            return NGX_OK;
+        }
+    }
+
+    return NGX_DECLINED;
+}
+
+static void
+ngx_http_trackuri_flush(ngx_http_trackuri_loc_conf_t *flcf)
+{
+    ngx_http_trackuri_ctx_t  *ctx;
+
+    if (flcf->shm_zone == NULL) {
+        ngx_uri_batch_flush(&flcf->batch, &flcf->uri_table);
+        return;
+    }
+
+    ctx = flcf->shm_zone->data;
+
+    ngx_shmtx_lock(&ctx->shpool->mutex);
+    ngx_uri_batch_flush(&flcf->batch, ctx->uri_table);
+    ngx_shmtx_unlock(&ctx->shpool->mutex);
+}
+
+static void
+ngx_http_trackuri_flush_handler(ngx_event_t *ev)
+{
+    // the timer is armed again by the next tracked request; it is not
+    // cancelable, so an exiting worker still flushes its last batch
+    ngx_http_trackuri_flush(ev->data);
 }
 
 static char *
@@ -148,13 +766,6 @@ ngx_http_trackuri(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         ngx_http_core_loc_conf_t   *clcf;
         clcf = ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module);
         clcf->handler = ngx_http_trackuri_handler;
-
-        // initialize uri_table to start tracking popular uris
-        if (!ngx_uri_table_init(cf->pool, cf->log, &flcf->uri_table))
-            return NGX_CONF_ERROR;
-        ngx_conf_log_error(NGX_LOG_WARN, cf, 0,
-                           "Initialized hash table of size: \"%d\"",
-                           flcf->uri_table.hash_table->size);
     }
 
     return NGX_CONF_OK;
@@ -183,20 +794,624 @@ ngx_http_return_uristats(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
       return NGX_CONF_ERROR;
     }
 
+    // a stats location may only read a zone that others count into
     if (flcf->return_uri_stats)
     {
-      if (!flcf->track_uri)
-      {
+      ngx_http_core_loc_conf_t   *clcf;
+      clcf = ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module);
+      clcf->handler = ngx_http_trackuri_handler;
+    }
+
+    return NGX_CONF_OK;
+}
+
+static char *
+ngx_http_trackuri_log(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_trackuri_loc_conf_t *flcf = conf;
+
+    ngx_str_t                *value;
+    ngx_uint_t                i;
+
+    if (flcf->log_uri != NGX_CONF_UNSET) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+        if (cf->args->nelts != 2) {
+            return "is invalid";
+        }
+
+        flcf->log_uri = 0;
+        return NGX_CONF_OK;
+    }
+
+    if (ngx_strcmp(value[1].data, "on") != 0) {
         ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
-                           "\"%s\" directive is set, but popular_uri_track directive is not set",
-                           cmd->name.data);
+                           "invalid value \"%V\" in \"%V\" directive, "
+                           "it must be \"on\" or \"off\"",
+                           &value[1], &cmd->name);
         return NGX_CONF_ERROR;
-      }
     }
 
+    flcf->log_uri = 1;
+    flcf->metrics = 0;
+
+    for (i = 2; i < cf->args->nelts; i++) {
+
+        if (ngx_strcmp(value[i].data, "status") == 0) {
+            flcf->metrics |= NGX_URI_METRIC_STATUS;
+
+        } else if (ngx_strcmp(value[i].data, "bytes") == 0) {
+            flcf->metrics |= NGX_URI_METRIC_BYTES;
+
+        } else if (ngx_strcmp(value[i].data, "time") == 0) {
+            flcf->metrics |= NGX_URI_METRIC_TIME;
+
+        } else {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid parameter \"%V\"", &value[i]);
+            return NGX_CONF_ERROR;
+        }
+    }
+
+    return NGX_CONF_OK;
+}
+
+static ngx_int_t
+ngx_http_trackuri_init(ngx_conf_t *cf)
+{
+    ngx_http_handler_pt        *h;
+    ngx_http_core_main_conf_t  *cmcf;
+
+    cmcf = ngx_http_conf_get_module_main_conf(cf, ngx_http_core_module);
+
+    h = ngx_array_push(&cmcf->phases[NGX_HTTP_LOG_PHASE].handlers);
+    if (h == NULL) {
+        return NGX_ERROR;
+    }
+
+    *h = ngx_http_trackuri_log_handler;
+
+    return NGX_OK;
+}
+
+static char *
+ngx_http_trackuri_zone(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_trackuri_loc_conf_t *flcf = conf;
+
+    ssize_t                   size;
+    ngx_str_t                *value;
+    ngx_shm_zone_t           *shm_zone;
+    ngx_http_trackuri_ctx_t  *ctx;
+
+    if (flcf->shm_zone != NGX_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    size = ngx_parse_size(&value[2]);
+
+    if (size == NGX_ERROR) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid zone size \"%V\"", &value[2]);
+        return NGX_CONF_ERROR;
+    }
+
+    if (size < (ssize_t) (8 * ngx_pagesize)) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "zone \"%V\" is too small", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    shm_zone = ngx_shared_memory_add(cf, &value[1], size,
+                                     &ngx_http_trackuri_module);
+    if (shm_zone == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    // several locations may count into the same zone
+    if (shm_zone->data == NULL) {
+        ctx = ngx_pcalloc(cf->pool, sizeof(ngx_http_trackuri_ctx_t));
+        if (ctx == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        ctx->engine = NGX_CONF_UNSET_UINT;
+
+        shm_zone->init = ngx_http_trackuri_init_zone;
+        shm_zone->data = ctx;
+    }
+
+    flcf->shm_zone = shm_zone;
+
+    return NGX_CONF_OK;
+}
+
+static char *
+ngx_http_trackuri_batch(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_trackuri_loc_conf_t *flcf = conf;
+
+    ngx_int_t                 n;
+    ngx_str_t                *value, s;
+
+    if (flcf->batch_size != NGX_CONF_UNSET_UINT) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+        if (cf->args->nelts != 2) {
+            return "is invalid";
+        }
+
+        flcf->batch_size = 0;
+        return NGX_CONF_OK;
+    }
+
+    n = ngx_atoi(value[1].data, value[1].len);
+    if (n == NGX_ERROR || n == 0 || n > 65536) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid number of batch slots \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    flcf->batch_size = n;
+
+    if (cf->args->nelts == 3) {
+        if (ngx_strncmp(value[2].data, "interval=", 9) != 0) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid parameter \"%V\"", &value[2]);
+            return NGX_CONF_ERROR;
+        }
+
+        s.len = value[2].len - 9;
+        s.data = value[2].data + 9;
+
+        flcf->batch_interval = ngx_parse_time(&s, 0);
+        if (flcf->batch_interval == (ngx_msec_t) NGX_ERROR
+            || flcf->batch_interval == 0)
+        {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid flush interval \"%V\"", &value[2]);
+            return NGX_CONF_ERROR;
+        }
+    }
+
+    return NGX_CONF_OK;
+}
+
+static char *
+ngx_http_trackuri_window(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_trackuri_loc_conf_t *flcf = conf;
+
+    ngx_str_t                *value;
+    ngx_uint_t                i;
+    ngx_msec_t                span;
+
+    if (flcf->recency.windows[0] != NGX_CONF_UNSET_MSEC) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    ngx_memzero(flcf->recency.windows, sizeof(flcf->recency.windows));
+
+    for (i = 1; i < cf->args->nelts; i++) {
+        span = ngx_parse_time(&value[i], 0);
+
+        // a sub-window is at least a second
+        if (span == (ngx_msec_t) NGX_ERROR
+            || span < NGX_URI_WINDOW_SLOTS * 1000)
+        {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid window \"%V\"", &value[i]);
+            return NGX_CONF_ERROR;
+        }
+
+        flcf->recency.windows[i - 1] = span;
+    }
+
+    return NGX_CONF_OK;
+}
+
+static ngx_int_t
+ngx_http_trackuri_init_zone(ngx_shm_zone_t *shm_zone, void *data)
+{
+    ngx_http_trackuri_ctx_t  *octx = data;
+
+    size_t                    len;
+    ngx_http_trackuri_ctx_t  *ctx;
+
+    ctx = shm_zone->data;
+
+    if (ctx->engine == NGX_CONF_UNSET_UINT) {
+        ctx->engine = NGX_URI_ENGINE_LRU;
+        ctx->top = 100;
+    }
+
+    if (octx) {
+        if (ctx->engine != octx->engine || ctx->top != octx->top
+            || ctx->metrics != octx->metrics
+            || ngx_memcmp(&ctx->recency, &octx->recency,
+                          sizeof(ngx_uri_recency)) != 0)
+        {
+            ngx_log_error(NGX_LOG_EMERG, shm_zone->shm.log, 0,
+                          "popular_uri_zone \"%V\" uses another "
+                          "popular_uri_engine, popular_uri_top, "
+                          "popular_uri_window, popular_uri_decay "
+                          "or popular_uri_log metrics "
+                          "than it previously did",
+                          &shm_zone->shm.name);
+            return NGX_ERROR;
+        }
+
+        // keep the counters across reloads
+        ctx->uri_table = octx->uri_table;
+        ctx->shpool = octx->shpool;
+
+        return NGX_OK;
+    }
+
+    ctx->shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        ctx->uri_table = ctx->shpool->data;
+
+        return NGX_OK;
+    }
+
+    ctx->uri_table = ngx_slab_alloc(ctx->shpool, sizeof(ngx_uri_table));
+    if (ctx->uri_table == NULL) {
+        return NGX_ERROR;
+    }
+
+    ctx->shpool->data = ctx->uri_table;
+
+    len = sizeof(" in popular_uri_zone \"\"") + shm_zone->shm.name.len;
+
+    ctx->shpool->log_ctx = ngx_slab_alloc(ctx->shpool, len);
+    if (ctx->shpool->log_ctx == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_sprintf(ctx->shpool->log_ctx, " in popular_uri_zone \"%V\"%Z",
+                &shm_zone->shm.name);
+
+    // running out of zone memory only evicts cold entries
+    ctx->shpool->log_nomem = 0;
+
+    if (!ngx_uri_table_init_shared(ctx->shpool, shm_zone->shm.size,
+                                   ctx->engine, ctx->top, &ctx->recency,
+                                   ctx->metrics, ctx->uri_table))
+    {
+        return NGX_ERROR;
+    }
+
+    ngx_log_error(NGX_LOG_NOTICE, shm_zone->shm.log, 0,
+                  "popular_uri_zone \"%V\" tracks up to %ui uris",
+                  &shm_zone->shm.name, ctx->uri_table->capacity);
+
+    // a reload reuses the zone above, a restart starts from the snapshot
+    if (ctx->snapshot && !ctx->snapshot->reloaded) {
+        ngx_http_trackuri_load(ctx->uri_table, ctx->snapshot->file,
+                               shm_zone->shm.log);
+    }
+
+    return NGX_OK;
+}
+
+static char *
+ngx_http_trackuri_snapshot(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+    ngx_http_trackuri_loc_conf_t *flcf = conf;
+
+    ngx_str_t                     *value, s;
+    ngx_http_trackuri_snapshot_t  *snapshot;
+
+    if (flcf->snapshot != NGX_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+        flcf->snapshot = NULL;
+        return NGX_CONF_OK;
+    }
+
+    snapshot = ngx_pcalloc(cf->pool, sizeof(ngx_http_trackuri_snapshot_t));
+    if (snapshot == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    snapshot->path = value[1];
+    snapshot->interval = 300000;
+
+    if (ngx_conf_full_name(cf->cycle, &snapshot->path, 0) != NGX_OK) {
+        return NGX_CONF_ERROR;
+    }
+
+    // ngx_conf_full_name() keeps the terminating null
+    snapshot->file = snapshot->path.data;
+
+    if (cf->args->nelts == 3) {
+        if (ngx_strncmp(value[2].data, "interval=", 9) != 0) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid parameter \"%V\"", &value[2]);
+            return NGX_CONF_ERROR;
+        }
+
+        s.len = value[2].len - 9;
+        s.data = value[2].data + 9;
+
+        snapshot->interval = ngx_parse_time(&s, 0);
+        if (snapshot->interval == (ngx_msec_t) NGX_ERROR
+            || snapshot->interval == 0)
+        {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid snapshot interval \"%V\"",
+                               &value[2]);
+            return NGX_CONF_ERROR;
+        }
+    }
+
+    flcf->snapshot = snapshot;
+
     return NGX_CONF_OK;
 }
 
+static void *
+ngx_http_trackuri_create_main_conf(ngx_conf_t *cf)
+{
+    ngx_http_trackuri_main_conf_t  *tmcf;
+
+    tmcf = ngx_pcalloc(cf->pool, sizeof(ngx_http_trackuri_main_conf_t));
+    if (tmcf == NULL) {
+        return NULL;
+    }
+
+    if (ngx_array_init(&tmcf->snapshots, cf->pool, 1,
+                       sizeof(ngx_http_trackuri_snapshot_t *))
+        != NGX_OK)
+    {
+        return NULL;
+    }
+
+    return tmcf;
+}
+
+// the first worker snapshots the zones, every worker its private tables
+static ngx_int_t
+ngx_http_trackuri_init_process(ngx_cycle_t *cycle)
+{
+    ngx_uint_t                      i;
+    ngx_http_trackuri_main_conf_t  *tmcf;
+    ngx_http_trackuri_snapshot_t  **snapshots, *snapshot;
+    u_char                         *file;
+
+    tmcf = ngx_http_cycle_get_module_main_conf(cycle, ngx_http_trackuri_module);
+    if (tmcf == NULL) {
+        return NGX_OK;
+    }
+
+    snapshots = tmcf->snapshots.elts;
+
+    for (i = 0; i < tmcf->snapshots.nelts; i++) {
+        snapshot = snapshots[i];
+
+        if (snapshot->shm_zone) {
+            if (ngx_worker != 0) {
+                continue;
+            }
+
+        } else {
+            file = ngx_pnalloc(cycle->pool,
+                               snapshot->path.len + 1 + NGX_INT_T_LEN + 1);
+            if (file == NULL) {
+                return NGX_ERROR;
+            }
+
+            ngx_sprintf(file, "%V.%ui%Z", &snapshot->path, ngx_worker);
+            snapshot->file = file;
+
+            if (!snapshot->reloaded) {
+                ngx_http_trackuri_load(snapshot->uri_table, file, cycle->log);
+            }
+        }
+
+        snapshot->event.handler = ngx_http_trackuri_snapshot_handler;
+        snapshot->event.data = snapshot;
+        snapshot->event.log = cycle->log;
+        snapshot->event.cancelable = 1;
+
+        ngx_add_timer(&snapshot->event, snapshot->interval);
+    }
+
+    return NGX_OK;
+}
+
+static void
+ngx_http_trackuri_exit_process(ngx_cycle_t *cycle)
+{
+    ngx_uint_t                      i;
+    ngx_http_trackuri_main_conf_t  *tmcf;
+    ngx_http_trackuri_snapshot_t  **snapshots;
+
+    tmcf = ngx_http_cycle_get_module_main_conf(cycle, ngx_http_trackuri_module);
+    if (tmcf == NULL) {
+        return;
+    }
+
+    snapshots = tmcf->snapshots.elts;
+
+    for (i = 0; i < tmcf->snapshots.nelts; i++) {
+        if (snapshots[i]->event.handler) {
+            ngx_http_trackuri_save(snapshots[i], cycle->log);
+        }
+    }
+}
+
+static void
+ngx_http_trackuri_snapshot_handler(ngx_event_t *ev)
+{
+    ngx_http_trackuri_snapshot_t  *snapshot = ev->data;
+
+    ngx_http_trackuri_save(snapshot, ev->log);
+
+    if (!ngx_exiting) {
+        ngx_add_timer(ev, snapshot->interval);
+    }
+}
+
+// written to a temporary file first, so a crash never leaves a torn
+// snapshot behind
+static void
+ngx_http_trackuri_save(ngx_http_trackuri_snapshot_t *snapshot, ngx_log_t *log)
+{
+    ssize_t                   n;
+    size_t                    size, written;
+    u_char                   *image, *temp;
+    ngx_fd_t                  fd;
+    ngx_http_trackuri_ctx_t  *ctx;
+
+    if (snapshot->shm_zone) {
+        ctx = snapshot->shm_zone->data;
+
+        ngx_shmtx_lock(&ctx->shpool->mutex);
+        image = ngx_uri_table_snapshot(ctx->uri_table, &size);
+        ngx_shmtx_unlock(&ctx->shpool->mutex);
+
+    } else {
+        image = ngx_uri_table_snapshot(snapshot->uri_table, &size);
+    }
+
+    if (image == NULL) {
+        return;
+    }
+
+    temp = ngx_alloc(ngx_strlen(snapshot->file) + 1 + NGX_INT64_LEN + 1, log);
+    if (temp == NULL) {
+        ngx_free(image);
+        return;
+    }
+
+    ngx_sprintf(temp, "%s.%P%Z", snapshot->file, ngx_pid);
+
+    fd = ngx_open_file(temp, NGX_FILE_WRONLY, NGX_FILE_TRUNCATE,
+                       NGX_FILE_DEFAULT_ACCESS);
+
+    if (fd == NGX_INVALID_FILE) {
+        ngx_log_error(NGX_LOG_CRIT, log, ngx_errno,
+                      ngx_open_file_n " \"%s\" failed", temp);
+        goto done;
+    }
+
+    for (written = 0; written < size; written += n) {
+        n = ngx_write_fd(fd, image + written, size - written);
+
+        if (n == -1) {
+            ngx_log_error(NGX_LOG_CRIT, log, ngx_errno,
+                          ngx_write_fd_n " \"%s\" failed", temp);
+            break;
+        }
+    }
+
+    if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      ngx_close_file_n " \"%s\" failed", temp);
+    }
+
+    if (written < size) {
+        if (ngx_delete_file(temp) == NGX_FILE_ERROR) {
+            ngx_log_error(NGX_LOG_CRIT, log, ngx_errno,
+                          ngx_delete_file_n " \"%s\" failed", temp);
+        }
+
+    } else if (ngx_rename_file(temp, snapshot->file) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_CRIT, log, ngx_errno,
+                      ngx_rename_file_n " \"%s\" to \"%s\" failed",
+                      temp, snapshot->file);
+    }
+
+done:
+
+    ngx_free(temp);
+    ngx_free(image);
+}
+
+static void
+ngx_http_trackuri_load(ngx_uri_table *uri_table, u_char *file, ngx_log_t *log)
+{
+    ssize_t          n;
+    size_t           size, got;
+    u_char          *image;
+    ngx_fd_t         fd;
+    ngx_file_info_t  fi;
+
+    fd = ngx_open_file(file, NGX_FILE_RDONLY, NGX_FILE_OPEN, 0);
+
+    if (fd == NGX_INVALID_FILE) {
+        if (ngx_errno != NGX_ENOENT) {
+            ngx_log_error(NGX_LOG_CRIT, log, ngx_errno,
+                          ngx_open_file_n " \"%s\" failed", file);
+        }
+        return;
+    }
+
+    image = NULL;
+
+    if (ngx_fd_info(fd, &fi) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_CRIT, log, ngx_errno,
+                      ngx_fd_info_n " \"%s\" failed", file);
+        goto done;
+    }
+
+    size = (size_t) ngx_file_size(&fi);
+
+    image = ngx_alloc(size, log);
+    if (image == NULL) {
+        goto done;
+    }
+
+    for (got = 0; got < size; got += n) {
+        n = ngx_read_fd(fd, image + got, size - got);
+
+        if (n == -1 || n == 0) {
+            ngx_log_error(NGX_LOG_CRIT, log, ngx_errno,
+                          ngx_read_fd_n " \"%s\" failed", file);
+            goto done;
+        }
+    }
+
+    if (ngx_uri_table_restore(uri_table, image, size)) {
+        ngx_log_error(NGX_LOG_NOTICE, log, 0,
+                      "popular uris restored from \"%s\"", file);
+
+    } else {
+        ngx_log_error(NGX_LOG_WARN, log, 0,
+                      "popular uri snapshot \"%s\" is invalid", file);
+    }
+
+done:
+
+    if (image) {
+        ngx_free(image);
+    }
+
+    if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      ngx_close_file_n " \"%s\" failed", file);
+    }
+}
+
 static void *
 ngx_http_trackuri_create_loc_conf(ngx_conf_t *cf)
 {
@@ -210,6 +1425,15 @@ ngx_http_trackuri_create_loc_conf(ngx_conf_t *cf)
 
     conf->track_uri        = NGX_CONF_UNSET;
     conf->return_uri_stats = NGX_CONF_UNSET;
+    conf->log_uri          = NGX_CONF_UNSET;
+    conf->snapshot         = NGX_CONF_UNSET_PTR;
+    conf->engine           = NGX_CONF_UNSET_UINT;
+    conf->top              = NGX_CONF_UNSET_UINT;
+    conf->recency.windows[0] = NGX_CONF_UNSET_MSEC;
+    conf->recency.half_life  = NGX_CONF_UNSET_MSEC;
+    conf->shm_zone         = NGX_CONF_UNSET_PTR;
+    conf->batch_size       = NGX_CONF_UNSET_UINT;
+    conf->batch_interval   = NGX_CONF_UNSET_MSEC;
 
     /*cln = ngx_pool_cleanup_add(cf->pool, 0);
     if (cln == NULL) {
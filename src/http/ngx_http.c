@@ -1827,6 +1827,10 @@ ngx_http_add_listening(ngx_conf_t *cf, ngx_http_conf_addr_t *addr)
     ls->reuseport = addr->opt.reuseport;
 #endif
 
+#if (NGX_HAVE_INCOMING_CPU)
+    ls->incoming_cpu = addr->opt.incoming_cpu;
+#endif
+
     return ls;
 }
 
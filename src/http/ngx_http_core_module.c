@@ -4179,6 +4179,17 @@ ngx_http_core_listen(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
             continue;
         }
 
+        if (ngx_strcmp(value[n].data, "incoming_cpu") == 0) {
+#if (NGX_HAVE_INCOMING_CPU)
+            lsopt.incoming_cpu = 1;
+#else
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "incoming_cpu is not supported "
+                               "on this platform, ignored");
+#endif
+            continue;
+        }
+
         if (ngx_strcmp(value[n].data, "ssl") == 0) {
 #if (NGX_HTTP_SSL)
             lsopt.ssl = 1;
@@ -4304,6 +4315,14 @@ ngx_http_core_listen(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         return NGX_CONF_ERROR;
     }
 
+#if (NGX_HAVE_INCOMING_CPU)
+    if (lsopt.incoming_cpu && !lsopt.reuseport) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "incoming_cpu requires reuseport");
+        return NGX_CONF_ERROR;
+    }
+#endif
+
     if (ngx_http_add_listen(cf, cscf, &lsopt) == NGX_OK) {
         return NGX_CONF_OK;
     }
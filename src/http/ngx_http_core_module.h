@@ -87,6 +87,9 @@ typedef struct {
 #endif
 #if (NGX_HAVE_REUSEPORT)
     unsigned                   reuseport:1;
+#endif
+#if (NGX_HAVE_INCOMING_CPU)
+    unsigned                   incoming_cpu:1;
 #endif
     unsigned                   so_keepalive:2;
     unsigned                   proxy_protocol:1;
@@ -523,6 +523,8 @@ ngx_http_create_request(ngx_connection_t *c)
         return NULL;
     }
 
+    ngx_pool_set_type(pool, NGX_POOL_REQUEST);
+
     r = ngx_pcalloc(pool, sizeof(ngx_http_request_t));
     if (r == NULL) {
         ngx_destroy_pool(pool);
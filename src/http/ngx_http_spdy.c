@@ -469,6 +469,8 @@ ngx_http_spdy_init(ngx_event_t *rev)
         return;
     }
 
+    ngx_pool_set_type(sc->pool, NGX_POOL_CONNECTION);
+
     cln = ngx_pool_cleanup_add(c->pool, sizeof(ngx_pool_cleanup_file_t));
     if (cln == NULL) {
         ngx_http_close_connection(c);
@@ -3530,6 +3532,8 @@ ngx_http_spdy_keepalive_handler(ngx_event_t *rev)
         return;
     }
 
+    ngx_pool_set_type(sc->pool, NGX_POOL_CONNECTION);
+
     sc->streams_index = ngx_pcalloc(sc->pool,
                                     ngx_http_spdy_streams_index_size(sscf)
                                     * sizeof(ngx_http_spdy_stream_t *));
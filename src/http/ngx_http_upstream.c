@@ -1374,6 +1374,8 @@ ngx_http_upstream_connect(ngx_http_request_t *r, ngx_http_upstream_t *u)
                                                NGX_HTTP_INTERNAL_SERVER_ERROR);
             return;
         }
+
+        ngx_pool_set_type(c->pool, NGX_POOL_CONNECTION);
     }
 
     c->log = r->connection->log;
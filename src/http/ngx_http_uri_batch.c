@@ -0,0 +1,108 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include "ngx_http_uri_hash_table.h"
+
+// A worker counts into a small open-addressing table of its own, four
+// 16-byte slots per cache line, and flushes the accumulated increments
+// into the authoritative uri table in one go.  Keys are appended to a
+// buffer that is reset by the flush.
+
+bool
+ngx_uri_batch_init(ngx_pool_t * pool, ngx_uri_batch * batch, ngx_uint_t size)
+{
+  ngx_uint_t n;
+
+  // a power of two of at least the requested size
+  for (n = 16; n < size; n <<= 1) { /* void */ }
+
+  batch->slots = ngx_pmemalign(pool, n * sizeof(ngx_uri_batch_slot), ngx_cacheline_size);
+  if (batch->slots == NULL)
+    return false;
+  ngx_memzero(batch->slots, n * sizeof(ngx_uri_batch_slot));
+
+  batch->keys_size = n * 64;
+  batch->keys = ngx_pnalloc(pool, batch->keys_size);
+  if (batch->keys == NULL)
+    return false;
+
+  batch->size = n;
+  batch->used = 0;
+  batch->keys_last = 0;
+  return true;
+}
+
+ngx_int_t
+ngx_uri_batch_add(ngx_uri_batch * batch, const ngx_str_t * uri)
+{
+  ngx_uri_batch_slot * slot;
+  ngx_uint_t           i, mask;
+  uint32_t             hash;
+  u_char               my_uri[257];
+
+  if (uri->len <= 0 || uri->len > 256) {
+    return NGX_DECLINED;
+  }
+
+  hash = ngx_murmur_hash2_strlow(my_uri, uri->data, uri->len);
+
+  mask = batch->size - 1;
+  for (i = hash & mask; ; i = (i + 1) & mask) {
+    slot = &batch->slots[i];
+
+    if (slot->count == 0)
+      break;
+
+    if (slot->hash == hash && slot->len == uri->len
+        && ngx_memcmp(batch->keys + slot->key, my_uri, uri->len) == 0)
+    {
+      slot->count++;
+      return NGX_OK;
+    }
+  }
+
+  // keep the load at 3/4 so that probes stay short
+  if (batch->used >= batch->size - batch->size / 4
+      || batch->keys_last + uri->len + 1 > batch->keys_size)
+  {
+    return NGX_AGAIN;
+  }
+
+  ngx_memcpy(batch->keys + batch->keys_last, my_uri, uri->len);
+  batch->keys[batch->keys_last + uri->len] = '\0';
+
+  slot->hash = hash;
+  slot->count = 1;
+  slot->key = batch->keys_last;
+  slot->len = uri->len;
+
+  batch->keys_last += uri->len + 1;
+  batch->used++;
+  return NGX_OK;
+}
+
+void
+ngx_uri_batch_flush(ngx_uri_batch * batch, ngx_uri_table * uri_table)
+{
+  ngx_uri_batch_slot * slot;
+  ngx_uint_t           i;
+
+  for (i = 0; batch->used && i < batch->size; i++) {
+    slot = &batch->slots[i];
+
+    if (slot->count == 0)
+      continue;
+
+    ngx_uri_table_add_count(uri_table, batch->keys + slot->key, slot->len,
+                            slot->hash, slot->count);
+
+    slot->count = 0;
+    batch->used--;
+  }
+
+  batch->used = 0;
+  batch->keys_last = 0;
+}
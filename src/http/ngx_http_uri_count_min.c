@@ -0,0 +1,230 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include "ngx_http_uri_hash_table.h"
+
+// Count-Min sketch (Cormode, Muthukrishnan): every uri increments one
+// counter in each of depth rows of width counters, and its estimate is the
+// minimum of them.  The estimate never underestimates, and with probability
+// 1 - e^-depth overestimates by at most e * N / width, N being the number of
+// tracked requests.  The sketch keeps no names, so a min-heap of the k uris
+// with the highest estimates is maintained next to it.
+
+#define NGX_URI_CM_DEPTH  4
+
+static void
+ngx_uri_cm_sift_down(ngx_uri_count_min * cm, ngx_uint_t i);
+static ngx_uri_cm_entry *
+ngx_uri_cm_lookup(ngx_uri_count_min * cm, const u_char * uri, uint32_t hash);
+static void
+ngx_uri_cm_hash_delete(ngx_uri_count_min * cm, ngx_uri_cm_entry * entry);
+
+bool
+ngx_uri_count_min_init(ngx_uri_table * uri_table, size_t budget)
+{
+  ngx_uri_count_min * cm;
+
+  cm = ngx_uri_table_alloc(uri_table, sizeof(ngx_uri_count_min));
+  if (cm == NULL)
+    return false;
+
+  // up to an eighth of the budget names the heavy hitters, a few more than
+  // reported to keep the ones about to enter the top, the rest is sketch
+  size_t x = sizeof(ngx_uri_cm_entry) + 3 * sizeof(ngx_uri_cm_entry*);
+  cm->k = ngx_min((budget / 8) / x, 4 * uri_table->top);
+  cm->depth = NGX_URI_CM_DEPTH;
+  cm->width = (budget - cm->k * x) / (cm->depth * sizeof(ngx_uint_t));
+  if (cm->k == 0 || cm->width == 0)
+    return false;
+
+  cm->hash_size = ngx_uri_hash_size(2 * cm->k);
+  cm->counters = ngx_uri_table_alloc(uri_table, cm->depth * cm->width * sizeof(ngx_uint_t));
+  cm->buckets = ngx_uri_table_alloc(uri_table, cm->hash_size * sizeof(ngx_uri_cm_entry*));
+  cm->entries = ngx_uri_table_alloc(uri_table, cm->k * sizeof(ngx_uri_cm_entry));
+  cm->heap = ngx_uri_table_alloc(uri_table, cm->k * sizeof(ngx_uri_cm_entry*));
+  if (cm->counters == NULL || cm->buckets == NULL || cm->entries == NULL || cm->heap == NULL)
+    return false;
+
+  ngx_memzero(cm->counters, cm->depth * cm->width * sizeof(ngx_uint_t));
+  ngx_memzero(cm->buckets, cm->hash_size * sizeof(ngx_uri_cm_entry*));
+  cm->total = 0;
+  cm->size = 0;
+
+  uri_table->sketch = cm;
+  uri_table->capacity = cm->k;
+  return true;
+}
+
+bool
+ngx_uri_count_min_add(ngx_uri_table * uri_table, const u_char * uri, size_t len, uint32_t hash, ngx_uint_t n, const ngx_uri_sample * sample)
+{
+  ngx_uri_count_min * cm = uri_table->sketch;
+  ngx_uri_cm_entry  * entry;
+  ngx_uint_t          i, v, estimate;
+  uint32_t            h1, h2;
+
+  // the rows are indexed by h1 + i * h2 (Kirsch, Mitzenmacher), h2 is
+  // the murmur3 finalizer of the hash rather than a second pass on the uri
+  h1 = hash;
+  h2 = hash;
+  h2 ^= h2 >> 16;
+  h2 *= 0x85ebca6b;
+  h2 ^= h2 >> 13;
+  h2 *= 0xc2b2ae35;
+  h2 ^= h2 >> 16;
+  h2 |= 1;
+
+  estimate = (ngx_uint_t) -1;
+  for (i = 0; i < cm->depth; i++) {
+    ngx_uint_t * counter = &cm->counters[i * cm->width + (h1 + i * h2) % cm->width];
+    *counter += n;
+    estimate = ngx_min(estimate, *counter);
+  }
+  cm->total += n;
+
+  v = hash & (cm->hash_size - 1);
+
+  entry = ngx_uri_cm_lookup(cm, uri, hash);
+  if (entry) {
+    entry->count = estimate;
+    ngx_uri_cm_sift_down(cm, entry->index);
+    return true;
+  }
+
+  if (cm->size < cm->k) {
+    entry = &cm->entries[cm->size];
+    entry->index = cm->size;
+    cm->heap[cm->size++] = entry;
+
+  } else if (estimate > cm->heap[0]->count) {
+    // the new uri displaces the weakest heavy hitter
+    entry = cm->heap[0];
+    ngx_uri_cm_hash_delete(cm, entry);
+
+  } else {
+    return true;
+  }
+
+  ngx_memcpy(entry->uri, uri, len + 1);
+  entry->hash = hash;
+  entry->count = estimate;
+  entry->next = cm->buckets[v];
+  cm->buckets[v] = entry;
+
+  // a fresh entry is either the last leaf or the root; estimates only
+  // grow, so the heap is restored by moving it up or down respectively
+  if (entry->index == 0) {
+    ngx_uri_cm_sift_down(cm, 0);
+  } else {
+    i = entry->index;
+    while (i && cm->heap[(i - 1) / 2]->count > entry->count) {
+      cm->heap[i] = cm->heap[(i - 1) / 2];
+      cm->heap[i]->index = i;
+      i = (i - 1) / 2;
+    }
+    cm->heap[i] = entry;
+    entry->index = i;
+  }
+
+  return true;
+}
+
+ngx_uint_t
+ngx_uri_count_min_topn(ngx_uri_table * uri_table, ngx_uri_stat * stats, ngx_uint_t n)
+{
+  ngx_uri_count_min * cm = uri_table->sketch;
+  ngx_uri_stat      * all;
+  ngx_uint_t          i, error;
+
+  // with probability 1 - e^-depth no estimate is off by more than e * N / w
+  error = ((uint64_t) cm->total * 2718 + cm->width * 1000 - 1) / ((uint64_t) cm->width * 1000);
+
+  if (cm->size <= n) {
+    all = stats;
+  } else {
+    all = ngx_alloc(cm->size * sizeof(ngx_uri_stat), ngx_cycle->log);
+    if (all == NULL)
+      return 0;
+  }
+
+  for (i = 0; i < cm->size; i++) {
+    all[i].uri   = cm->heap[i]->uri;
+    all[i].count = cm->heap[i]->count;
+    all[i].error = ngx_min(error, cm->heap[i]->count);
+  }
+
+  ngx_uri_stats_sort(all, cm->size);
+
+  if (all != stats) {
+    ngx_memcpy(stats, all, n * sizeof(ngx_uri_stat));
+    ngx_free(all);
+  }
+
+  return ngx_min(n, cm->size);
+}
+
+// the named heavy hitters in heap order, the root is the coldest
+void
+ngx_uri_count_min_walk(ngx_uri_table * uri_table, ngx_uri_walk_pt handler, void * data)
+{
+  ngx_uri_count_min * cm = uri_table->sketch;
+  ngx_uint_t          i;
+
+  for (i = 0; i < cm->size; i++) {
+    handler(data, cm->heap[i]->uri, ngx_strlen(cm->heap[i]->uri), cm->heap[i]->count, NULL);
+  }
+}
+
+static void
+ngx_uri_cm_sift_down(ngx_uri_count_min * cm, ngx_uint_t i)
+{
+  ngx_uri_cm_entry * entry = cm->heap[i];
+  ngx_uint_t         child;
+
+  for ( ;; ) {
+    child = 2 * i + 1;
+    if (child >= cm->size)
+      break;
+    if (child + 1 < cm->size && cm->heap[child + 1]->count < cm->heap[child]->count)
+      child++;
+    if (cm->heap[child]->count >= entry->count)
+      break;
+    cm->heap[i] = cm->heap[child];
+    cm->heap[i]->index = i;
+    i = child;
+  }
+
+  cm->heap[i] = entry;
+  entry->index = i;
+}
+
+static ngx_uri_cm_entry *
+ngx_uri_cm_lookup(ngx_uri_count_min * cm, const u_char * uri, uint32_t hash)
+{
+  ngx_uri_cm_entry * walker;
+
+  for (walker = cm->buckets[hash & (cm->hash_size - 1)]; walker != NULL; walker = walker->next)
+  {
+    if (walker->hash == hash && ngx_strcmp(uri, walker->uri) == 0) {
+      return walker;
+    }
+  }
+  return NULL;
+}
+
+static void
+ngx_uri_cm_hash_delete(ngx_uri_count_min * cm, ngx_uri_cm_entry * entry)
+{
+  ngx_uri_cm_entry ** walker;
+
+  for (walker = &cm->buckets[entry->hash & (cm->hash_size - 1)]; *walker; walker = &(*walker)->next)
+  {
+    if (*walker == entry) {
+      *walker = entry->next;
+      break;
+    }
+  }
+}
@@ -1,178 +1,258 @@
 #include "ngx_http_uri_hash_table.h"
-#include <math.h>
 
-#define TOPN 100
-#define INITIAL_SIZE 1024
 // predefine functions
 void
 ngx_uri_table_lru_list_purge(ngx_uri_table * uri_table, bool force_purge);
+bool
+ngx_uri_table_lru_list_evict(ngx_uri_table * uri_table);
 void
 ngx_uri_table_lru_list_add(ngx_uri_table * uri_table, ngx_uri_entry * new_entry);
 void
 ngx_uri_table_lru_list_delete(ngx_uri_table * uri_table, ngx_uri_entry * old_entry);
-void
-ngx_uri_table_lru_list_walk(ngx_uri_table * uri_table, ngx_str_t * report);
+static void
+ngx_uri_table_lru_list_refill(ngx_uri_table * uri_table);
 
 // heap functions
-ngx_max_heap *
-ngx_max_heap_init(ngx_uint_t heap_size, ngx_log_t * log);
-void
-ngx_max_heap_build(ngx_max_heap * max_heap, ngx_uri_entry * uri_entry);
 bool
-ngx_max_heap_add(ngx_max_heap * max_heap, ngx_uri_entry * uri_entry);
-ngx_uri_entry *
-ngx_max_heap_delete(ngx_max_heap * max_heap);
+ngx_min_heap_init(ngx_uri_table * uri_table, ngx_min_heap * min_heap, ngx_uint_t heap_size);
 void
-ngx_max_heap_heapify(ngx_max_heap * max_heap, ngx_uint_t i);
+ngx_min_heap_update(ngx_min_heap * min_heap, ngx_uri_entry * uri_entry);
 void
-ngx_max_heap_swap(ngx_uri_entry **n1, ngx_uri_entry **n2);
-ngx_uint_t
-ngx_max_heap_size(ngx_max_heap * max_heap);
+ngx_min_heap_delete(ngx_min_heap * min_heap, ngx_uri_entry * uri_entry);
+void
+ngx_min_heap_sift_up(ngx_min_heap * min_heap, ngx_uint_t i);
 void
-ngx_max_heap_reset(ngx_max_heap * max_heap, ngx_uint_t heap_size);
+ngx_min_heap_heapify(ngx_min_heap * min_heap, ngx_uint_t i);
+void
+ngx_min_heap_swap(ngx_min_heap * min_heap, ngx_uint_t i, ngx_uint_t j);
 ngx_uint_t
-ngx_max_heap_get_topn(ngx_max_heap * max_heap, u_char * report);
-ngx_uri_entry*
-ngx_max_heap_root_element(ngx_max_heap * max_heap);
-
-// predeclare global heap
-ngx_max_heap * max_heap = NULL;
+ngx_min_heap_get_topn(ngx_min_heap * min_heap, ngx_uri_stat * stats, ngx_uint_t n);
+
+// the exact lru engine
+static bool
+ngx_uri_table_lru_init(ngx_uri_table * uri_table, size_t budget);
+static bool
+ngx_uri_table_lru_add(ngx_uri_table * uri_table, const u_char * uri, size_t len, uint32_t hash, ngx_uint_t n, const ngx_uri_sample * sample);
+static ngx_uint_t
+ngx_uri_table_lru_topn(ngx_uri_table * uri_table, ngx_uri_stat * stats, ngx_uint_t n);
+static void
+ngx_uri_table_lru_walk(ngx_uri_table * uri_table, ngx_uri_walk_pt handler, void * data);
+
+typedef struct {
+  bool       (*init)(ngx_uri_table * uri_table, size_t budget);
+  // count n more hits of a normalized, null terminated uri, hash is
+  // ngx_murmur_hash2() of it and is never computed again by the engine;
+  // only the lru engine keeps the sample of a single hit
+  bool       (*add)(ngx_uri_table * uri_table, const u_char * uri, size_t len, uint32_t hash, ngx_uint_t n, const ngx_uri_sample * sample);
+  ngx_uint_t (*topn)(ngx_uri_table * uri_table, ngx_uri_stat * stats, ngx_uint_t n);
+  void       (*walk)(ngx_uri_table * uri_table, ngx_uri_walk_pt handler, void * data);
+} ngx_uri_engine;
+
+// indexed by NGX_URI_ENGINE_*
+static ngx_uri_engine ngx_uri_engines[] = {
+  { ngx_uri_table_lru_init, ngx_uri_table_lru_add, ngx_uri_table_lru_topn,
+    ngx_uri_table_lru_walk },
+  { ngx_uri_space_saving_init, ngx_uri_space_saving_add, ngx_uri_space_saving_topn,
+    ngx_uri_space_saving_walk },
+  { ngx_uri_count_min_init, ngx_uri_count_min_add, ngx_uri_count_min_topn,
+    ngx_uri_count_min_walk }
+};
 
-/* Hash function from Chris Torek. */
+// the largest power of two of buckets that is not above n
 ngx_uint_t
-hash4(const void *data, ngx_uint_t size)
+ngx_uri_hash_size(ngx_uint_t n)
 {
-  const char *key = (const char *)data;
-  size_t loop;
-  ngx_uint_t h;
-  size_t len;
+  ngx_uint_t size;
 
-#define HASH4a   h = (h << 5) - h + *key++;
-#define HASH4b   h = (h << 5) + h + *key++;
-#define HASH4 HASH4b
+  for (size = 1; size <= n / 2; size <<= 1) { /* void */ }
+  return size;
+}
 
-  h = 0;
-  len = strlen(key);
-  loop = len >> 3;
-  switch (len & (8 - 1))
-  {
-    case 0:
-      break;
-    case 7:
-      HASH4;
-      /* FALLTHROUGH */
-    case 6:
-      HASH4;
-      /* FALLTHROUGH */
-    case 5:
-      HASH4;
-      /* FALLTHROUGH */
-    case 4:
-      HASH4;
-      /* FALLTHROUGH */
-    case 3:
-      HASH4;
-      /* FALLTHROUGH */
-    case 2:
-      HASH4;
-      /* FALLTHROUGH */
-    case 1:
-      HASH4;
-  }
-  while (loop--)
-  {
-    HASH4;
-    HASH4;
-    HASH4;
-    HASH4;
-    HASH4;
-    HASH4;
-    HASH4;
-    HASH4;
+// the table is either private to a worker (ngx_alloc) or lives in a
+// shared zone (ngx_slab), in which case the caller holds the zone mutex
+void *
+ngx_uri_table_alloc(ngx_uri_table * uri_table, size_t size)
+{
+  if (uri_table->shpool) {
+    return ngx_slab_alloc_locked(uri_table->shpool, size);
   }
-  return h % size;
-}
-
-static const ngx_int_t hash_primes[] =
-{
-  103,
-  229,
-  467,
-  977,
-  1979,
-  4019,
-  6037,
-  7951,
-  12149,
-  16231,
-  33493,
-  65357
-};
+  return ngx_alloc(size, uri_table->log);
+}
 
-ngx_int_t
-hash_prime(ngx_int_t n)
+void
+ngx_uri_table_free(ngx_uri_table * uri_table, void * p)
 {
-  ngx_int_t I = sizeof(hash_primes) / sizeof(int);
-  ngx_int_t i;
-  ngx_int_t best_prime = hash_primes[0];
-  double min = fabs(log((double) n) - log((double) hash_primes[0]));
-  double d;
-  for (i = 0; i < I; i++)
-  {
-    d = fabs(log((double) n) - log((double) hash_primes[i]));
-    if (d > min)
-      continue;
-    min = d;
-    best_prime = hash_primes[i];
+  if (uri_table->shpool) {
+    ngx_slab_free_locked(uri_table->shpool, p);
+    return;
   }
-  return best_prime;
+  ngx_free(p);
 }
 
-bool
-ngx_uri_table_init(ngx_pool_t * pool, ngx_log_t *log, ngx_uri_table * uri_table)
+static void
+ngx_uri_arena_reset(ngx_uri_arena * arena)
 {
-  if (uri_table->hash_table != NULL) {
-    return false;
+  arena->last = arena->start;
+  ngx_memzero(arena->free, sizeof(arena->free));
+}
+
+static ngx_uri_entry *
+ngx_uri_arena_alloc(ngx_uri_arena * arena, size_t len, size_t extra)
+{
+  ngx_uri_entry * entry;
+  ngx_uint_t      size, c;
+
+  size = (offsetof(ngx_uri_entry, uri) + len + 1 + NGX_URI_ARENA_ALIGN - 1)
+         / NGX_URI_ARENA_ALIGN + extra / NGX_URI_ARENA_ALIGN;
+
+  // a freed block of the same size, then fresh space, then a larger block
+  for (c = size; c < NGX_URI_ARENA_CLASSES; c++) {
+    if (arena->free[c]) {
+      entry = arena->free[c];
+      arena->free[c] = entry->next;
+      return entry;
+    }
+
+    if (c == size && arena->last + size * NGX_URI_ARENA_ALIGN <= arena->end) {
+      entry = (ngx_uri_entry *) arena->last;
+      arena->last += size * NGX_URI_ARENA_ALIGN;
+      entry->size = size;
+      return entry;
+    }
   }
-  
-  uri_table->hash_table = ngx_alloc(sizeof(ngx_uri_hash_table), log);
+
+  return NULL;
+}
+
+static void
+ngx_uri_arena_free(ngx_uri_arena * arena, ngx_uri_entry * entry)
+{
+  entry->next = arena->free[entry->size];
+  arena->free[entry->size] = entry;
+}
+
+// bytes of recency and metrics after the key of every entry
+size_t
+ngx_uri_table_entry_extra(ngx_uri_table * uri_table)
+{
+  return uri_table->recent_size
+         + (uri_table->metrics ? sizeof(ngx_uri_metrics) : 0);
+}
+
+static bool
+ngx_uri_table_lru_init(ngx_uri_table * uri_table, size_t budget)
+{
+  // a short uri takes about 64 bytes of arena and hash slot
+  ngx_int_t num_hash_entries = budget / (64 + ngx_uri_table_entry_extra(uri_table));
+
+  uri_table->hash_table = ngx_uri_table_alloc(uri_table, sizeof(ngx_uri_hash_table));
   if (uri_table->hash_table == NULL)
     return false;
 
-  // calculate hash table size given the 2MB memory constraint
-  size_t x = sizeof(ngx_uri_entry) + 2 * sizeof(ngx_uri_entry*);
-  ngx_int_t num_hash_entries = (2 * 1024 * 1024)/x;
-  ngx_int_t hash_size = hash_prime(2 * num_hash_entries);
+  // start small and grow up to a load of about one
+  ngx_uint_t max_size = ngx_uri_hash_size(num_hash_entries);
+  ngx_uint_t hash_size = ngx_min(max_size, 256);
 
-  uri_table->hash_table->buckets = ngx_alloc(hash_size * sizeof(ngx_uri_entry*), log);
+  uri_table->hash_table->buckets = ngx_uri_table_alloc(uri_table, hash_size * sizeof(ngx_uri_entry*));
   if (uri_table->hash_table->buckets == NULL)
     return false;
+  ngx_memzero(uri_table->hash_table->buckets, hash_size * sizeof(ngx_uri_entry*));
 
   // initialize
-  uri_table->hash_table->size = hash_size; 
+  uri_table->hash_table->size = hash_size;
+  uri_table->hash_table->max_size = max_size;
   uri_table->lru_list_entries = 0;
   uri_table->lru_list_max_entries = num_hash_entries;
   uri_table->lru_list.head   = NULL;
   uri_table->lru_list.tail   = NULL;
-  uri_table->pool            = pool;
-  uri_table->log             = log;
+  uri_table->capacity        = num_hash_entries;
+
+  if (!ngx_min_heap_init(uri_table, &uri_table->top_heap, uri_table->top))
+    return false;
+
+  // the rest of the budget holds the entries; the buckets of a resize
+  // coexist with the old ones for a moment
+  size_t arena_size = budget - sizeof(ngx_uri_hash_table)
+                      - (max_size + max_size / 2) * sizeof(ngx_uri_entry*)
+                      - uri_table->top * sizeof(ngx_uri_entry*);
+
+  uri_table->arena.start = ngx_uri_table_alloc(uri_table, arena_size);
+  if (uri_table->arena.start == NULL)
+    return false;
+  uri_table->arena.end = uri_table->arena.start + arena_size;
+  ngx_uri_arena_reset(&uri_table->arena);
   
   return true;
 }
 
+static bool
+ngx_uri_table_create(ngx_uri_table * uri_table, ngx_uint_t engine, ngx_uint_t top, const ngx_uri_recency * recency, ngx_uint_t metrics, size_t budget)
+{
+  if (engine >= sizeof(ngx_uri_engines) / sizeof(ngx_uri_engines[0]))
+    return false;
+
+  // only the exact engine keeps per-uri history
+  uri_table->recency = *recency;
+  uri_table->recent_size = ngx_uri_recent_size(recency);
+  uri_table->metrics = metrics;
+  if ((uri_table->recent_size || metrics) && engine != NGX_URI_ENGINE_LRU)
+    return false;
+
+  uri_table->hash_table = NULL;
+  uri_table->lru_list_entries = 0;
+  uri_table->lru_list.head = NULL;
+  uri_table->lru_list.tail = NULL;
+  uri_table->engine = engine;
+  uri_table->top = top;
+  uri_table->sketch = NULL;
+  uri_table->capacity = 0;
+
+  return ngx_uri_engines[engine].init(uri_table, budget);
+}
+
+bool
+ngx_uri_table_init(ngx_log_t *log, ngx_uint_t engine, ngx_uint_t top, const ngx_uri_recency * recency, ngx_uint_t metrics, ngx_uri_table * uri_table)
+{
+  if (uri_table->capacity != 0) {
+    return false;
+  }
+
+  uri_table->log    = log;
+  uri_table->shpool = NULL;
+
+  // every engine lives within the same 2MB memory constraint
+  return ngx_uri_table_create(uri_table, engine, top, recency, metrics, 2 * 1024 * 1024);
+}
+
+bool
+ngx_uri_table_init_shared(ngx_slab_pool_t * shpool, size_t size, ngx_uint_t engine, ngx_uint_t top, const ngx_uri_recency * recency, ngx_uint_t metrics, ngx_uri_table * uri_table)
+{
+  uri_table->log    = NULL;
+  uri_table->shpool = shpool;
+
+  // each page of the zone carries its own page descriptor, and a few
+  // pages go to the slab header and to the small allocations
+  size_t pages = size / (ngx_pagesize + sizeof(ngx_slab_page_t));
+  pages -= ngx_min(pages / 2, 16);
+
+  return ngx_uri_table_create(uri_table, engine, top, recency, metrics, pages * ngx_pagesize);
+}
+
 ngx_uri_entry *
-ngx_uri_table_lookup(ngx_uri_table * uri_table, const u_char * uri)
+ngx_uri_table_lookup(ngx_uri_table * uri_table, const u_char * uri, size_t len, uint32_t hash)
 {
   if (uri == NULL)
     return NULL;
   
-  ngx_uint_t v = hash4(uri, uri_table->hash_table->size);
-    
+  ngx_uint_t v = hash & (uri_table->hash_table->size - 1);
+
   ngx_uri_entry * walker;
 
   for (walker = uri_table->hash_table->buckets[v]; walker != NULL; walker = walker->next)
   {
-    if (ngx_strcmp(uri, walker->uri) == 0) {
+    if (walker->hash == hash && walker->len == len
+        && ngx_memcmp(uri, walker->uri, len) == 0)
+    {
       return walker;
     }
   }
@@ -182,11 +262,43 @@ ngx_uri_table_lookup(ngx_uri_table * uri_table, const u_char * uri)
 void
 ngx_uri_table_join(ngx_uri_table * uri_table, ngx_uri_entry * new_entry)
 {
-    ngx_uint_t v = hash4(new_entry->uri, uri_table->hash_table->size);
+    ngx_uint_t v = new_entry->hash & (uri_table->hash_table->size - 1);
     new_entry->next = uri_table->hash_table->buckets[v];
     uri_table->hash_table->buckets[v] = new_entry;
 }
 
+// double the buckets, the entries are moved by their stored hashes
+static void
+ngx_uri_table_grow(ngx_uri_table * uri_table)
+{
+  ngx_uri_hash_table * hash_table = uri_table->hash_table;
+  ngx_uri_entry     ** buckets, * entry, * next;
+  ngx_uint_t           i, v, size;
+
+  size = hash_table->size * 2;
+
+  buckets = ngx_uri_table_alloc(uri_table, size * sizeof(ngx_uri_entry*));
+  if (buckets == NULL) {
+    // keep going with longer chains
+    hash_table->max_size = hash_table->size;
+    return;
+  }
+  ngx_memzero(buckets, size * sizeof(ngx_uri_entry*));
+
+  for (i = 0; i < hash_table->size; i++) {
+    for (entry = hash_table->buckets[i]; entry; entry = next) {
+      next = entry->next;
+      v = entry->hash & (size - 1);
+      entry->next = buckets[v];
+      buckets[v] = entry;
+    }
+  }
+
+  ngx_uri_table_free(uri_table, hash_table->buckets);
+  hash_table->buckets = buckets;
+  hash_table->size = size;
+}
+
 // refresh the lru list such that the entry is now at the head of the list
 void
 ngx_uri_table_update(ngx_uri_table * uri_table, ngx_uri_entry * old_entry)
@@ -196,46 +308,97 @@ ngx_uri_table_update(ngx_uri_table * uri_table, ngx_uri_entry * old_entry)
 }
 
 bool
-ngx_uri_table_add(ngx_uri_table * uri_table, const ngx_str_t * uri)
+ngx_uri_table_add(ngx_uri_table * uri_table, const ngx_str_t * uri, const ngx_uri_sample * sample)
 {
   if (uri->len <= 0 || uri->len > 256) {
     return false;
   }
 
-  // normalize uri
-  u_char * my_uri;
-  my_uri = ngx_palloc(uri_table->pool, uri->len+1);
-  if (my_uri == NULL) {
-    return false;
-  }
-  ngx_strlow(my_uri, uri->data, uri->len);
+  // normalize and hash the uri in one pass
+  u_char my_uri[257];
+  uint32_t hash = ngx_murmur_hash2_strlow(my_uri, uri->data, uri->len);
   my_uri[uri->len] = '\0';
 
-  ngx_uri_entry * entry = ngx_uri_table_lookup(uri_table, my_uri);
+  return ngx_uri_engines[uri_table->engine].add(uri_table, my_uri, uri->len, hash, 1, sample);
+}
+
+bool
+ngx_uri_table_add_count(ngx_uri_table * uri_table, const u_char * uri, size_t len, uint32_t hash, ngx_uint_t n)
+{
+  return ngx_uri_engines[uri_table->engine].add(uri_table, uri, len, hash, n, NULL);
+}
+
+static void
+ngx_uri_table_sample(ngx_uri_table * uri_table, ngx_uri_entry * entry, const ngx_uri_sample * sample)
+{
+  ngx_uri_metrics * metrics = ngx_uri_entry_metrics(uri_table, entry);
+
+  if (sample->status >= 200 && sample->status < 600)
+    metrics->status[sample->status / 100 - 2]++;
+  metrics->bytes += sample->bytes;
+  metrics->msec += sample->msec;
+}
+
+static bool
+ngx_uri_table_lru_add(ngx_uri_table * uri_table, const u_char * my_uri, size_t len, uint32_t hash, ngx_uint_t n, const ngx_uri_sample * sample)
+{
+  ngx_uri_entry * entry = ngx_uri_table_lookup(uri_table, my_uri, len, hash);
   if (entry) {
-    entry->count++;
+    entry->count += n;
+    if (uri_table->recent_size)
+      ngx_uri_recent_hit(uri_table, entry, n, false);
+    if (uri_table->metrics && sample)
+      ngx_uri_table_sample(uri_table, entry, sample);
     ngx_uri_table_update(uri_table, entry);
+    ngx_min_heap_update(&uri_table->top_heap, entry);
     return true;
   } 
 
   // free up memory if needed
   ngx_uri_table_lru_list_purge(uri_table, false);
-  ngx_uri_entry * new_entry = ngx_alloc(sizeof(ngx_uri_entry), uri_table->log);
-  if (new_entry == NULL)
-    return false; 
+  ngx_uri_entry * new_entry = ngx_uri_arena_alloc(&uri_table->arena, len, ngx_uri_table_entry_extra(uri_table));
+  while (new_entry == NULL) {
+    // the arena is full of entries of other sizes,
+    // make room at the cold end of the lru list and retry
+    if (!ngx_uri_table_lru_list_evict(uri_table)) {
+      // the table is empty, only small free blocks are left
+      ngx_uri_arena_reset(&uri_table->arena);
+      new_entry = ngx_uri_arena_alloc(&uri_table->arena, len, ngx_uri_table_entry_extra(uri_table));
+      if (new_entry == NULL)
+        return false;
+      break;
+    }
+    new_entry = ngx_uri_arena_alloc(&uri_table->arena, len, ngx_uri_table_entry_extra(uri_table));
+  }
 
   // copy uri including the null terminating character
-  ngx_memcpy(new_entry->uri, my_uri, uri->len+1);
-  new_entry->count = 1;
+  ngx_memcpy(new_entry->uri, my_uri, len+1);
+  new_entry->hash = hash;
+  new_entry->len = len;
+  new_entry->count = n;
+  new_entry->heap_index = NGX_MIN_HEAP_NONE;
+  if (uri_table->recent_size)
+    ngx_uri_recent_hit(uri_table, new_entry, n, true);
+  if (uri_table->metrics) {
+    ngx_memzero(ngx_uri_entry_metrics(uri_table, new_entry), sizeof(ngx_uri_metrics));
+    if (sample)
+      ngx_uri_table_sample(uri_table, new_entry, sample);
+  }
   ngx_uri_table_join(uri_table, new_entry);
   ngx_uri_table_lru_list_add(uri_table, new_entry);
+  if (uri_table->lru_list_entries > uri_table->hash_table->size
+      && uri_table->hash_table->size < uri_table->hash_table->max_size)
+  {
+    ngx_uri_table_grow(uri_table);
+  }
+  ngx_min_heap_update(&uri_table->top_heap, new_entry);
   return true;
 }
 
 void
 ngx_uri_table_delete(ngx_uri_table * uri_table, ngx_uri_entry * cur_entry)
 {
-    ngx_uint_t v = hash4(cur_entry->uri, uri_table->hash_table->size);
+    ngx_uint_t v = cur_entry->hash & (uri_table->hash_table->size - 1);
 
     if (uri_table->hash_table->buckets[v] == cur_entry)
         uri_table->hash_table->buckets[v] = cur_entry->next;
@@ -291,101 +454,118 @@ ngx_uri_table_lru_list_add(ngx_uri_table * uri_table, ngx_uri_entry * new_entry)
 
 void
 ngx_uri_table_lru_list_purge(ngx_uri_table * uri_table, bool force_purge)
+{
+    while (force_purge || uri_table->lru_list_entries >= uri_table->lru_list_max_entries) {
+        if (!ngx_uri_table_lru_list_evict(uri_table)) break;
+    }
+}
+
+// drop the least recently used entry, returns false if the list is empty
+bool
+ngx_uri_table_lru_list_evict(ngx_uri_table * uri_table)
+{
+    ngx_lru_link_node * m;
+    ngx_uri_entry *     entry;
+
+    m = uri_table->lru_list.tail;
+    if (m == NULL)
+        return false;
+
+    entry = LINK_TO_STRUCT(m, lru, ngx_uri_entry);
+    // unlink lru
+    ngx_uri_table_lru_list_delete(uri_table, entry);
+
+    // now unlink from the hash table and the top entries
+    ngx_uri_table_delete(uri_table, entry);
+
+    if (entry->heap_index != NGX_MIN_HEAP_NONE) {
+        ngx_min_heap_delete(&uri_table->top_heap, entry);
+        ngx_uri_table_lru_list_refill(uri_table);
+    }
+
+    // release the memory for reuse
+    ngx_uri_arena_free(&uri_table->arena, entry);
+    return true;
+}
+
+// an entry of the top n was evicted, promote the most popular of the
+// remaining ones so that the heap stays exact; this walks the whole list,
+// but only the rare eviction of a popular entry gets here
+static void
+ngx_uri_table_lru_list_refill(ngx_uri_table * uri_table)
 {
     ngx_lru_link_node * m;
-    ngx_lru_link_node * prev;
     ngx_uri_entry *     entry;
-    for (m = uri_table->lru_list.tail; m; m = prev) {
-        if ((!force_purge) && (uri_table->lru_list_entries < uri_table->lru_list_max_entries)) break;
-        prev = m->prev;
+    ngx_uri_entry *     best = NULL;
+
+    for (m = uri_table->lru_list.head; m; m = m->next) {
         entry = LINK_TO_STRUCT(m, lru, ngx_uri_entry);
-        // unlink lru
-        ngx_lru_link_node * cur_node = &entry->lru;
-        if (cur_node->next)
-            cur_node->next->prev = cur_node->prev;
-        if (cur_node->prev)
-            cur_node->prev->next = cur_node->next;
-        if (cur_node == uri_table->lru_list.head)
-            uri_table->lru_list.head = cur_node->next;
-        if (cur_node == uri_table->lru_list.tail)
-            uri_table->lru_list.tail = cur_node->prev;
-        cur_node->next = cur_node->prev = NULL;
-   
-        // now unlink from the hash table
-        ngx_uri_entry * cur_entry = ngx_uri_table_lookup(uri_table, (const u_char *) entry->uri);
-        if (cur_entry) {
-            ngx_uri_table_delete(uri_table, cur_entry);
-        }
-        // release the memory
-        ngx_pfree(uri_table->pool, cur_entry);
+        if (entry->heap_index != NGX_MIN_HEAP_NONE)
+            continue;
+        if (best == NULL || entry->count > best->count)
+            best = entry;
     }
+
+    if (best)
+        ngx_min_heap_update(&uri_table->top_heap, best);
+}
+
+// the n most popular uris by rank, most popular first
+ngx_uint_t
+ngx_uri_table_topn(ngx_uri_table * uri_table, ngx_uri_stat * stats, ngx_uint_t n, ngx_uint_t rank)
+{
+  if (rank == NGX_URI_RANK_TOTAL)
+    return ngx_uri_engines[uri_table->engine].topn(uri_table, stats, n);
+
+  return ngx_uri_recent_topn(uri_table, stats, n, rank);
 }
 
-void ngx_uri_table_report(ngx_uri_table * uri_table, ngx_str_t * report)
+static ngx_uint_t
+ngx_uri_table_lru_topn(ngx_uri_table * uri_table, ngx_uri_stat * stats, ngx_uint_t n)
 {
-  //ngx_uri_table_lru_list_walk(uri_table, report);
+  n = ngx_min_heap_get_topn(&uri_table->top_heap, stats, n);
+  ngx_uri_stats_sort(stats, n);
+  return n;
+}
 
+// from the cold end of the lru list, so that adding the uris back in the
+// same order restores the list
+static void
+ngx_uri_table_lru_walk(ngx_uri_table * uri_table, ngx_uri_walk_pt handler, void * data)
+{
   ngx_lru_link_node * m;
   ngx_uri_entry *     entry;
+  size_t              extra = ngx_uri_table_entry_extra(uri_table);
 
-  if (max_heap == NULL) {
-    max_heap = ngx_max_heap_init(INITIAL_SIZE, uri_table->log);
-  } else {
-    ngx_max_heap_reset(max_heap, uri_table->lru_list_entries);
-  }
-
-  // build the heap
-  for (m = uri_table->lru_list.head; m; m = m->next) {
+  for (m = uri_table->lru_list.tail; m; m = m->prev) {
     entry = LINK_TO_STRUCT(m, lru, ngx_uri_entry);
-    ngx_max_heap_add(max_heap, entry);
+    handler(data, entry->uri, entry->len, entry->count,
+            extra ? (u_char *) ngx_uri_entry_recent(entry) : NULL);
   }
+}
 
-  u_char            * temp_string;
-
-  temp_string = ngx_palloc(uri_table->pool, 270 * ngx_max_heap_size(max_heap));
-  if (temp_string == NULL) {
-    report->len = 0;
-    return;
-  }
+void
+ngx_uri_table_walk(ngx_uri_table * uri_table, ngx_uri_walk_pt handler, void * data)
+{
+  ngx_uri_engines[uri_table->engine].walk(uri_table, handler, data);
+}
 
-  ngx_uint_t len = ngx_max_heap_get_topn(max_heap, temp_string);
+static int ngx_libc_cdecl
+ngx_uri_stats_cmp(const void * one, const void * two)
+{
+  const ngx_uri_stat * first = one;
+  const ngx_uri_stat * second = two;
 
-  report->len = len;
-  report->data = temp_string;
-  return;
+  if (first->count == second->count)
+    return 0;
+  return (first->count < second->count) ? 1 : -1;
 }
 
+// most popular first
 void
-ngx_uri_table_lru_list_walk(ngx_uri_table * uri_table, ngx_str_t * report)
+ngx_uri_stats_sort(ngx_uri_stat * stats, ngx_uint_t n)
 {
-  ngx_lru_link_node * m;
-  ngx_uri_entry *     entry;
-  u_char            * temp_string;
-  ngx_uint_t          len = 0;
-  ngx_uint_t          total_len = 0;
-  temp_string = ngx_palloc(uri_table->pool, 4096*sizeof(u_char));
-  u_char * orig_addr = temp_string;
-
-  for (m = uri_table->lru_list.head; m; m = m->next) {
-      entry = LINK_TO_STRUCT(m, lru, ngx_uri_entry);
-      len = strlen((const char*)entry->uri);
-      ngx_memcpy(temp_string, entry->uri, len);
-      temp_string[len++] = ' ';
-      temp_string = ngx_sprintf(temp_string+len, "%d", entry->count);
-      *temp_string = '\n';
-      temp_string++;
-      total_len += len+1;
-      // quick hack to finish up faster
-      if (entry->count <10)
-        total_len += 1;
-      else if (entry->count < 100)
-        total_len += 2;
-      else if (entry->count < 1000)
-        total_len += 2;
-  }
-  report->len = total_len;
-  report->data = orig_addr;
-  return;
+  ngx_qsort(stats, n, sizeof(ngx_uri_stat), ngx_uri_stats_cmp);
 }
 
 void
@@ -398,129 +578,117 @@ ngx_uri_table_cleanup(ngx_uri_table * uri_table)
     ngx_uri_table_lru_list_purge(uri_table, force_purge);
 }
 
-// Max Heap Implementation
+// Min Heap Implementation
+// the table keeps its n most popular entries in a min-heap, updated on
+// every hit, so the root is the entry the next riser has to overtake
 #define LCHILD(x) 2 * x + 1
 #define RCHILD(x) 2 * x + 2
-#define PARENT(x) x / 2
+#define PARENT(x) (x - 1) / 2
 
-ngx_max_heap *
-ngx_max_heap_init(ngx_uint_t heap_size, ngx_log_t * log)
+bool
+ngx_min_heap_init(ngx_uri_table * uri_table, ngx_min_heap * min_heap, ngx_uint_t heap_size)
 {
-  ngx_max_heap * max_heap = ngx_alloc(1 * sizeof(ngx_max_heap), log);
-  if (max_heap == NULL)
-    return NULL;
-  max_heap->elements = ngx_alloc(heap_size * sizeof(ngx_uri_entry*), log);
-  if (max_heap->elements == NULL)
-    return NULL;
-  max_heap->capacity = heap_size;
-  max_heap->size = 0; // no elements yet in the heap
-  return max_heap;
+  min_heap->elements = ngx_uri_table_alloc(uri_table, heap_size * sizeof(ngx_uri_entry*));
+  if (min_heap->elements == NULL)
+    return false;
+  min_heap->capacity = heap_size;
+  min_heap->size = 0; // no elements yet in the heap
+  return true;
 }
 
-ngx_uri_entry*
-ngx_max_heap_root_element(ngx_max_heap * max_heap)
+// the entry was just counted, move it into the heap or further down
+void
+ngx_min_heap_update(ngx_min_heap * min_heap, ngx_uri_entry * uri_entry)
 {
-  if (max_heap && (max_heap->size > 0) ) {
-    return max_heap->elements[0];
+  if (uri_entry->heap_index != NGX_MIN_HEAP_NONE) {
+    ngx_min_heap_heapify(min_heap, uri_entry->heap_index);
+    return;
   }
-  // this code path never executes, just keeping the compiler happy
-  return 0;
-}
 
-bool
-ngx_max_heap_add(ngx_max_heap * max_heap, ngx_uri_entry * uri_entry)
-{
-  ngx_uint_t i = (max_heap->size)++;
-  while(i && uri_entry->count > max_heap->elements[PARENT(i)]->count)
-  {
-    max_heap->elements[i] = max_heap->elements[PARENT(i)];
-    i = PARENT(i);
+  if (min_heap->size < min_heap->capacity) {
+    ngx_uint_t i = (min_heap->size)++;
+    min_heap->elements[i] = uri_entry;
+    uri_entry->heap_index = i;
+    ngx_min_heap_sift_up(min_heap, i);
+    return;
   }
-  max_heap->elements[i] = uri_entry;
-  return true;
-}
 
-ngx_uri_entry *
-ngx_max_heap_delete(ngx_max_heap * max_heap)
-{
-  ngx_uri_entry * temp = NULL;
-  if(max_heap->size > 0) {
-    temp = max_heap->elements[0];
-    max_heap->elements[0] = max_heap->elements[--(max_heap->size)];
-    ngx_max_heap_heapify(max_heap, 0);
+  if (min_heap->size > 0 && uri_entry->count > min_heap->elements[0]->count) {
+    min_heap->elements[0]->heap_index = NGX_MIN_HEAP_NONE;
+    min_heap->elements[0] = uri_entry;
+    uri_entry->heap_index = 0;
+    ngx_min_heap_heapify(min_heap, 0);
   }
-  return temp;
 }
 
 void
-ngx_max_heap_heapify(ngx_max_heap * max_heap, ngx_uint_t i)
+ngx_min_heap_delete(ngx_min_heap * min_heap, ngx_uri_entry * uri_entry)
 {
-  ngx_uint_t largest = (LCHILD(i) < max_heap->size &&
-    max_heap->elements[LCHILD(i)]->count > max_heap->elements[i]->count) ? LCHILD(i) : i;
-  if(RCHILD(i) < max_heap->size
-      && max_heap->elements[RCHILD(i)]->count > max_heap->elements[largest]->count) {
-    largest = RCHILD(i) ;
-  }
+  ngx_uint_t i = uri_entry->heap_index;
+  if (i == NGX_MIN_HEAP_NONE)
+    return;
 
-  if(largest != i) {
-    ngx_max_heap_swap(&(max_heap->elements[i]), &(max_heap->elements[largest]));
-    ngx_max_heap_heapify(max_heap, largest);
-  }
+  uri_entry->heap_index = NGX_MIN_HEAP_NONE;
+  ngx_uri_entry * last = min_heap->elements[--(min_heap->size)];
+  if (i == min_heap->size)
+    return;
+
+  min_heap->elements[i] = last;
+  last->heap_index = i;
+  ngx_min_heap_sift_up(min_heap, i);
+  ngx_min_heap_heapify(min_heap, last->heap_index);
 }
 
 void
-ngx_max_heap_swap(ngx_uri_entry **n1, ngx_uri_entry **n2)
+ngx_min_heap_sift_up(ngx_min_heap * min_heap, ngx_uint_t i)
 {
-    ngx_uri_entry * temp = *n1 ;
-    *n1 = *n2 ;
-    *n2 = temp ;
+  ngx_uri_entry * uri_entry = min_heap->elements[i];
+  while(i && uri_entry->count < min_heap->elements[PARENT(i)]->count)
+  {
+    min_heap->elements[i] = min_heap->elements[PARENT(i)];
+    min_heap->elements[i]->heap_index = i;
+    i = PARENT(i);
+  }
+  min_heap->elements[i] = uri_entry;
+  uri_entry->heap_index = i;
 }
 
-ngx_uint_t
-ngx_max_heap_size(ngx_max_heap * max_heap)
+void
+ngx_min_heap_heapify(ngx_min_heap * min_heap, ngx_uint_t i)
 {
-  if (max_heap) {
-    return max_heap->size;
-  } else {
-    return 0;
+  ngx_uint_t smallest = (LCHILD(i) < min_heap->size &&
+    min_heap->elements[LCHILD(i)]->count < min_heap->elements[i]->count) ? LCHILD(i) : i;
+  if(RCHILD(i) < min_heap->size
+      && min_heap->elements[RCHILD(i)]->count < min_heap->elements[smallest]->count) {
+    smallest = RCHILD(i) ;
+  }
+
+  if(smallest != i) {
+    ngx_min_heap_swap(min_heap, i, smallest);
+    ngx_min_heap_heapify(min_heap, smallest);
   }
 }
 
 void
-ngx_max_heap_reset(ngx_max_heap * max_heap, ngx_uint_t heap_size)
-{
-  if (max_heap) {
-    max_heap->size = 0;
-    if (heap_size > max_heap->capacity) {
-      // hopefully this doesn't happen too frequently, else we could look
-      // at alternate ideas like a persistent max heap of TOPN elements
-      // that we update dynamically
-      // or we might use memory from ngx_pool instead of going to the kernel
-      max_heap = realloc((void *)max_heap, max_heap->capacity * 2 * sizeof(ngx_uri_entry*));
-      max_heap->capacity *= 2;
-    }
-  }
+ngx_min_heap_swap(ngx_min_heap * min_heap, ngx_uint_t i, ngx_uint_t j)
+{
+    ngx_uri_entry * temp = min_heap->elements[i];
+    min_heap->elements[i] = min_heap->elements[j];
+    min_heap->elements[j] = temp;
+    min_heap->elements[i]->heap_index = i;
+    min_heap->elements[j]->heap_index = j;
 }
 
+// a plain copy of the heap, sorted by the caller
 ngx_uint_t
-ngx_max_heap_get_topn(ngx_max_heap * max_heap, u_char * report)
-{
-  ngx_uint_t total_len = 0;
-  ngx_uint_t count = 0;
-  while( max_heap->size > 0 && count < TOPN) {
-    count++;
-    ngx_uri_entry * entry = ngx_max_heap_delete(max_heap);
-    ngx_uint_t len = strlen((const char *)entry->uri);
-    ngx_memcpy(report, entry->uri, len);
-    report[len++] = ' ';
-    report = ngx_sprintf(report + len, "%d%N", entry->count);
-    // quick hack to finish up faster
-    if (entry->count <10)
-      total_len += len+2;
-    else if (entry->count < 100)
-      total_len += len+3;
-    else if (entry->count < 1000)
-      total_len += len+4;
+ngx_min_heap_get_topn(ngx_min_heap * min_heap, ngx_uri_stat * stats, ngx_uint_t n)
+{
+  ngx_uint_t count;
+  for (count = 0; count < min_heap->size && count < n; count++) {
+    ngx_uri_entry * entry = min_heap->elements[count];
+    stats[count].uri   = entry->uri;
+    stats[count].count = entry->count;
+    stats[count].error = 0;
   }
-  return total_len;
+  return count;
 }
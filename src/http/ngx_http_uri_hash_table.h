@@ -25,38 +25,269 @@ typedef struct  {
 
 typedef struct ngx_uri_entry_s  ngx_uri_entry;
 
+// entries are variable-length blocks of the table's arena, the key follows
+// the header and is stored with its hash, so lookups compare hashes first
 struct ngx_uri_entry_s {
-  u_char uri[257];
-  ngx_uri_entry   * next;
+  ngx_uri_entry   * next;   // hash chain, or free list of the arena
   ngx_uint_t        count;
   ngx_lru_link_node lru;
+  uint32_t          hash;
+  uint32_t          heap_index;
+  u_short           len;
+  u_char            size;   // block size in NGX_URI_ARENA_ALIGN units
+  u_char            uri[1];
 } ;
 
+// sliding windows and decay, see ngx_http_uri_window.c
+#define NGX_URI_WINDOWS       3
+#define NGX_URI_WINDOW_SLOTS  12
+
+typedef struct {
+  ngx_msec_t  windows[NGX_URI_WINDOWS];  // spans, 0 if unused
+  ngx_msec_t  half_life;                 // 0 disables the decayed score
+} ngx_uri_recency;
+
+// kept after the key of an entry when the table tracks recency
+typedef struct {
+  ngx_msec_t  stamp;     // time of the last hit
+  double      score;     // decayed count as of stamp
+  uint32_t    slots[1];  // NGX_URI_WINDOW_SLOTS sub-windows per window
+} ngx_uri_recent;
+
+#define NGX_URI_RECENT_MAX                                                  \
+  (offsetof(ngx_uri_recent, slots)                                          \
+   + NGX_URI_WINDOWS * NGX_URI_WINDOW_SLOTS * sizeof(uint32_t))
+
+#define ngx_uri_entry_recent(e)                                             \
+  ((ngx_uri_recent *) ngx_align_ptr((e)->uri + (e)->len + 1,                \
+                                    NGX_URI_ARENA_ALIGN))
+
+// what a request reports besides the hit, see popular_uri_log
+#define NGX_URI_METRIC_STATUS  0x01
+#define NGX_URI_METRIC_BYTES   0x02
+#define NGX_URI_METRIC_TIME    0x04
+
+typedef struct {
+  ngx_uint_t  status;
+  off_t       bytes;
+  ngx_msec_t  msec;
+} ngx_uri_sample;
+
+// kept after the recency of an entry when the table tracks metrics
+typedef struct {
+  uint64_t    bytes;      // bytes sent
+  uint64_t    msec;       // request time
+  uint32_t    status[4];  // responses by class, 2xx to 5xx
+} ngx_uri_metrics;
+
+#define ngx_uri_entry_metrics(t, e)                                         \
+  ((ngx_uri_metrics *) ((u_char *) ngx_uri_entry_recent(e)                  \
+                        + (t)->recent_size))
+
+// what the report ranks by
+#define NGX_URI_RANK_TOTAL   0
+#define NGX_URI_RANK_DECAY   1
+#define NGX_URI_RANK_WINDOW  2  // plus the index of the window
+
+#define NGX_URI_REPORT_TEXT    0
+#define NGX_URI_REPORT_JSON    1
+#define NGX_URI_REPORT_BINARY  2
+
+// what a report includes and how it is written; prefix is lowercase
+typedef struct {
+  ngx_uint_t   rank;
+  ngx_uint_t   format;
+  ngx_uint_t   offset;
+  ngx_uint_t   limit;
+  ngx_str_t    prefix;
+} ngx_uri_report_args;
+
+#define NGX_URI_ARENA_ALIGN    8
+#define NGX_URI_ARENA_CLASSES                                               \
+  ((offsetof(ngx_uri_entry, uri) + 257 + NGX_URI_RECENT_MAX                 \
+    + sizeof(ngx_uri_metrics)) / NGX_URI_ARENA_ALIGN + 4)
+
+// one block of memory carved into entries, freed entries are kept on a
+// list per size and reused before the untouched part of the arena
+typedef struct {
+  u_char        * start;
+  u_char        * last;
+  u_char        * end;
+  ngx_uri_entry * free[NGX_URI_ARENA_CLASSES];
+} ngx_uri_arena;
+
+// a power of two of buckets, doubled as the table fills up
 typedef struct {
   ngx_uri_entry **buckets;
-  ngx_uint_t      size;  
+  ngx_uint_t      size;
+  ngx_uint_t      max_size;
 } ngx_uri_hash_table;
 
+#define NGX_MIN_HEAP_NONE  ((uint32_t) -1)
+
+// min-heap of the n most popular uris in the table, the root is the least
+// popular of them and entry->heap_index tracks each position
+typedef struct {
+  ngx_uint_t size;
+  ngx_uint_t capacity;
+  ngx_uri_entry ** elements;
+} ngx_min_heap;
+
+// counting engines
+#define NGX_URI_ENGINE_LRU           0  // exact counts, cold uris are evicted
+#define NGX_URI_ENGINE_SPACE_SAVING  1  // space-saving top-k summary
+#define NGX_URI_ENGINE_COUNT_MIN     2  // count-min sketch plus exact top-k
+
 typedef struct {
   ngx_uri_hash_table * hash_table;
   ngx_lru_link_list    lru_list;
   ngx_uint_t           lru_list_entries;
   ngx_uint_t           lru_list_max_entries;
-  ngx_pool_t         * pool;
+  ngx_uri_arena        arena;
+  ngx_min_heap         top_heap;
+  // number of uris reported
+  ngx_uint_t           top;
+  ngx_uint_t           engine;
+  ngx_uri_recency      recency;
+  // bytes of ngx_uri_recent per entry, 0 if recency is not tracked
+  size_t               recent_size;
+  // NGX_URI_METRIC_* kept per entry
+  ngx_uint_t           metrics;
+  // state of the approximate engines
+  void               * sketch;
+  // number of uris the engine keeps by name
+  ngx_uint_t           capacity;
   ngx_log_t          * log;
+  // non-NULL when the table lives in a shared memory zone; all the
+  // table functions must then be called with shpool->mutex held
+  ngx_slab_pool_t    * shpool;
 } ngx_uri_table;
 
-bool ngx_uri_table_init(ngx_pool_t * pool, ngx_log_t * log, ngx_uri_table * uri_table);
-bool ngx_uri_table_add(ngx_uri_table * uri_table, const ngx_str_t * uri);
-void ngx_uri_table_report(ngx_uri_table * uri_table, ngx_str_t * report);
+// called for every uri an engine keeps by name, the coldest first; extra
+// is the recency and metrics of an lru entry, or NULL
+typedef void (*ngx_uri_walk_pt)(void * data, const u_char * uri, size_t len, ngx_uint_t count, const u_char * extra);
+
+// one line of the report; error is the maximum overestimation of count
+typedef struct {
+  u_char     * uri;
+  ngx_uint_t   count;
+  ngx_uint_t   error;
+} ngx_uri_stat;
+
+bool ngx_uri_table_init(ngx_log_t * log, ngx_uint_t engine, ngx_uint_t top, const ngx_uri_recency * recency, ngx_uint_t metrics, ngx_uri_table * uri_table);
+bool ngx_uri_table_init_shared(ngx_slab_pool_t * shpool, size_t size, ngx_uint_t engine, ngx_uint_t top, const ngx_uri_recency * recency, ngx_uint_t metrics, ngx_uri_table * uri_table);
+// sample may be NULL if the request reports no metrics
+bool ngx_uri_table_add(ngx_uri_table * uri_table, const ngx_str_t * uri, const ngx_uri_sample * sample);
+bool ngx_uri_table_add_count(ngx_uri_table * uri_table, const u_char * uri, size_t len, uint32_t hash, ngx_uint_t n);
+ngx_uint_t ngx_uri_table_topn(ngx_uri_table * uri_table, ngx_uri_stat * stats, ngx_uint_t n, ngx_uint_t rank);
+ngx_chain_t * ngx_uri_table_report(ngx_uri_table * uri_table, ngx_pool_t * pool, const ngx_uri_report_args * args, size_t * size);
+void ngx_uri_table_walk(ngx_uri_table * uri_table, ngx_uri_walk_pt handler, void * data);
+ngx_uri_entry * ngx_uri_table_lookup(ngx_uri_table * uri_table, const u_char * uri, size_t len, uint32_t hash);
+size_t ngx_uri_table_entry_extra(ngx_uri_table * uri_table);
 void ngx_uri_table_cleanup(ngx_uri_table * uri_table);
+void * ngx_uri_table_alloc(ngx_uri_table * uri_table, size_t size);
+void ngx_uri_table_free(ngx_uri_table * uri_table, void * p);
+ngx_uint_t ngx_uri_hash_size(ngx_uint_t n);
+void ngx_uri_stats_sort(ngx_uri_stat * stats, ngx_uint_t n);
 
-// max-heap impl to find k most popular urls in sorted order
-typedef struct ngx_max_heap {
-  ngx_uint_t size;
-  ngx_uint_t capacity;
-  ngx_uri_entry ** elements;
-} ngx_max_heap;
+size_t ngx_uri_recent_size(const ngx_uri_recency * recency);
+void ngx_uri_recent_hit(ngx_uri_table * uri_table, ngx_uri_entry * entry, ngx_uint_t n, bool fresh);
+ngx_uint_t ngx_uri_recent_topn(ngx_uri_table * uri_table, ngx_uri_stat * stats, ngx_uint_t n, ngx_uint_t rank);
+
+// space-saving: a fixed set of counters grouped in buckets of equal count
+// (the stream-summary of Metwally et al.), so that incrementing a counter
+// and replacing the minimum are both O(1)
+typedef struct ngx_uri_ss_bucket_s   ngx_uri_ss_bucket;
+typedef struct ngx_uri_ss_counter_s  ngx_uri_ss_counter;
+
+struct ngx_uri_ss_counter_s {
+  u_char               uri[257];
+  uint32_t             hash;
+  ngx_uri_ss_counter * next;   // hash chain
+  ngx_uri_ss_counter * prev_sibling;
+  ngx_uri_ss_counter * next_sibling;
+  ngx_uri_ss_bucket  * bucket;
+  ngx_uint_t           error;
+} ;
+
+struct ngx_uri_ss_bucket_s {
+  ngx_uint_t           count;
+  ngx_uri_ss_bucket  * prev;   // buckets are sorted by ascending count
+  ngx_uri_ss_bucket  * next;
+  ngx_uri_ss_counter * counters;
+} ;
+
+typedef struct {
+  ngx_uri_ss_counter ** buckets;  // hash of the monitored uris
+  ngx_uint_t            hash_size;
+  ngx_uri_ss_counter  * counters;
+  ngx_uint_t            used;
+  ngx_uint_t            k;
+  ngx_uri_ss_bucket   * min;
+  ngx_uri_ss_bucket   * max;
+  ngx_uri_ss_bucket   * free_buckets;
+} ngx_uri_space_saving;
+
+bool ngx_uri_space_saving_init(ngx_uri_table * uri_table, size_t budget);
+bool ngx_uri_space_saving_add(ngx_uri_table * uri_table, const u_char * uri, size_t len, uint32_t hash, ngx_uint_t n, const ngx_uri_sample * sample);
+ngx_uint_t ngx_uri_space_saving_topn(ngx_uri_table * uri_table, ngx_uri_stat * stats, ngx_uint_t n);
+void ngx_uri_space_saving_walk(ngx_uri_table * uri_table, ngx_uri_walk_pt handler, void * data);
+
+// count-min: depth rows of width counters estimate every uri seen, a small
+// min-heap keeps the names of the k uris with the highest estimates
+typedef struct ngx_uri_cm_entry_s  ngx_uri_cm_entry;
+
+struct ngx_uri_cm_entry_s {
+  u_char             uri[257];
+  uint32_t           hash;
+  ngx_uri_cm_entry * next;   // hash chain
+  ngx_uint_t         count;
+  ngx_uint_t         index;  // position in the heap
+} ;
+
+typedef struct {
+  ngx_uint_t        * counters;
+  ngx_uint_t          width;
+  ngx_uint_t          depth;
+  ngx_uint_t          total;
+  ngx_uri_cm_entry ** buckets;  // hash of the uris in the heap
+  ngx_uint_t          hash_size;
+  ngx_uri_cm_entry  * entries;
+  ngx_uri_cm_entry ** heap;
+  ngx_uint_t          size;
+  ngx_uint_t          k;
+} ngx_uri_count_min;
+
+bool ngx_uri_count_min_init(ngx_uri_table * uri_table, size_t budget);
+bool ngx_uri_count_min_add(ngx_uri_table * uri_table, const u_char * uri, size_t len, uint32_t hash, ngx_uint_t n, const ngx_uri_sample * sample);
+ngx_uint_t ngx_uri_count_min_topn(ngx_uri_table * uri_table, ngx_uri_stat * stats, ngx_uint_t n);
+void ngx_uri_count_min_walk(ngx_uri_table * uri_table, ngx_uri_walk_pt handler, void * data);
+
+// per-worker batch of increments, see ngx_http_uri_batch.c
+typedef struct {
+  uint32_t   hash;
+  uint32_t   count;  // 0 marks a free slot
+  uint32_t   key;    // offset in keys
+  u_short    len;
+} ngx_uri_batch_slot;
+
+typedef struct {
+  ngx_uri_batch_slot * slots;
+  ngx_uint_t           size;
+  ngx_uint_t           used;
+  u_char             * keys;
+  size_t               keys_last;
+  size_t               keys_size;
+} ngx_uri_batch;
+
+bool ngx_uri_batch_init(ngx_pool_t * pool, ngx_uri_batch * batch, ngx_uint_t size);
+// NGX_AGAIN: the batch is full and must be flushed first
+ngx_int_t ngx_uri_batch_add(ngx_uri_batch * batch, const ngx_str_t * uri);
+void ngx_uri_batch_flush(ngx_uri_batch * batch, ngx_uri_table * uri_table);
+
+// snapshots of the named uris, see ngx_http_uri_snapshot.c
+u_char * ngx_uri_table_snapshot(ngx_uri_table * uri_table, size_t * size);
+bool ngx_uri_table_restore(ngx_uri_table * uri_table, const u_char * data, size_t size);
 
 #endif
 
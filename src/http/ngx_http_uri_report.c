@@ -0,0 +1,265 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include "ngx_http_uri_hash_table.h"
+
+// The report is written straight into a chain of request pool buffers of
+// NGX_URI_REPORT_BUF_SIZE bytes, a line or a record never spans two of
+// them, so no report needs one allocation of its whole size.
+//
+// The binary format is big-endian: a header of the number of records and
+// the flags below, then per record the uri length (16 bits), the uri, its
+// count (64 bits), and depending on the flags its error (64 bits), the
+// status counts (4 x 32 bits), bytes (64 bits) and time in msec (64 bits).
+
+#define NGX_URI_REPORT_BUF_SIZE  4096
+
+#define NGX_URI_REPORT_ERROR     0x100
+
+typedef struct {
+  ngx_pool_t   * pool;
+  ngx_chain_t  * out;
+  ngx_chain_t ** last;
+  ngx_buf_t    * buf;
+  size_t         size;
+} ngx_uri_report_ctx;
+
+static u_char *
+ngx_uri_report_reserve(ngx_uri_report_ctx * ctx, size_t size);
+static void
+ngx_uri_report_line(ngx_uri_report_ctx * ctx, ngx_uri_table * uri_table, ngx_uint_t format, ngx_uri_stat * stat, bool first);
+static u_char *
+ngx_uri_report_uint32(u_char * p, uint32_t n);
+static u_char *
+ngx_uri_report_uint64(u_char * p, uint64_t n);
+
+// the uris are copied out, so the zone may be unlocked once this returns;
+// NULL if out of memory
+ngx_chain_t *
+ngx_uri_table_report(ngx_uri_table * uri_table, ngx_pool_t * pool, const ngx_uri_report_args * args, size_t * size)
+{
+  ngx_uri_report_ctx   ctx;
+  ngx_uri_stat       * stats;
+  ngx_uint_t           i, n, skip, records, flags;
+  u_char             * p, * header;
+
+  ctx.pool = pool;
+  ctx.out = NULL;
+  ctx.last = &ctx.out;
+  ctx.buf = NULL;
+  ctx.size = 0;
+
+  // the first buffer is there even for an empty report
+  header = ngx_uri_report_reserve(&ctx, 8);
+  if (header == NULL)
+    return NULL;
+
+  stats = ngx_palloc(pool, uri_table->top * sizeof(ngx_uri_stat));
+  if (stats == NULL)
+    return NULL;
+
+  // only the top uris are ranked, the arguments page through them
+  n = ngx_uri_table_topn(uri_table, stats, uri_table->top, args->rank);
+
+  flags = uri_table->metrics;
+  if (uri_table->engine != NGX_URI_ENGINE_LRU)
+    flags |= NGX_URI_REPORT_ERROR;
+
+  if (args->format == NGX_URI_REPORT_JSON) {
+    *ctx.buf->last++ = '[';
+
+  } else if (args->format == NGX_URI_REPORT_BINARY) {
+    ctx.buf->last += 8;
+  }
+
+  skip = args->offset;
+  records = 0;
+
+  for (i = 0; i < n && records < args->limit; i++) {
+    if (args->prefix.len
+        && ngx_strncmp(stats[i].uri, args->prefix.data, args->prefix.len) != 0)
+    {
+      continue;
+    }
+
+    if (skip) {
+      skip--;
+      continue;
+    }
+
+    ngx_uri_report_line(&ctx, uri_table, args->format, &stats[i], records == 0);
+    if (ctx.buf == NULL)
+      return NULL;
+    records++;
+  }
+
+  if (args->format == NGX_URI_REPORT_JSON) {
+    p = ngx_uri_report_reserve(&ctx, 2);
+    if (p == NULL)
+      return NULL;
+    *p++ = ']';
+    *p++ = LF;
+    ctx.buf->last = p;
+
+  } else if (args->format == NGX_URI_REPORT_BINARY) {
+    p = ngx_uri_report_uint32(header, records);
+    ngx_uri_report_uint32(p, flags);
+  }
+
+  ctx.buf->last_in_chain = 1;
+
+  for (ngx_chain_t * cl = ctx.out; cl; cl = cl->next)
+    ctx.size += cl->buf->last - cl->buf->pos;
+
+  *size = ctx.size;
+  return ctx.out;
+}
+
+// at least size bytes at the end of the current buffer, or of a new one
+static u_char *
+ngx_uri_report_reserve(ngx_uri_report_ctx * ctx, size_t size)
+{
+  ngx_chain_t * cl;
+  ngx_buf_t   * b;
+
+  if (ctx->buf && (size_t) (ctx->buf->end - ctx->buf->last) >= size)
+    return ctx->buf->last;
+
+  b = ngx_create_temp_buf(ctx->pool, ngx_max(size, NGX_URI_REPORT_BUF_SIZE));
+  cl = ngx_alloc_chain_link(ctx->pool);
+  if (b == NULL || cl == NULL) {
+    ctx->buf = NULL;
+    return NULL;
+  }
+
+  cl->buf = b;
+  cl->next = NULL;
+  *ctx->last = cl;
+  ctx->last = &cl->next;
+  ctx->buf = b;
+
+  return b->last;
+}
+
+static void
+ngx_uri_report_line(ngx_uri_report_ctx * ctx, ngx_uri_table * uri_table, ngx_uint_t format, ngx_uri_stat * stat, bool first)
+{
+  ngx_uri_metrics * metrics = NULL;
+  size_t            len, escape;
+  u_char          * p;
+
+  len = ngx_strlen(stat->uri);
+
+  if (uri_table->metrics) {
+    // the lru engine reports the uris of its entries
+    metrics = ngx_uri_entry_metrics(uri_table, (ngx_uri_entry *)
+                                    (stat->uri - offsetof(ngx_uri_entry, uri)));
+  }
+
+  if (format == NGX_URI_REPORT_BINARY) {
+    p = ngx_uri_report_reserve(ctx, 2 + len + 2 * 8 + 4 * 4 + 2 * 8);
+    if (p == NULL)
+      return;
+
+    *p++ = (u_char) (len >> 8);
+    *p++ = (u_char) len;
+    p = ngx_cpymem(p, stat->uri, len);
+    p = ngx_uri_report_uint64(p, stat->count);
+    if (uri_table->engine != NGX_URI_ENGINE_LRU) {
+      p = ngx_uri_report_uint64(p, stat->error);
+    }
+    if (uri_table->metrics & NGX_URI_METRIC_STATUS) {
+      p = ngx_uri_report_uint32(p, metrics->status[0]);
+      p = ngx_uri_report_uint32(p, metrics->status[1]);
+      p = ngx_uri_report_uint32(p, metrics->status[2]);
+      p = ngx_uri_report_uint32(p, metrics->status[3]);
+    }
+    if (uri_table->metrics & NGX_URI_METRIC_BYTES) {
+      p = ngx_uri_report_uint64(p, metrics->bytes);
+    }
+    if (uri_table->metrics & NGX_URI_METRIC_TIME) {
+      p = ngx_uri_report_uint64(p, metrics->msec);
+    }
+
+    ctx->buf->last = p;
+    return;
+  }
+
+  escape = (format == NGX_URI_REPORT_JSON) ? ngx_escape_json(NULL, stat->uri, len) : 0;
+
+  p = ngx_uri_report_reserve(ctx, len + escape + 2 * NGX_INT_T_LEN
+                             + sizeof(",{\"uri\":\"\",\"count\":,\"error\":") - 1
+                             + sizeof(",\"2xx\":,\"3xx\":,\"4xx\":,\"5xx\":"
+                                      ",\"bytes\":,\"msec\":}") - 1
+                             + 6 * NGX_INT64_LEN + NGX_LINEFEED_SIZE);
+  if (p == NULL)
+    return;
+
+  if (format == NGX_URI_REPORT_JSON) {
+    if (!first)
+      *p++ = ',';
+    p = ngx_cpymem(p, "{\"uri\":\"", sizeof("{\"uri\":\"") - 1);
+    p = escape ? (u_char *) ngx_escape_json(p, stat->uri, len)
+               : ngx_cpymem(p, stat->uri, len);
+    p = ngx_sprintf(p, "\",\"count\":%ui", stat->count);
+    if (uri_table->engine != NGX_URI_ENGINE_LRU) {
+      p = ngx_sprintf(p, ",\"error\":%ui", stat->error);
+    }
+    if (uri_table->metrics & NGX_URI_METRIC_STATUS) {
+      p = ngx_sprintf(p, ",\"2xx\":%uD,\"3xx\":%uD,\"4xx\":%uD,\"5xx\":%uD",
+                      metrics->status[0], metrics->status[1],
+                      metrics->status[2], metrics->status[3]);
+    }
+    if (uri_table->metrics & NGX_URI_METRIC_BYTES) {
+      p = ngx_sprintf(p, ",\"bytes\":%uL", metrics->bytes);
+    }
+    if (uri_table->metrics & NGX_URI_METRIC_TIME) {
+      p = ngx_sprintf(p, ",\"msec\":%uL", metrics->msec);
+    }
+    *p++ = '}';
+
+    ctx->buf->last = p;
+    return;
+  }
+
+  // "uri count\n", the approximate engines add the error bound and the
+  // lru engine the metrics it keeps
+  p = ngx_sprintf(p, "%s %ui", stat->uri, stat->count);
+  if (uri_table->engine != NGX_URI_ENGINE_LRU) {
+    p = ngx_sprintf(p, " %ui", stat->error);
+  }
+  if (uri_table->metrics & NGX_URI_METRIC_STATUS) {
+    p = ngx_sprintf(p, " 2xx=%uD 3xx=%uD 4xx=%uD 5xx=%uD",
+                    metrics->status[0], metrics->status[1],
+                    metrics->status[2], metrics->status[3]);
+  }
+  if (uri_table->metrics & NGX_URI_METRIC_BYTES) {
+    p = ngx_sprintf(p, " bytes=%uL", metrics->bytes);
+  }
+  if (uri_table->metrics & NGX_URI_METRIC_TIME) {
+    p = ngx_sprintf(p, " msec=%uL", metrics->msec);
+  }
+  p = ngx_sprintf(p, "%N");
+
+  ctx->buf->last = p;
+}
+
+static u_char *
+ngx_uri_report_uint32(u_char * p, uint32_t n)
+{
+  *p++ = (u_char) (n >> 24);
+  *p++ = (u_char) (n >> 16);
+  *p++ = (u_char) (n >> 8);
+  *p++ = (u_char) n;
+  return p;
+}
+
+static u_char *
+ngx_uri_report_uint64(u_char * p, uint64_t n)
+{
+  p = ngx_uri_report_uint32(p, (uint32_t) (n >> 32));
+  return ngx_uri_report_uint32(p, (uint32_t) n);
+}
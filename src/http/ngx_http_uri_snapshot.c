@@ -0,0 +1,163 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include "ngx_http_uri_hash_table.h"
+
+// A snapshot is a flat, position independent image of the uris a table
+// keeps by name: a header followed by 8-byte aligned records, coldest
+// first.  Restoring adds the uris back with their counts through the
+// engine, so a snapshot of one engine can be restored into another; the
+// recency and metrics of lru entries are restored if the layout matches.
+
+#define NGX_URI_SNAPSHOT_MAGIC  "NGXURI01"
+
+typedef struct {
+  u_char    magic[8];
+  uint32_t  engine;
+  uint32_t  extra;    // bytes of recency and metrics per record
+  uint64_t  records;
+} ngx_uri_snapshot_header;
+
+// followed by the uri padded to 8 bytes and the extra bytes
+typedef struct {
+  uint64_t  count;
+  uint32_t  len;
+  uint32_t  reserved;
+} ngx_uri_snapshot_record;
+
+typedef struct {
+  u_char   * p;
+  size_t     size;
+  size_t     extra;
+  uint64_t   records;
+} ngx_uri_snapshot_ctx;
+
+static void
+ngx_uri_snapshot_size(void * data, const u_char * uri, size_t len, ngx_uint_t count, const u_char * extra);
+static void
+ngx_uri_snapshot_write(void * data, const u_char * uri, size_t len, ngx_uint_t count, const u_char * extra);
+
+// the caller frees the image with ngx_free()
+u_char *
+ngx_uri_table_snapshot(ngx_uri_table * uri_table, size_t * size)
+{
+  ngx_uri_snapshot_header * header;
+  ngx_uri_snapshot_ctx      ctx;
+  u_char                  * image;
+
+  ctx.size = sizeof(ngx_uri_snapshot_header);
+  ctx.extra = ngx_uri_table_entry_extra(uri_table);
+  ctx.records = 0;
+
+  ngx_uri_table_walk(uri_table, ngx_uri_snapshot_size, &ctx);
+
+  image = ngx_alloc(ctx.size, ngx_cycle->log);
+  if (image == NULL)
+    return NULL;
+
+  header = (ngx_uri_snapshot_header *) image;
+  ngx_memcpy(header->magic, NGX_URI_SNAPSHOT_MAGIC, 8);
+  header->engine = uri_table->engine;
+  header->extra = ctx.extra;
+  header->records = ctx.records;
+
+  ctx.p = image + sizeof(ngx_uri_snapshot_header);
+  ngx_uri_table_walk(uri_table, ngx_uri_snapshot_write, &ctx);
+
+  *size = ctx.size;
+  return image;
+}
+
+static void
+ngx_uri_snapshot_size(void * data, const u_char * uri, size_t len, ngx_uint_t count, const u_char * extra)
+{
+  ngx_uri_snapshot_ctx * ctx = data;
+
+  ctx->size += sizeof(ngx_uri_snapshot_record) + ngx_align(len, 8)
+               + (extra ? ctx->extra : 0);
+  ctx->records++;
+}
+
+static void
+ngx_uri_snapshot_write(void * data, const u_char * uri, size_t len, ngx_uint_t count, const u_char * extra)
+{
+  ngx_uri_snapshot_ctx    * ctx = data;
+  ngx_uri_snapshot_record * record;
+
+  record = (ngx_uri_snapshot_record *) ctx->p;
+  record->count = count;
+  record->len = len;
+  record->reserved = 0;
+  ctx->p += sizeof(ngx_uri_snapshot_record);
+
+  ngx_memzero(ctx->p + len, ngx_align(len, 8) - len);
+  ctx->p = ngx_cpymem(ctx->p, uri, len);
+  ctx->p += ngx_align(len, 8) - len;
+
+  if (extra) {
+    ctx->p = ngx_cpymem(ctx->p, extra, ctx->extra);
+  }
+}
+
+bool
+ngx_uri_table_restore(ngx_uri_table * uri_table, const u_char * data, size_t size)
+{
+  const ngx_uri_snapshot_header * header;
+  const ngx_uri_snapshot_record * record;
+  const u_char                  * p, * end;
+  ngx_uri_entry                 * entry;
+  size_t                          extra;
+  uint64_t                        i;
+  uint32_t                        hash;
+  bool                            same;
+  u_char                          uri[257];
+
+  if (size < sizeof(ngx_uri_snapshot_header))
+    return false;
+
+  header = (const ngx_uri_snapshot_header *) data;
+  if (ngx_memcmp(header->magic, NGX_URI_SNAPSHOT_MAGIC, 8) != 0)
+    return false;
+
+  // the extra bytes are kept with the records of lru snapshots only
+  extra = (header->engine == NGX_URI_ENGINE_LRU) ? header->extra : 0;
+  same = (header->engine == uri_table->engine
+          && extra == ngx_uri_table_entry_extra(uri_table));
+
+  p = data + sizeof(ngx_uri_snapshot_header);
+  end = data + size;
+
+  for (i = 0; i < header->records; i++) {
+    if ((size_t) (end - p) < sizeof(ngx_uri_snapshot_record))
+      return false;
+
+    record = (const ngx_uri_snapshot_record *) p;
+    p += sizeof(ngx_uri_snapshot_record);
+
+    if (record->len == 0 || record->len > 256
+        || (size_t) (end - p) < ngx_align(record->len, 8) + extra)
+    {
+      return false;
+    }
+
+    ngx_memcpy(uri, p, record->len);
+    uri[record->len] = '\0';
+    p += ngx_align(record->len, 8);
+
+    hash = ngx_murmur_hash2(uri, record->len);
+    if (!ngx_uri_table_add_count(uri_table, uri, record->len, hash, record->count))
+      return false;
+
+    if (same && extra) {
+      entry = ngx_uri_table_lookup(uri_table, uri, record->len, hash);
+      if (entry)
+        ngx_memcpy(ngx_uri_entry_recent(entry), p, extra);
+    }
+    p += extra;
+  }
+
+  return true;
+}
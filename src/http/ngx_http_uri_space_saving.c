@@ -0,0 +1,262 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include "ngx_http_uri_hash_table.h"
+
+// Space-Saving (Metwally, Agrawal, El Abbadi): k counters monitor the
+// most frequent uris.  A uri that is not monitored takes over the counter
+// with the minimum count c, starting at c + 1 with an error of c, so a
+// reported count never underestimates and overestimates by at most error.
+// Every uri whose true count exceeds N / k is guaranteed to be monitored.
+
+static void
+ngx_uri_ss_bucket_unlink(ngx_uri_space_saving * ss, ngx_uri_ss_bucket * bucket);
+static void
+ngx_uri_ss_counter_unlink(ngx_uri_ss_counter * counter);
+static void
+ngx_uri_ss_counter_link(ngx_uri_ss_bucket * bucket, ngx_uri_ss_counter * counter);
+static void
+ngx_uri_ss_increment(ngx_uri_space_saving * ss, ngx_uri_ss_counter * counter, ngx_uint_t n);
+static ngx_uri_ss_counter *
+ngx_uri_ss_lookup(ngx_uri_space_saving * ss, const u_char * uri, uint32_t hash);
+static void
+ngx_uri_ss_hash_delete(ngx_uri_space_saving * ss, ngx_uri_ss_counter * counter);
+
+bool
+ngx_uri_space_saving_init(ngx_uri_table * uri_table, size_t budget)
+{
+  ngx_uri_space_saving * ss;
+  ngx_uint_t             i;
+
+  ss = ngx_uri_table_alloc(uri_table, sizeof(ngx_uri_space_saving));
+  if (ss == NULL)
+    return false;
+
+  // one counter, about one bucket and two hash slots per monitored uri
+  size_t x = sizeof(ngx_uri_ss_counter) + sizeof(ngx_uri_ss_bucket)
+             + 2 * sizeof(ngx_uri_ss_counter*);
+  ss->k = budget / x;
+  if (ss->k == 0)
+    return false;
+
+  ss->hash_size = ngx_uri_hash_size(2 * ss->k);
+  ss->buckets = ngx_uri_table_alloc(uri_table, ss->hash_size * sizeof(ngx_uri_ss_counter*));
+  ss->counters = ngx_uri_table_alloc(uri_table, ss->k * sizeof(ngx_uri_ss_counter));
+  // a counter moving past other buckets may need one more than k
+  ngx_uri_ss_bucket * buckets = ngx_uri_table_alloc(uri_table, (ss->k + 1) * sizeof(ngx_uri_ss_bucket));
+  if (ss->buckets == NULL || ss->counters == NULL || buckets == NULL)
+    return false;
+
+  ngx_memzero(ss->buckets, ss->hash_size * sizeof(ngx_uri_ss_counter*));
+
+  // all buckets start on the free list
+  for (i = 0; i <= ss->k; i++) {
+    buckets[i].next = (i < ss->k) ? &buckets[i + 1] : NULL;
+  }
+  ss->free_buckets = buckets;
+  ss->used = 0;
+  ss->min = NULL;
+  ss->max = NULL;
+
+  uri_table->sketch = ss;
+  uri_table->capacity = ss->k;
+  return true;
+}
+
+bool
+ngx_uri_space_saving_add(ngx_uri_table * uri_table, const u_char * uri, size_t len, uint32_t hash, ngx_uint_t n, const ngx_uri_sample * sample)
+{
+  ngx_uri_space_saving * ss = uri_table->sketch;
+  ngx_uri_ss_counter   * counter;
+  ngx_uri_ss_bucket    * bucket;
+  ngx_uint_t             v;
+
+  v = hash & (ss->hash_size - 1);
+
+  counter = ngx_uri_ss_lookup(ss, uri, hash);
+  if (counter) {
+    ngx_uri_ss_increment(ss, counter, n);
+    return true;
+  }
+
+  if (ss->used < ss->k) {
+    // a spare counter enters with an exact count of 0
+    counter = &ss->counters[ss->used++];
+    counter->error = 0;
+
+    if (ss->min == NULL || ss->min->count != 0) {
+      bucket = ss->free_buckets;
+      ss->free_buckets = bucket->next;
+      bucket->count = 0;
+      bucket->counters = NULL;
+      bucket->prev = NULL;
+      bucket->next = ss->min;
+      if (ss->min)
+        ss->min->prev = bucket;
+      else
+        ss->max = bucket;
+      ss->min = bucket;
+    }
+    ngx_uri_ss_counter_link(ss->min, counter);
+
+  } else {
+    // take over a counter of the minimum bucket
+    counter = ss->min->counters;
+    ngx_uri_ss_hash_delete(ss, counter);
+    counter->error = ss->min->count;
+  }
+
+  ngx_memcpy(counter->uri, uri, len + 1);
+  counter->hash = hash;
+  counter->next = ss->buckets[v];
+  ss->buckets[v] = counter;
+
+  ngx_uri_ss_increment(ss, counter, n);
+  return true;
+}
+
+ngx_uint_t
+ngx_uri_space_saving_topn(ngx_uri_table * uri_table, ngx_uri_stat * stats, ngx_uint_t n)
+{
+  ngx_uri_space_saving * ss = uri_table->sketch;
+  ngx_uri_ss_bucket    * bucket;
+  ngx_uri_ss_counter   * counter;
+  ngx_uint_t             count = 0;
+
+  // the buckets are already sorted, walk them from the largest count
+  for (bucket = ss->max; bucket && count < n; bucket = bucket->prev) {
+    for (counter = bucket->counters; counter && count < n; counter = counter->next_sibling) {
+      stats[count].uri   = counter->uri;
+      stats[count].count = bucket->count;
+      stats[count].error = counter->error;
+      count++;
+    }
+  }
+  return count;
+}
+
+// from the minimum count up
+void
+ngx_uri_space_saving_walk(ngx_uri_table * uri_table, ngx_uri_walk_pt handler, void * data)
+{
+  ngx_uri_space_saving * ss = uri_table->sketch;
+  ngx_uri_ss_bucket    * bucket;
+  ngx_uri_ss_counter   * counter;
+
+  for (bucket = ss->min; bucket; bucket = bucket->next) {
+    for (counter = bucket->counters; counter; counter = counter->next_sibling) {
+      if (bucket->count)
+        handler(data, counter->uri, ngx_strlen(counter->uri), bucket->count, NULL);
+    }
+  }
+}
+
+// move the counter to the bucket of count + n, creating it if needed;
+// for single hits the bucket is the next one or a new one, which is O(1)
+static void
+ngx_uri_ss_increment(ngx_uri_space_saving * ss, ngx_uri_ss_counter * counter, ngx_uint_t n)
+{
+  ngx_uri_ss_bucket * bucket = counter->bucket;
+  ngx_uri_ss_bucket * prev = bucket;
+  ngx_uri_ss_bucket * next;
+  ngx_uint_t          target = bucket->count + n;
+
+  for (next = bucket->next; next && next->count < target; next = next->next)
+    prev = next;
+
+  if (next == NULL || next->count != target) {
+    if (prev == bucket && bucket->counters == counter && counter->next_sibling == NULL) {
+      // the counter is alone in its bucket, bump the bucket in place
+      bucket->count = target;
+      return;
+    }
+
+    ngx_uri_ss_bucket * new_bucket = ss->free_buckets;
+    ss->free_buckets = new_bucket->next;
+    new_bucket->count = target;
+    new_bucket->counters = NULL;
+    new_bucket->prev = prev;
+    new_bucket->next = next;
+    if (next)
+      next->prev = new_bucket;
+    else
+      ss->max = new_bucket;
+    prev->next = new_bucket;
+    next = new_bucket;
+  }
+
+  ngx_uri_ss_counter_unlink(counter);
+  ngx_uri_ss_counter_link(next, counter);
+
+  if (bucket->counters == NULL)
+    ngx_uri_ss_bucket_unlink(ss, bucket);
+}
+
+static void
+ngx_uri_ss_bucket_unlink(ngx_uri_space_saving * ss, ngx_uri_ss_bucket * bucket)
+{
+  if (bucket->prev)
+    bucket->prev->next = bucket->next;
+  else
+    ss->min = bucket->next;
+  if (bucket->next)
+    bucket->next->prev = bucket->prev;
+  else
+    ss->max = bucket->prev;
+
+  bucket->next = ss->free_buckets;
+  ss->free_buckets = bucket;
+}
+
+static void
+ngx_uri_ss_counter_unlink(ngx_uri_ss_counter * counter)
+{
+  if (counter->prev_sibling)
+    counter->prev_sibling->next_sibling = counter->next_sibling;
+  else
+    counter->bucket->counters = counter->next_sibling;
+  if (counter->next_sibling)
+    counter->next_sibling->prev_sibling = counter->prev_sibling;
+}
+
+static void
+ngx_uri_ss_counter_link(ngx_uri_ss_bucket * bucket, ngx_uri_ss_counter * counter)
+{
+  counter->bucket = bucket;
+  counter->prev_sibling = NULL;
+  counter->next_sibling = bucket->counters;
+  if (bucket->counters)
+    bucket->counters->prev_sibling = counter;
+  bucket->counters = counter;
+}
+
+static ngx_uri_ss_counter *
+ngx_uri_ss_lookup(ngx_uri_space_saving * ss, const u_char * uri, uint32_t hash)
+{
+  ngx_uri_ss_counter * walker;
+
+  for (walker = ss->buckets[hash & (ss->hash_size - 1)]; walker != NULL; walker = walker->next)
+  {
+    if (walker->hash == hash && ngx_strcmp(uri, walker->uri) == 0) {
+      return walker;
+    }
+  }
+  return NULL;
+}
+
+static void
+ngx_uri_ss_hash_delete(ngx_uri_space_saving * ss, ngx_uri_ss_counter * counter)
+{
+  ngx_uri_ss_counter ** walker;
+
+  for (walker = &ss->buckets[counter->hash & (ss->hash_size - 1)]; *walker; walker = &(*walker)->next)
+  {
+    if (*walker == counter) {
+      *walker = counter->next;
+      break;
+    }
+  }
+}
@@ -0,0 +1,181 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include "ngx_http_uri_hash_table.h"
+#include <math.h>
+
+// Total counts only grow, so next to them an entry may keep how popular it
+// is right now: a ring of sub-window counters per sliding window, which is
+// the count of the last span to within one sub-window, and a score that
+// halves every half_life.  Both are brought up to date lazily, on a hit of
+// the entry and when the report reads them.
+
+static ngx_uint_t
+ngx_uri_recent_value(ngx_uri_table * uri_table, ngx_uri_entry * entry, ngx_uint_t rank, ngx_msec_t now);
+static void
+ngx_uri_stats_sift_down(ngx_uri_stat * stats, ngx_uint_t size, ngx_uint_t i);
+
+size_t
+ngx_uri_recent_size(const ngx_uri_recency * recency)
+{
+  ngx_uint_t w, n = 0;
+
+  for (w = 0; w < NGX_URI_WINDOWS && recency->windows[w]; w++)
+    n++;
+
+  if (n == 0 && recency->half_life == 0)
+    return 0;
+
+  return ngx_align(offsetof(ngx_uri_recent, slots)
+                   + n * NGX_URI_WINDOW_SLOTS * sizeof(uint32_t),
+                   NGX_URI_ARENA_ALIGN);
+}
+
+static double
+ngx_uri_decay(ngx_uri_table * uri_table, ngx_msec_t elapsed)
+{
+  return exp2(- (double) elapsed / uri_table->recency.half_life);
+}
+
+void
+ngx_uri_recent_hit(ngx_uri_table * uri_table, ngx_uri_entry * entry, ngx_uint_t n, bool fresh)
+{
+  ngx_uri_recent * recent = ngx_uri_entry_recent(entry);
+  ngx_msec_t       now = ngx_current_msec;
+  ngx_msec_t       width, cur, last, i;
+  ngx_uint_t       w;
+  uint32_t       * slots;
+
+  if (fresh) {
+    recent->stamp = now;
+    recent->score = 0;
+    ngx_memzero(recent->slots, uri_table->recent_size - offsetof(ngx_uri_recent, slots));
+  }
+
+  // workers update their cached time independently
+  if (now < recent->stamp)
+    now = recent->stamp;
+
+  if (uri_table->recency.half_life) {
+    recent->score = recent->score * ngx_uri_decay(uri_table, now - recent->stamp) + n;
+  }
+
+  for (w = 0; w < NGX_URI_WINDOWS && uri_table->recency.windows[w]; w++) {
+    slots = &recent->slots[w * NGX_URI_WINDOW_SLOTS];
+    width = uri_table->recency.windows[w] / NGX_URI_WINDOW_SLOTS;
+    cur = now / width;
+    last = recent->stamp / width;
+
+    // clear the sub-windows that passed since the last hit
+    if (cur - last >= NGX_URI_WINDOW_SLOTS) {
+      ngx_memzero(slots, NGX_URI_WINDOW_SLOTS * sizeof(uint32_t));
+    } else {
+      for (i = last + 1; i <= cur; i++)
+        slots[i % NGX_URI_WINDOW_SLOTS] = 0;
+    }
+
+    slots[cur % NGX_URI_WINDOW_SLOTS] += n;
+  }
+
+  recent->stamp = now;
+}
+
+static ngx_uint_t
+ngx_uri_recent_value(ngx_uri_table * uri_table, ngx_uri_entry * entry, ngx_uint_t rank, ngx_msec_t now)
+{
+  ngx_uri_recent * recent = ngx_uri_entry_recent(entry);
+  ngx_msec_t       width, cur, last;
+  ngx_uint_t       i, w, sum;
+  uint32_t       * slots;
+
+  if (now < recent->stamp)
+    now = recent->stamp;
+
+  if (rank == NGX_URI_RANK_DECAY) {
+    return (ngx_uint_t) (recent->score * ngx_uri_decay(uri_table, now - recent->stamp) + 0.5);
+  }
+
+  w = rank - NGX_URI_RANK_WINDOW;
+  slots = &recent->slots[w * NGX_URI_WINDOW_SLOTS];
+  width = uri_table->recency.windows[w] / NGX_URI_WINDOW_SLOTS;
+  cur = now / width;
+  last = recent->stamp / width;
+
+  if (cur - last >= NGX_URI_WINDOW_SLOTS)
+    return 0;
+
+  // the sub-windows from the last hit back to the start of the window
+  sum = 0;
+  for (i = 0; i < NGX_URI_WINDOW_SLOTS - (cur - last); i++) {
+    sum += slots[(last % NGX_URI_WINDOW_SLOTS + NGX_URI_WINDOW_SLOTS - i) % NGX_URI_WINDOW_SLOTS];
+  }
+  return sum;
+}
+
+// the n entries ranking highest by a window or by score; unlike the total
+// this changes with time alone, so every entry is looked at
+ngx_uint_t
+ngx_uri_recent_topn(ngx_uri_table * uri_table, ngx_uri_stat * stats, ngx_uint_t n, ngx_uint_t rank)
+{
+  ngx_lru_link_node * m;
+  ngx_uri_entry     * entry;
+  ngx_uint_t          size, value;
+  ngx_msec_t          now = ngx_current_msec;
+
+  if (uri_table->recent_size == 0 || n == 0)
+    return 0;
+
+  size = 0;
+  for (m = uri_table->lru_list.head; m; m = m->next) {
+    entry = (ngx_uri_entry *) ((u_char *) m - offsetof(ngx_uri_entry, lru));
+
+    value = ngx_uri_recent_value(uri_table, entry, rank, now);
+    if (value == 0)
+      continue;
+
+    // stats is a min-heap of the best n so far
+    if (size < n) {
+      stats[size].uri = entry->uri;
+      stats[size].count = value;
+      stats[size].error = 0;
+      size++;
+      if (size == n) {
+        ngx_uint_t i = n / 2;
+        while (i--)
+          ngx_uri_stats_sift_down(stats, size, i);
+      }
+
+    } else if (value > stats[0].count) {
+      stats[0].uri = entry->uri;
+      stats[0].count = value;
+      ngx_uri_stats_sift_down(stats, size, 0);
+    }
+  }
+
+  ngx_uri_stats_sort(stats, size);
+  return size;
+}
+
+static void
+ngx_uri_stats_sift_down(ngx_uri_stat * stats, ngx_uint_t size, ngx_uint_t i)
+{
+  ngx_uri_stat stat = stats[i];
+  ngx_uint_t   child;
+
+  for ( ;; ) {
+    child = 2 * i + 1;
+    if (child >= size)
+      break;
+    if (child + 1 < size && stats[child + 1].count < stats[child].count)
+      child++;
+    if (stats[child].count >= stat.count)
+      break;
+    stats[i] = stats[child];
+    i = child;
+  }
+
+  stats[i] = stat;
+}
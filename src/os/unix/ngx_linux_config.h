@@ -91,6 +91,15 @@ extern ssize_t sendfile(int s, int fd, int32_t *offset, size_t size);
 #include <sys/eventfd.h>
 #endif
 #include <sys/syscall.h>
+#if (NGX_HAVE_MBIND)
+#include <linux/mempolicy.h>
+#endif
+#if (NGX_HAVE_IO_URING)
+#include <linux/io_uring.h>
+#include <poll.h>
+#endif
+
+
 #if (NGX_HAVE_FILE_AIO)
 #include <linux/aio_abi.h>
 typedef struct iocb  ngx_aiocb_t;
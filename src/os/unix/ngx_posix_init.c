@@ -61,6 +61,12 @@ ngx_os_init(ngx_log_t *log)
 
     ngx_cpuinfo();
 
+#if (NGX_HAVE_CPU_AFFINITY)
+    if (ngx_cpu_topology_init(log) != NGX_OK) {
+        return NGX_ERROR;
+    }
+#endif
+
     if (getrlimit(RLIMIT_NOFILE, &rlmt) == -1) {
         ngx_log_error(NGX_LOG_ALERT, log, errno,
                       "getrlimit(RLIMIT_NOFILE) failed)");
@@ -94,6 +100,10 @@ ngx_os_status(ngx_log_t *log)
     ngx_os_specific_status(log);
 #endif
 
+#if (NGX_HAVE_CPU_AFFINITY)
+    ngx_cpu_topology_status(log);
+#endif
+
     ngx_log_error(NGX_LOG_NOTICE, log, 0,
                   "getrlimit(RLIMIT_NOFILE): %r:%r",
                   rlmt.rlim_cur, rlmt.rlim_max);
@@ -756,8 +756,7 @@ ngx_worker_process_cycle(ngx_cycle_t *cycle, void *data)
 
             ngx_event_cancel_timers();
 
-            if (ngx_event_timer_rbtree.root == ngx_event_timer_rbtree.sentinel)
-            {
+            if (ngx_event_no_timers_left() == NGX_OK) {
                 ngx_log_error(NGX_LOG_NOTICE, cycle->log, 0, "exiting");
 
                 ngx_worker_process_exit(cycle);
@@ -799,7 +798,6 @@ static void
 ngx_worker_process_init(ngx_cycle_t *cycle, ngx_int_t worker)
 {
     sigset_t          set;
-    uint64_t          cpu_affinity;
     ngx_int_t         n;
     ngx_uint_t        i;
     struct rlimit     rlmt;
@@ -864,7 +862,11 @@ ngx_worker_process_init(ngx_cycle_t *cycle, ngx_int_t worker)
         }
     }
 
+#if (NGX_HAVE_CPU_AFFINITY)
+
     if (worker >= 0) {
+        ngx_cpuset_t  *cpu_affinity;
+
         cpu_affinity = ngx_get_cpu_affinity(worker);
 
         if (cpu_affinity) {
@@ -872,6 +874,8 @@ ngx_worker_process_init(ngx_cycle_t *cycle, ngx_int_t worker)
         }
     }
 
+#endif
+
 #if (NGX_HAVE_PR_SET_DUMPABLE)
 
     /* allow coredump after setuid() in Linux 2.4.x */
@@ -901,6 +905,15 @@ ngx_worker_process_init(ngx_cycle_t *cycle, ngx_int_t worker)
 
     srandom((ngx_pid << 16) ^ ngx_time());
 
+    if (ccf->pool_cache_high
+        && ngx_pool_cache_init(cycle, ccf->pool_cache_high,
+                               ccf->pool_cache_low)
+           != NGX_OK)
+    {
+        /* fatal */
+        exit(2);
+    }
+
     /*
      * disable deleting previous events for the listening sockets because
      * in the worker processes there are no events at all at this point
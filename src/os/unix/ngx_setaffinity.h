@@ -11,12 +11,47 @@
 
 #define NGX_HAVE_CPU_AFFINITY 1
 
-void ngx_setaffinity(uint64_t cpu_affinity, ngx_log_t *log);
+#if (NGX_HAVE_SCHED_SETAFFINITY)
+
+typedef cpu_set_t  ngx_cpuset_t;
+
+#elif (NGX_HAVE_CPUSET_SETAFFINITY)
+
+#include <sys/cpuset.h>
+
+typedef cpuset_t  ngx_cpuset_t;
+
+#endif
+
+
+/*
+ * The CPUs of the host, as the nodes, packages and cores they belong to.
+ * The order lists the CPUs for "worker_cpu_affinity auto": node by node,
+ * the first threads of all cores of a node before their siblings.
+ */
+
+typedef struct {
+    ngx_uint_t   cpus;
+    ngx_uint_t   cores;
+    ngx_uint_t   packages;
+    ngx_uint_t   nodes;
+    ngx_uint_t  *order;
+} ngx_cpu_topology_t;
+
+
+void ngx_setaffinity(ngx_cpuset_t *cpu_affinity, ngx_log_t *log);
+ngx_int_t ngx_cpu_topology_init(ngx_log_t *log);
+void ngx_cpu_topology_status(ngx_log_t *log);
+
+
+extern ngx_cpu_topology_t  ngx_cpu_topology;
 
 #else
 
 #define ngx_setaffinity(cpu_affinity, log)
 
+typedef uint64_t  ngx_cpuset_t;
+
 #endif
 
 
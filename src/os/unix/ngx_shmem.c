@@ -11,19 +11,101 @@
 
 #if (NGX_HAVE_MAP_ANON)
 
+#if (NGX_HAVE_MAP_HUGETLB)
+static size_t ngx_shm_huge_size(ngx_log_t *log);
+#endif
+#if (NGX_HAVE_MBIND)
+static ngx_int_t ngx_shm_mbind(ngx_shm_t *shm, size_t size);
+#endif
+static void ngx_shm_prefault(ngx_shm_t *shm, size_t size);
+
+
+#if (NGX_HAVE_MAP_HUGETLB)
+static size_t  ngx_shm_huge_pagesize;
+#endif
+
+
 ngx_int_t
 ngx_shm_alloc(ngx_shm_t *shm)
 {
-    shm->addr = (u_char *) mmap(NULL, shm->size,
-                                PROT_READ|PROT_WRITE,
-                                MAP_ANON|MAP_SHARED, -1, 0);
+    size_t  size;
+
+    size = shm->size;
+    shm->addr = MAP_FAILED;
+    shm->hugetlb = 0;
+
+#if (NGX_HAVE_MAP_HUGETLB)
+
+    if (shm->huge == NGX_SHM_HUGE_ON || shm->huge == NGX_SHM_HUGE_TRY) {
+
+        size = ngx_shm_huge_size(shm->log);
+        size = (shm->size + size - 1) & ~(size - 1);
+
+        shm->addr = (u_char *) mmap(NULL, size, PROT_READ|PROT_WRITE,
+                                    MAP_ANON|MAP_SHARED|MAP_HUGETLB, -1, 0);
+
+        if (shm->addr == MAP_FAILED) {
+            if (shm->huge == NGX_SHM_HUGE_ON) {
+                ngx_log_error(NGX_LOG_EMERG, shm->log, ngx_errno,
+                              "mmap(MAP_HUGETLB, %uz) failed for zone \"%V\", "
+                              "check vm.nr_hugepages", size, &shm->name);
+                return NGX_ERROR;
+            }
+
+            ngx_log_error(NGX_LOG_WARN, shm->log, ngx_errno,
+                          "mmap(MAP_HUGETLB, %uz) failed for zone \"%V\", "
+                          "using regular pages", size, &shm->name);
+
+            size = shm->size;
+
+        } else {
+            shm->hugetlb = 1;
+        }
+    }
+
+#endif
 
     if (shm->addr == MAP_FAILED) {
-        ngx_log_error(NGX_LOG_ALERT, shm->log, ngx_errno,
-                      "mmap(MAP_ANON|MAP_SHARED, %uz) failed", shm->size);
+        shm->addr = (u_char *) mmap(NULL, size, PROT_READ|PROT_WRITE,
+                                    MAP_ANON|MAP_SHARED, -1, 0);
+
+        if (shm->addr == MAP_FAILED) {
+            ngx_log_error(NGX_LOG_ALERT, shm->log, ngx_errno,
+                          "mmap(MAP_ANON|MAP_SHARED, %uz) failed", size);
+            return NGX_ERROR;
+        }
+
+#if (NGX_HAVE_MADV_HUGEPAGE)
+
+        /*
+         * transparent huge pages are used for shared memory only
+         * if /sys/kernel/mm/transparent_hugepage/shmem_enabled allows
+         */
+
+        if (shm->huge != NGX_SHM_HUGE_OFF
+            && madvise(shm->addr, size, MADV_HUGEPAGE) == -1)
+        {
+            ngx_log_error(NGX_LOG_WARN, shm->log, ngx_errno,
+                          "madvise(MADV_HUGEPAGE) failed for zone \"%V\"",
+                          &shm->name);
+        }
+
+#endif
+    }
+
+#if (NGX_HAVE_MBIND)
+
+    if (shm->numa != NGX_SHM_NUMA_OFF && ngx_shm_mbind(shm, size) != NGX_OK) {
+        ngx_shm_free(shm);
         return NGX_ERROR;
     }
 
+#endif
+
+    if (shm->prefault) {
+        ngx_shm_prefault(shm, size);
+    }
+
     return NGX_OK;
 }
 
@@ -31,9 +113,220 @@ ngx_shm_alloc(ngx_shm_t *shm)
 void
 ngx_shm_free(ngx_shm_t *shm)
 {
-    if (munmap((void *) shm->addr, shm->size) == -1) {
+    size_t  size;
+
+    size = shm->size;
+
+#if (NGX_HAVE_MAP_HUGETLB)
+
+    if (shm->hugetlb) {
+        size = ngx_shm_huge_size(shm->log);
+        size = (shm->size + size - 1) & ~(size - 1);
+    }
+
+#endif
+
+    if (munmap((void *) shm->addr, size) == -1) {
         ngx_log_error(NGX_LOG_ALERT, shm->log, ngx_errno,
-                      "munmap(%p, %uz) failed", shm->addr, shm->size);
+                      "munmap(%p, %uz) failed", shm->addr, size);
+    }
+}
+
+
+#if (NGX_HAVE_MAP_HUGETLB)
+
+static size_t
+ngx_shm_huge_size(ngx_log_t *log)
+{
+    u_char    *p;
+    size_t     size;
+    ssize_t    n;
+    ngx_fd_t   fd;
+    u_char     buf[4096];
+
+    if (ngx_shm_huge_pagesize) {
+        return ngx_shm_huge_pagesize;
+    }
+
+    /* the default huge page size of x86 */
+
+    size = 2 * 1024 * 1024;
+
+    fd = ngx_open_file("/proc/meminfo", NGX_FILE_RDONLY, NGX_FILE_OPEN, 0);
+
+    if (fd == NGX_INVALID_FILE) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      ngx_open_file_n " \"/proc/meminfo\" failed");
+        goto done;
+    }
+
+    n = ngx_read_fd(fd, buf, sizeof(buf) - 1);
+
+    if (n == -1) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      ngx_read_fd_n " \"/proc/meminfo\" failed");
+        n = 0;
+    }
+
+    if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                      ngx_close_file_n " \"/proc/meminfo\" failed");
+    }
+
+    buf[n] = '\0';
+
+    p = (u_char *) ngx_strstr(buf, "Hugepagesize:");
+
+    if (p == NULL) {
+        goto done;
+    }
+
+    p += sizeof("Hugepagesize:") - 1;
+
+    while (*p == ' ') {
+        p++;
+    }
+
+    n = 0;
+
+    while (*p >= '0' && *p <= '9') {
+        n = n * 10 + (*p++ - '0');
+    }
+
+    /* the size is in kilobytes and is a power of two */
+
+    if (n >= 64 && (n & (n - 1)) == 0) {
+        size = (size_t) n * 1024;
+    }
+
+done:
+
+    ngx_shm_huge_pagesize = size;
+
+    return size;
+}
+
+#endif
+
+
+#if (NGX_HAVE_MBIND)
+
+static ngx_int_t
+ngx_shm_mbind(ngx_shm_t *shm, size_t size)
+{
+    int            mode;
+    u_char        *p;
+    ssize_t        n;
+    ngx_fd_t       fd;
+    unsigned long  mask[NGX_SHM_NUMA_NODES / (8 * sizeof(unsigned long))];
+    u_char         buf[256];
+    uint64_t       nodes;
+
+    nodes = shm->nodes;
+
+    if (nodes == 0) {
+
+        /* all online nodes, as listed like "0-3,6" */
+
+        fd = ngx_open_file("/sys/devices/system/node/online", NGX_FILE_RDONLY,
+                           NGX_FILE_OPEN, 0);
+
+        if (fd == NGX_INVALID_FILE) {
+            ngx_log_error(NGX_LOG_WARN, shm->log, ngx_errno,
+                          ngx_open_file_n
+                          " \"/sys/devices/system/node/online\" failed, "
+                          "numa policy of zone \"%V\" ignored", &shm->name);
+            return NGX_OK;
+        }
+
+        n = ngx_read_fd(fd, buf, sizeof(buf));
+
+        if (n == -1) {
+            ngx_log_error(NGX_LOG_ALERT, shm->log, ngx_errno,
+                          ngx_read_fd_n
+                          " \"/sys/devices/system/node/online\" failed");
+            n = 0;
+        }
+
+        if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+            ngx_log_error(NGX_LOG_ALERT, shm->log, ngx_errno,
+                          ngx_close_file_n
+                          " \"/sys/devices/system/node/online\" failed");
+        }
+
+        for (p = buf; p < buf + n; p++) {
+            if (*p == LF) {
+                break;
+            }
+        }
+
+        if (ngx_shm_parse_nodes(buf, p - buf, &nodes) != NGX_OK) {
+            ngx_log_error(NGX_LOG_WARN, shm->log, 0,
+                          "invalid \"/sys/devices/system/node/online\", "
+                          "numa policy of zone \"%V\" ignored", &shm->name);
+            return NGX_OK;
+        }
+
+        if ((nodes & (nodes - 1)) == 0) {
+            /* a single node */
+            return NGX_OK;
+        }
+    }
+
+    ngx_memzero(mask, sizeof(mask));
+
+    for (n = 0; n < NGX_SHM_NUMA_NODES; n++) {
+        if (nodes & ((uint64_t) 1 << n)) {
+            mask[n / (8 * sizeof(unsigned long))]
+                                |= 1UL << (n % (8 * sizeof(unsigned long)));
+        }
+    }
+
+    mode = (shm->numa == NGX_SHM_NUMA_BIND) ? MPOL_BIND : MPOL_INTERLEAVE;
+
+    /* the kernel uses one bit less than maxnode */
+
+    if (syscall(SYS_mbind, shm->addr, size, mode, mask,
+                NGX_SHM_NUMA_NODES + 1, 0)
+        == -1)
+    {
+        ngx_log_error(NGX_LOG_EMERG, shm->log, ngx_errno,
+                      "mbind(%s) failed for zone \"%V\"",
+                      (mode == MPOL_BIND) ? "MPOL_BIND" : "MPOL_INTERLEAVE",
+                      &shm->name);
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+#endif
+
+
+/*
+ * the pages are touched by the master process, so that workers do not
+ * take page faults on the first use of a zone, and the memory policy
+ * places them at once
+ */
+
+static void
+ngx_shm_prefault(ngx_shm_t *shm, size_t size)
+{
+    u_char  *p;
+    size_t   step;
+
+    step = ngx_pagesize;
+
+#if (NGX_HAVE_MAP_HUGETLB)
+
+    if (shm->hugetlb) {
+        step = ngx_shm_huge_size(shm->log);
+    }
+
+#endif
+
+    for (p = shm->addr; p < shm->addr + size; p += step) {
+        *(volatile u_char *) p = 0;
     }
 }
 
@@ -124,3 +417,64 @@ ngx_shm_free(ngx_shm_t *shm)
 }
 
 #endif
+
+
+ngx_int_t
+ngx_shm_parse_nodes(u_char *p, size_t len, uint64_t *nodes)
+{
+    u_char      *last;
+    ngx_int_t    from, to;
+    ngx_uint_t   n;
+
+    last = p + len;
+    *nodes = 0;
+
+    if (p == last) {
+        return NGX_ERROR;
+    }
+
+    for ( ;; ) {
+
+        for (from = 0, n = 0; p < last && *p >= '0' && *p <= '9'; p++, n++) {
+            from = from * 10 + (*p - '0');
+
+            if (from >= NGX_SHM_NUMA_NODES) {
+                return NGX_ERROR;
+            }
+        }
+
+        if (n == 0) {
+            return NGX_ERROR;
+        }
+
+        to = from;
+
+        if (p < last && *p == '-') {
+            p++;
+
+            for (to = 0, n = 0; p < last && *p >= '0' && *p <= '9'; p++, n++) {
+                to = to * 10 + (*p - '0');
+
+                if (to >= NGX_SHM_NUMA_NODES) {
+                    return NGX_ERROR;
+                }
+            }
+
+            if (n == 0 || to < from) {
+                return NGX_ERROR;
+            }
+        }
+
+        while (from <= to) {
+            *nodes |= (uint64_t) 1 << from++;
+        }
+
+        if (p == last) {
+            return NGX_OK;
+        }
+
+        if (*p++ != ',') {
+            return NGX_ERROR;
+        }
+    }
+}
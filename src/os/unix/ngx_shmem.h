@@ -13,16 +13,45 @@
 #include <ngx_core.h>
 
 
+#define NGX_SHM_HUGE_OFF          0
+#define NGX_SHM_HUGE_ON           1
+#define NGX_SHM_HUGE_TRY          2
+#define NGX_SHM_HUGE_TRANSPARENT  3
+
+#define NGX_SHM_NUMA_OFF          0
+#define NGX_SHM_NUMA_INTERLEAVE   1
+#define NGX_SHM_NUMA_BIND         2
+
+#define NGX_SHM_NUMA_NODES        64
+
+
+typedef struct {
+    ngx_str_t    name;
+    ngx_uint_t   huge;
+    ngx_uint_t   numa;
+    uint64_t     nodes;
+    ngx_uint_t   prefault;
+} ngx_shm_policy_t;
+
+
 typedef struct {
     u_char      *addr;
     size_t       size;
     ngx_str_t    name;
     ngx_log_t   *log;
     ngx_uint_t   exists;   /* unsigned  exists:1;  */
+
+    ngx_uint_t   huge;
+    ngx_uint_t   numa;
+    uint64_t     nodes;
+
+    unsigned     prefault:1;
+    unsigned     hugetlb:1;
 } ngx_shm_t;
 
 
 ngx_int_t ngx_shm_alloc(ngx_shm_t *shm);
+ngx_int_t ngx_shm_parse_nodes(u_char *p, size_t len, uint64_t *nodes);
 void ngx_shm_free(ngx_shm_t *shm);
 
 
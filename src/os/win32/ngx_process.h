@@ -13,6 +13,9 @@ typedef DWORD               ngx_pid_t;
 #define NGX_INVALID_PID     0
 
 
+typedef uint64_t            ngx_cpuset_t;
+
+
 #define ngx_getpid          GetCurrentProcessId
 #define ngx_log_pid         ngx_pid
 
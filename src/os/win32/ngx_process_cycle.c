@@ -795,9 +795,7 @@ ngx_worker_thread(void *data)
 
             ngx_event_cancel_timers();
 
-            if (ngx_event_timer_rbtree.root
-                == ngx_event_timer_rbtree.sentinel)
-            {
+            if (ngx_event_no_timers_left() == NGX_OK) {
                 break;
             }
         }
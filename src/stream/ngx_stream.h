@@ -58,6 +58,9 @@ typedef struct {
 #endif
 #if (NGX_HAVE_REUSEPORT)
     unsigned                reuseport:1;
+#endif
+#if (NGX_HAVE_INCOMING_CPU)
+    unsigned                incoming_cpu:1;
 #endif
     unsigned                so_keepalive:2;
 #if (NGX_HAVE_KEEPALIVE_TUNABLE)
@@ -414,6 +414,17 @@ ngx_stream_core_listen(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
             continue;
         }
 
+        if (ngx_strcmp(value[i].data, "incoming_cpu") == 0) {
+#if (NGX_HAVE_INCOMING_CPU)
+            ls->incoming_cpu = 1;
+#else
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "incoming_cpu is not supported "
+                               "on this platform, ignored");
+#endif
+            continue;
+        }
+
         if (ngx_strcmp(value[i].data, "ssl") == 0) {
 #if (NGX_STREAM_SSL)
             ls->ssl = 1;
@@ -521,5 +532,13 @@ ngx_stream_core_listen(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         return NGX_CONF_ERROR;
     }
 
+#if (NGX_HAVE_INCOMING_CPU)
+    if (ls->incoming_cpu && !ls->reuseport) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "incoming_cpu requires reuseport");
+        return NGX_CONF_ERROR;
+    }
+#endif
+
     return NGX_CONF_OK;
 }
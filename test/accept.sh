@@ -0,0 +1,78 @@
+#!/bin/sh
+#
+# Opens connections concurrently with a new connection for every request
+# against nginx with "multi_accept off", so the listen queue builds up,
+# and checks that every request is answered and nginx still accepts when
+# the load is over.
+#
+# $ make
+# $ ./accept.sh io_uring
+# $ ./accept.sh epoll -c 512 -d 10
+#
+# The first argument is the event method (epoll), the rest are passed
+# to loadgen.  NGINX_BIN is the nginx binary to test (../objs/nginx),
+# WORKERS is the number of worker processes (2) and ACCEPT_MUTEX is
+# the accept_mutex setting (off).
+
+DIR=$(dirname "$0")
+NGINX_BIN=${NGINX_BIN:-$DIR/../objs/nginx}
+PREFIX=$(mktemp -d)
+
+METHOD=${1:-epoll}
+[ $# -gt 0 ] && shift
+
+mkdir -p "$PREFIX/conf" "$PREFIX/logs" "$PREFIX/html"
+chmod 755 "$PREFIX"
+echo ok > "$PREFIX/html/0.html"
+
+cat > "$PREFIX/conf/nginx.conf" <<EOF
+worker_processes  ${WORKERS:-2};
+error_log  logs/error.log  warn;
+pid        logs/nginx.pid;
+
+events {
+    use                 $METHOD;
+    worker_connections  4096;
+    multi_accept        off;
+    accept_mutex        ${ACCEPT_MUTEX:-off};
+}
+
+http {
+    access_log  off;
+
+    server {
+        listen  127.0.0.1:18080 backlog=4096;
+        root    html;
+    }
+}
+EOF
+
+cleanup() {
+    "$NGINX_BIN" -p "$PREFIX" -s stop 2>/dev/null
+    rm -rf "$PREFIX"
+}
+trap cleanup EXIT INT TERM
+
+"$NGINX_BIN" -p "$PREFIX" -c conf/nginx.conf || exit 1
+sleep 0.5
+
+OUT=$("$DIR/loadgen" -p 18080 -c 256 -d 5 "$@" -C -l / -u 1) || exit 1
+echo "$OUT"
+
+RC=0
+
+if ! echo "$OUT" | grep -q "^status: 2xx=[0-9]* 3xx=0 4xx=0 5xx=0 other=0$" ||
+   ! echo "$OUT" | grep -q " 0 errors, 0 timeouts$"; then
+    echo "FAIL: requests were not answered"
+    RC=1
+fi
+
+if ! curl -sf -m 2 -o /dev/null "http://127.0.0.1:18080/0.html"; then
+    echo "FAIL: nginx does not accept after the load"
+    RC=1
+fi
+
+grep -E "\[(alert|crit|emerg)\]" "$PREFIX/logs/error.log" && RC=1
+
+[ $RC -eq 0 ] && echo "ok"
+exit $RC
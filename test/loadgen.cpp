@@ -0,0 +1,807 @@
+/*******************************************
+ * Functionality: An epoll based HTTP load generator to test the trackuri
+ *                http module, and a stub backend for nginx to proxy to.
+ *
+ *                The generator keeps a number of connections busy, with
+ *                keepalive and pipelining, requesting uris of a uniform or
+ *                Zipf distribution or replayed from a log.  By default it
+ *                is closed-loop: every response is followed by the next
+ *                request.  With --rate it is open-loop: requests are due at
+ *                a fixed rate whether or not the server keeps up, and
+ *                latency is measured from when a request was due, so a
+ *                stalled server is not hidden by the generator waiting.
+ *
+ *                Latencies go into a log-linear histogram with 1024 sub
+ *                buckets per power of two (like HdrHistogram with three
+ *                significant digits).
+ *
+ * Usage:
+ * $ make
+ * $ ./loadgen --stub 18090 &
+ * $ ./loadgen -p 8080 -c 64 -d 10 --dist zipf --uris 10000
+ * $ ./loadgen -p 8080 -c 64 -d 10 --rate 20000 --log access.log
+ *
+ * See loadgen.sh to run it against a locally started nginx.
+ ********************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#define MAX_EVENTS   256
+#define READ_SIZE    65536
+
+static uint64_t now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void set_nonblocking(int fd)
+{
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+// log-linear latency histogram in microseconds: values below 2048 have
+// a bucket each, above that every power of two is split in 1024 buckets
+class histogram
+{
+public:
+  histogram() : counts(2048 + 40 * 1024), total(0), max(0) {}
+
+  void record(uint64_t v)
+  {
+    counts[index(v)]++;
+    total++;
+    max = std::max(max, v);
+  }
+
+  uint64_t percentile(double p) const
+  {
+    uint64_t target = (uint64_t) ceil(p / 100 * total), seen = 0;
+
+    if (target == 0)
+      target = 1;
+
+    for (size_t i = 0; i < counts.size(); i++) {
+      seen += counts[i];
+      if (seen >= target)
+        return std::min(value(i), max);
+    }
+    return max;
+  }
+
+  uint64_t count() const { return total; }
+
+private:
+  static size_t index(uint64_t v)
+  {
+    if (v < 2048)
+      return v;
+
+    unsigned shift = 63 - __builtin_clzll(v) - 10;
+    if (shift > 40)
+      shift = 40;
+    return 2048 + (shift - 1) * 1024 + ((v >> shift) - 1024);
+  }
+
+  // the highest value of a bucket
+  static uint64_t value(size_t i)
+  {
+    if (i < 2048)
+      return i;
+
+    unsigned shift = (i - 2048) / 1024 + 1;
+    uint64_t sub = (i - 2048) % 1024 + 1024;
+    return ((sub + 1) << shift) - 1;
+  }
+
+  std::vector<uint64_t> counts;
+  uint64_t              total;
+  uint64_t              max;
+};
+
+// where the uris come from
+class uri_source
+{
+public:
+  virtual ~uri_source() {}
+  virtual const std::string & next() = 0;
+};
+
+class uniform_source : public uri_source
+{
+public:
+  uniform_source(const std::vector<std::string> & uris, std::mt19937_64 & rng)
+    : uris(uris), rng(rng), pick(0, uris.size() - 1) {}
+
+  const std::string & next() { return uris[pick(rng)]; }
+
+private:
+  const std::vector<std::string> & uris;
+  std::mt19937_64                & rng;
+  std::uniform_int_distribution<size_t> pick;
+};
+
+// uri i is requested with a probability proportional to 1 / (i + 1)^s
+class zipf_source : public uri_source
+{
+public:
+  zipf_source(const std::vector<std::string> & uris, double s, std::mt19937_64 & rng)
+    : uris(uris), rng(rng), cdf(uris.size())
+  {
+    double sum = 0;
+
+    for (size_t i = 0; i < uris.size(); i++) {
+      sum += 1 / pow(i + 1, s);
+      cdf[i] = sum;
+    }
+    for (size_t i = 0; i < uris.size(); i++)
+      cdf[i] /= sum;
+  }
+
+  const std::string & next()
+  {
+    double u = std::uniform_real_distribution<double>(0, 1)(rng);
+    size_t i = std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+    return uris[std::min(i, uris.size() - 1)];
+  }
+
+private:
+  const std::vector<std::string> & uris;
+  std::mt19937_64                & rng;
+  std::vector<double>              cdf;
+};
+
+// the uris of a log in order, over and over
+class replay_source : public uri_source
+{
+public:
+  replay_source(const std::vector<std::string> & uris) : uris(uris), i(0) {}
+
+  const std::string & next()
+  {
+    const std::string & uri = uris[i];
+    i = (i + 1) % uris.size();
+    return uri;
+  }
+
+private:
+  const std::vector<std::string> & uris;
+  size_t                           i;
+};
+
+// a line is either a uri or an access log line with a "GET /uri HTTP/1.1"
+static bool read_log(const char * path, std::vector<std::string> & uris)
+{
+  FILE * f = fopen(path, "r");
+  char   line[8192];
+
+  if (f == NULL) {
+    perror(path);
+    return false;
+  }
+
+  while (fgets(line, sizeof(line), f)) {
+    char * p = line;
+    char * q = strstr(line, "\"GET ");
+
+    if (q)
+      p = q + 5;
+    if (*p != '/')
+      continue;
+
+    size_t len = strcspn(p, " \t\r\n\"");
+    uris.push_back(std::string(p, len));
+  }
+
+  fclose(f);
+
+  if (uris.empty()) {
+    fprintf(stderr, "%s: no uris\n", path);
+    return false;
+  }
+  return true;
+}
+
+struct options
+{
+  const char * host = "127.0.0.1";
+  int          port = 8080;
+  int          connections = 16;
+  double       duration = 10;
+  int          depth = 1;
+  bool         keepalive = true;
+  const char * dist = "uniform";
+  size_t       unique = 1000;
+  double       zipf_s = 1.0;
+  const char * log = NULL;
+  const char * location = "/images/";
+  double       rate = 0;
+};
+
+struct connection
+{
+  int                  fd = -1;
+  unsigned             opened = 0;     // tells reopened connections apart
+  bool                 connecting = false;
+  bool                 want_write = false;
+  std::deque<uint64_t> inflight;   // when each request was due or sent
+  std::string          out;
+  size_t               out_pos = 0;
+  std::string          in;
+};
+
+class generator
+{
+public:
+  generator(const options & opt, uri_source & source)
+    : opt(opt), source(source), conns(opt.connections), ok(0), errors(0),
+      timeouts(0), statuses{0, 0, 0, 0, 0}, bytes(0), sent(0), done(false), rr(0)
+  {
+    struct addrinfo hints, * res;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(opt.host, NULL, &hints, &res) != 0) {
+      fprintf(stderr, "cannot resolve %s\n", opt.host);
+      exit(1);
+    }
+    memcpy(&addr, res->ai_addr, sizeof(addr));
+    addr.sin_port = htons(opt.port);
+    freeaddrinfo(res);
+
+    ep = epoll_create1(0);
+  }
+
+  void run()
+  {
+    struct epoll_event events[MAX_EVENTS];
+    uint64_t           interval = 0, next_due = 0;
+
+    start = now_ns();
+    end = start + (uint64_t) (opt.duration * 1e9);
+
+    for (size_t i = 0; i < conns.size(); i++)
+      open(conns[i]);
+
+    if (opt.rate > 0) {
+      interval = (uint64_t) (1e9 / opt.rate);
+      next_due = start;
+    }
+
+    for ( ;; ) {
+      uint64_t now = now_ns();
+      int      timeout = 100;
+
+      if (now >= end && !done) {
+        done = true;
+        stop = now;
+      }
+
+      if (done && idle())
+        break;
+
+      // the requests that are due go to the backlog, and from there
+      // to any connection that has room in its pipeline
+      if (opt.rate > 0 && !done) {
+        while (next_due <= now) {
+          backlog.push_back(next_due);
+          next_due += interval;
+        }
+        dispatch();
+        timeout = (int) ((next_due - now) / 1000000);
+      }
+
+      // drain for at most a second after the end
+      if (done && now > stop + 1000000000)
+        break;
+
+      int n = epoll_wait(ep, events, MAX_EVENTS, timeout);
+
+      for (int i = 0; i < n; i++) {
+        connection & c = conns[events[i].data.u32];
+
+        if (events[i].events & (EPOLLERR | EPOLLHUP) && c.connecting) {
+          fail(c);
+          continue;
+        }
+        if (events[i].events & EPOLLOUT)
+          writable(c);
+        if (c.fd != -1 && events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+          readable(c);
+      }
+    }
+
+    if (!done)
+      stop = now_ns();
+
+    // the requests still in flight were not answered in time
+    for (size_t i = 0; i < conns.size(); i++) {
+      timeouts += conns[i].inflight.size();
+      conns[i].inflight.clear();
+    }
+  }
+
+  void report() const
+  {
+    double secs = (stop - start) / 1e9;
+
+    printf("%llu requests in %.2fs, %.1f MB read, %llu errors, "
+           "%llu timeouts\n",
+           (unsigned long long) (ok + errors + timeouts), secs,
+           bytes / 1048576.0, (unsigned long long) errors,
+           (unsigned long long) timeouts);
+    printf("throughput: %.0f requests/s\n", ok / secs);
+    printf("status: 2xx=%llu 3xx=%llu 4xx=%llu 5xx=%llu other=%llu\n",
+           (unsigned long long) statuses[0], (unsigned long long) statuses[1],
+           (unsigned long long) statuses[2], (unsigned long long) statuses[3],
+           (unsigned long long) statuses[4]);
+    printf("latency: p50=%.3fms p90=%.3fms p99=%.3fms p999=%.3fms max=%.3fms\n",
+           latency.percentile(50) / 1e3, latency.percentile(90) / 1e3,
+           latency.percentile(99) / 1e3, latency.percentile(99.9) / 1e3,
+           latency.percentile(100) / 1e3);
+    if (opt.rate > 0 && !backlog.empty())
+      printf("open-loop: %zu requests were never sent\n", backlog.size());
+  }
+
+private:
+  size_t index(const connection & c) const { return &c - &conns[0]; }
+
+  bool idle() const
+  {
+    for (size_t i = 0; i < conns.size(); i++) {
+      if (!conns[i].inflight.empty())
+        return false;
+    }
+    return true;
+  }
+
+  void open(connection & c)
+  {
+    int one = 1;
+
+    c.fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (c.fd == -1) {
+      perror("socket");
+      exit(1);
+    }
+    set_nonblocking(c.fd);
+    setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    c.opened++;
+    c.connecting = true;
+    c.out.clear();
+    c.out_pos = 0;
+    c.in.clear();
+
+    if (connect(c.fd, (struct sockaddr *) &addr, sizeof(addr)) == -1
+        && errno != EINPROGRESS)
+    {
+      perror("connect");
+      exit(1);
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.u32 = index(c);
+    c.want_write = true;
+    epoll_ctl(ep, EPOLL_CTL_ADD, c.fd, &ev);
+
+    // closed-loop connections fill their pipeline right away
+    if (opt.rate == 0) {
+      while (!done && (int) c.inflight.size() < depth())
+        enqueue(c, now_ns());
+    }
+  }
+
+  void close_conn(connection & c)
+  {
+    epoll_ctl(ep, EPOLL_CTL_DEL, c.fd, NULL);
+    close(c.fd);
+    c.fd = -1;
+  }
+
+  // the requests in flight are lost, the connection starts over
+  void fail(connection & c)
+  {
+    errors += c.inflight.size();
+    c.inflight.clear();
+    close_conn(c);
+    if (!done)
+      open(c);
+  }
+
+  int depth() const { return opt.keepalive ? opt.depth : 1; }
+
+  void enqueue(connection & c, uint64_t due)
+  {
+    const std::string & uri = source.next();
+
+    c.out += "GET ";
+    c.out += uri;
+    c.out += " HTTP/1.1\r\nHost: ";
+    c.out += opt.host;
+    c.out += opt.keepalive ? "\r\n\r\n" : "\r\nConnection: close\r\n\r\n";
+    c.inflight.push_back(due);
+    sent++;
+  }
+
+  void dispatch()
+  {
+    size_t tried = 0;
+
+    while (!backlog.empty() && tried < conns.size()) {
+      connection & c = conns[rr];
+      rr = (rr + 1) % conns.size();
+
+      if (c.fd == -1 || (int) c.inflight.size() >= depth()) {
+        tried++;
+        continue;
+      }
+
+      enqueue(c, backlog.front());
+      backlog.pop_front();
+      tried = 0;
+      if (!c.connecting)
+        flush(c);
+    }
+  }
+
+  void writable(connection & c)
+  {
+    if (c.connecting) {
+      int       err = 0;
+      socklen_t len = sizeof(err);
+
+      getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+      if (err) {
+        fprintf(stderr, "connect: %s\n", strerror(err));
+        exit(1);
+      }
+      c.connecting = false;
+    }
+    flush(c);
+  }
+
+  void flush(connection & c)
+  {
+    while (c.out_pos < c.out.size()) {
+      ssize_t n = send(c.fd, c.out.data() + c.out_pos, c.out.size() - c.out_pos, MSG_NOSIGNAL);
+
+      if (n == -1) {
+        if (errno == EAGAIN)
+          break;
+        fail(c);
+        return;
+      }
+      c.out_pos += n;
+    }
+
+    if (c.out_pos == c.out.size()) {
+      c.out.clear();
+      c.out_pos = 0;
+    }
+
+    bool want = !c.out.empty();
+    if (want != c.want_write) {
+      struct epoll_event ev;
+      ev.events = EPOLLIN | (want ? EPOLLOUT : 0);
+      ev.data.u32 = index(c);
+      epoll_ctl(ep, EPOLL_CTL_MOD, c.fd, &ev);
+      c.want_write = want;
+    }
+  }
+
+  void readable(connection & c)
+  {
+    char buf[READ_SIZE];
+
+    for ( ;; ) {
+      ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+
+      if (n > 0) {
+        c.in.append(buf, n);
+        bytes += n;
+        continue;
+      }
+      if (n == -1 && errno == EAGAIN)
+        break;
+
+      // closed by the server, after a last response or not
+      unsigned opened = c.opened;
+      parse(c);
+      if (c.opened == opened)
+        fail(c);
+      return;
+    }
+
+    parse(c);
+  }
+
+  // complete responses; they carry a Content-Length, nginx and the stub
+  // do not chunk them
+  void parse(connection & c)
+  {
+    size_t pos = 0;
+
+    while (c.fd != -1 && !c.inflight.empty()) {
+      size_t hdr = c.in.find("\r\n\r\n", pos);
+      if (hdr == std::string::npos)
+        break;
+
+      const char * p = c.in.c_str() + pos;
+      int          status = 0;
+      size_t       length = 0;
+      bool         close_after = false;
+
+      if (sscanf(p, "HTTP/1.%*d %d", &status) != 1) {
+        fail(c);
+        return;
+      }
+
+      for (const char * h = strstr(p, "\r\n"); h && h < c.in.c_str() + hdr; h = strstr(h + 2, "\r\n")) {
+        if (strncasecmp(h + 2, "Content-Length:", 15) == 0)
+          length = strtoul(h + 17, NULL, 10);
+        else if (strncasecmp(h + 2, "Connection: close", 17) == 0)
+          close_after = true;
+      }
+
+      if (c.in.size() < hdr + 4 + length)
+        break;
+
+      pos = hdr + 4 + length;
+
+      uint64_t now = now_ns();
+      latency.record((now - c.inflight.front()) / 1000);
+      c.inflight.pop_front();
+      ok++;
+      statuses[(status >= 200 && status < 600) ? status / 100 - 2 : 4]++;
+
+      // the requests pipelined behind the last response are not lost,
+      // they are sent again (closed-loop) or go back to the backlog
+      if (close_after || !opt.keepalive) {
+        if (opt.rate > 0)
+          backlog.insert(backlog.begin(), c.inflight.begin(), c.inflight.end());
+        c.inflight.clear();
+        close_conn(c);
+        if (!done)
+          open(c);
+        return;
+      }
+
+      if (opt.rate == 0 && !done) {
+        enqueue(c, now);
+        flush(c);
+      }
+    }
+
+    if (c.fd != -1)
+      c.in.erase(0, pos);
+  }
+
+  const options           & opt;
+  uri_source              & source;
+  std::vector<connection>   conns;
+  struct sockaddr_in        addr;
+  int                       ep;
+  histogram                 latency;
+  uint64_t                  ok, errors, timeouts, statuses[5], bytes, sent;
+  uint64_t                  start, end, stop;
+  bool                      done;
+  std::deque<uint64_t>      backlog;
+  size_t                    rr;
+};
+
+// answers every request with a small 200 for nginx to proxy to
+static int run_stub(int port)
+{
+  static const char response[] =
+    "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 3\r\n\r\nok\n";
+
+  struct sockaddr_in          sin;
+  struct epoll_event          ev, events[MAX_EVENTS];
+  std::vector<std::string>    in, out;
+  int                         one = 1, ls, ep;
+
+  ls = socket(AF_INET, SOCK_STREAM, 0);
+  setsockopt(ls, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  memset(&sin, 0, sizeof(sin));
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  sin.sin_port = htons(port);
+  if (bind(ls, (struct sockaddr *) &sin, sizeof(sin)) == -1 || listen(ls, 1024) == -1) {
+    perror("stub");
+    return 1;
+  }
+  set_nonblocking(ls);
+
+  ep = epoll_create1(0);
+  ev.events = EPOLLIN;
+  ev.data.fd = ls;
+  epoll_ctl(ep, EPOLL_CTL_ADD, ls, &ev);
+
+  for ( ;; ) {
+    int n = epoll_wait(ep, events, MAX_EVENTS, -1);
+
+    for (int i = 0; i < n; i++) {
+      int fd = events[i].data.fd;
+
+      if (fd == ls) {
+        int c;
+        while ((c = accept4(ls, NULL, NULL, SOCK_NONBLOCK)) != -1) {
+          if ((size_t) c >= in.size()) {
+            in.resize(c + 1);
+            out.resize(c + 1);
+          }
+          in[c].clear();
+          out[c].clear();
+          ev.events = EPOLLIN;
+          ev.data.fd = c;
+          epoll_ctl(ep, EPOLL_CTL_ADD, c, &ev);
+        }
+        continue;
+      }
+
+      char    buf[READ_SIZE];
+      ssize_t r;
+      bool    closed = false, close_after = false;
+
+      while ((r = recv(fd, buf, sizeof(buf), 0)) > 0)
+        in[fd].append(buf, r);
+      if (r == 0 || (r == -1 && errno != EAGAIN))
+        closed = true;
+
+      // requests have no body, each header block gets a response
+      size_t pos = 0, end;
+      while ((end = in[fd].find("\r\n\r\n", pos)) != std::string::npos) {
+        std::string req = in[fd].substr(pos, end - pos);
+        for (size_t k = 0; k < req.size(); k++)
+          req[k] = tolower(req[k]);
+        if (req.find("connection: close") != std::string::npos)
+          close_after = true;
+        out[fd].append(response, sizeof(response) - 1);
+        pos = end + 4;
+      }
+      in[fd].erase(0, pos);
+
+      // the responses are small, a blocking write is good enough
+      if (!out[fd].empty()) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+        if (send(fd, out[fd].data(), out[fd].size(), MSG_NOSIGNAL) == -1)
+          closed = true;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        out[fd].clear();
+      }
+
+      if (closed || close_after) {
+        epoll_ctl(ep, EPOLL_CTL_DEL, fd, NULL);
+        close(fd);
+      }
+    }
+  }
+}
+
+static void __attribute__((noreturn)) usage()
+{
+  fprintf(stderr,
+    "usage: loadgen [options]\n"
+    "       loadgen --stub port\n"
+    "  -h, --host addr        server address (127.0.0.1)\n"
+    "  -p, --port port        server port (8080)\n"
+    "  -c, --connections n    concurrent connections (16)\n"
+    "  -d, --duration secs    how long to run (10)\n"
+    "  -P, --pipeline n       requests in flight per connection (1)\n"
+    "  -C, --close            a new connection for every request\n"
+    "  -D, --dist name        uniform, zipf or replay (uniform)\n"
+    "  -u, --uris n           distinct uris of uniform and zipf (1000)\n"
+    "  -s, --zipf-s s         zipf exponent (1.0)\n"
+    "  -f, --log file         uris to replay, or to pick from\n"
+    "  -l, --location path    prefix of generated uris (/images/)\n"
+    "  -r, --rate n           open-loop, n requests per second\n"
+    "      --stub port        run the stub backend instead\n");
+  exit(1);
+}
+
+int main(int argc, char ** argv)
+{
+  static struct option longopts[] = {
+    { "host",        required_argument, NULL, 'h' },
+    { "port",        required_argument, NULL, 'p' },
+    { "connections", required_argument, NULL, 'c' },
+    { "duration",    required_argument, NULL, 'd' },
+    { "pipeline",    required_argument, NULL, 'P' },
+    { "close",       no_argument,       NULL, 'C' },
+    { "dist",        required_argument, NULL, 'D' },
+    { "uris",        required_argument, NULL, 'u' },
+    { "zipf-s",      required_argument, NULL, 's' },
+    { "log",         required_argument, NULL, 'f' },
+    { "location",    required_argument, NULL, 'l' },
+    { "rate",        required_argument, NULL, 'r' },
+    { "stub",        required_argument, NULL, 'S' },
+    { NULL, 0, NULL, 0 }
+  };
+
+  options opt;
+  int     ch;
+
+  while ((ch = getopt_long(argc, argv, "h:p:c:d:P:CD:u:s:f:l:r:", longopts, NULL)) != -1) {
+    switch (ch) {
+    case 'h': opt.host = optarg; break;
+    case 'p': opt.port = atoi(optarg); break;
+    case 'c': opt.connections = atoi(optarg); break;
+    case 'd': opt.duration = atof(optarg); break;
+    case 'P': opt.depth = atoi(optarg); break;
+    case 'C': opt.keepalive = false; break;
+    case 'D': opt.dist = optarg; break;
+    case 'u': opt.unique = strtoul(optarg, NULL, 10); break;
+    case 's': opt.zipf_s = atof(optarg); break;
+    case 'f': opt.log = optarg; opt.dist = "replay"; break;
+    case 'l': opt.location = optarg; break;
+    case 'r': opt.rate = atof(optarg); break;
+    case 'S': return run_stub(atoi(optarg));
+    default: usage();
+    }
+  }
+
+  if (opt.connections <= 0 || opt.depth <= 0 || opt.unique == 0 || opt.duration <= 0)
+    usage();
+
+  signal(SIGPIPE, SIG_IGN);
+
+  std::mt19937_64          rng(time(NULL));
+  std::vector<std::string> uris;
+
+  if (opt.log) {
+    if (!read_log(opt.log, uris))
+      return 1;
+  } else {
+    for (size_t i = 0; i < opt.unique; i++)
+      uris.push_back(std::string(opt.location) + std::to_string(i) + ".html");
+  }
+
+  // zipf ranks the uris in random order, so the popular ones are not
+  // simply the first ones of the log
+  if (strcmp(opt.dist, "replay") != 0)
+    std::shuffle(uris.begin(), uris.end(), rng);
+
+  uri_source * source = NULL;
+  if (strcmp(opt.dist, "uniform") == 0) {
+    source = new uniform_source(uris, rng);
+  } else if (strcmp(opt.dist, "zipf") == 0) {
+    source = new zipf_source(uris, opt.zipf_s, rng);
+  } else if (strcmp(opt.dist, "replay") == 0 && opt.log) {
+    source = new replay_source(uris);
+  } else {
+    usage();
+  }
+
+  generator gen(opt, *source);
+  gen.run();
+  gen.report();
+
+  delete source;
+  return 0;
+}
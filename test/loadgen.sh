@@ -0,0 +1,34 @@
+#!/bin/sh
+#
+# Starts the stub backend and nginx with loadgen.conf in a scratch prefix,
+# runs loadgen against it with the given options and prints the top uris.
+#
+# $ make
+# $ ./loadgen.sh -c 64 -d 10 --dist zipf --uris 10000
+#
+# NGINX_BIN is the nginx binary to test (../objs/nginx).
+
+DIR=$(dirname "$0")
+NGINX_BIN=${NGINX_BIN:-$DIR/../objs/nginx}
+PREFIX=$(mktemp -d)
+
+mkdir -p "$PREFIX/conf" "$PREFIX/logs"
+cp "$DIR/loadgen.conf" "$PREFIX/conf/nginx.conf"
+
+"$DIR/loadgen" --stub 18090 &
+STUB=$!
+
+cleanup() {
+    "$NGINX_BIN" -p "$PREFIX" -s stop 2>/dev/null
+    kill $STUB 2>/dev/null
+    rm -rf "$PREFIX"
+}
+trap cleanup EXIT INT TERM
+
+"$NGINX_BIN" -p "$PREFIX" -c conf/nginx.conf || exit 1
+sleep 0.5
+
+"$DIR/loadgen" -p 18080 "$@" || exit 1
+
+echo "top uris:"
+curl -s "http://127.0.0.1:18080/stats?limit=10"